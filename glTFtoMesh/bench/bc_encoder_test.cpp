@@ -0,0 +1,129 @@
+﻿#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+#include "bc_encoder.h"
+
+
+namespace
+{
+	void DecodeColor565(uint16_t color, int* pOut)
+	{
+		int r = (color >> 11) & 0x1f, g = (color >> 5) & 0x3f, b = color & 0x1f;
+		pOut[0] = (r << 3) | (r >> 2);
+		pOut[1] = (g << 2) | (g >> 4);
+		pOut[2] = (b << 3) | (b >> 2);
+	}
+
+	// decode the color part of BC1/BC3. (8 bytes)
+	void DecodeColorBlock(const uint8_t* pBlock, bool isBC1, uint8_t* pOutPixels)
+	{
+		uint16_t c0 = (uint16_t)(pBlock[0] | (pBlock[1] << 8));
+		uint16_t c1 = (uint16_t)(pBlock[2] | (pBlock[3] << 8));
+		int palette[4][3];
+		DecodeColor565(c0, palette[0]);
+		DecodeColor565(c1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			if (c0 > c1 || !isBC1)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			else
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+		uint32_t indices = pBlock[4] | (pBlock[5] << 8) | (pBlock[6] << 16) | ((uint32_t)pBlock[7] << 24);
+		for (int i = 0; i < 16; i++)
+		{
+			int index = (indices >> (i * 2)) & 3;
+			for (int c = 0; c < 3; c++)
+			{
+				pOutPixels[i * 4 + c] = (uint8_t)palette[index][c];
+			}
+		}
+	}
+
+	// max channel error of RGB.
+	int GetMaxError(const uint8_t* pPixels, const uint8_t* pDecoded)
+	{
+		int ret = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				ret = std::max(ret, std::abs(pPixels[i * 4 + c] - pDecoded[i * 4 + c]));
+			}
+		}
+		return ret;
+	}
+
+	// gradient between two colors along x. the channels which change in opposite directions are anticorrelated.
+	void MakeGradient(const uint8_t* pColor0, const uint8_t* pColor1, uint8_t* pOutPixels)
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			int t = i % 4;
+			for (int c = 0; c < 3; c++)
+			{
+				pOutPixels[i * 4 + c] = (uint8_t)((pColor0[c] * (3 - t) + pColor1[c] * t) / 3);
+			}
+			pOutPixels[i * 4 + 3] = 255;
+		}
+	}
+}
+
+// the principal axis fit must not collapse to a flat color for blocks whose channels are anticorrelated.
+int main()
+{
+	struct TestCase
+	{
+		const char*		name;
+		uint8_t			color0[3];
+		uint8_t			color1[3];
+	};
+	static const TestCase kCases[] = {
+		{ "red to green",		{ 255, 0, 0 },		{ 0, 255, 0 } },
+		{ "green to blue",		{ 0, 255, 0 },		{ 0, 0, 255 } },
+		{ "yellow to blue",		{ 255, 255, 0 },	{ 0, 0, 255 } },
+		{ "normal map x to y",	{ 255, 128, 128 },	{ 128, 255, 128 } },
+		{ "gray ramp",			{ 0, 0, 0 },		{ 255, 255, 255 } },
+	};
+	static const char* kQualityNames[BCQuality::Max] = { "fast", "final" };
+
+	// 565 quantization and 1/3 interpolation steps. a flat block has an error of about half the gradient.
+	const int kMaxError = 16;
+
+	int failed_count = 0;
+	for (auto&& test : kCases)
+	{
+		uint8_t pixels[64];
+		MakeGradient(test.color0, test.color1, pixels);
+		for (uint32_t quality = 0; quality < BCQuality::Max; quality++)
+		{
+			uint8_t block[16];
+			uint8_t decoded[64];
+
+			EncodeBCBlock(BCFormat::BC1, quality, pixels, block);
+			DecodeColorBlock(block, true, decoded);
+			int bc1_error = GetMaxError(pixels, decoded);
+
+			EncodeBCBlock(BCFormat::BC3, quality, pixels, block);
+			DecodeColorBlock(block + 8, false, decoded);
+			int bc3_error = GetMaxError(pixels, decoded);
+
+			bool is_passed = bc1_error <= kMaxError && bc3_error <= kMaxError;
+			fprintf(stdout, "%-4s %-18s %-5s : BC1 error %3d, BC3 error %3d\n",
+				is_passed ? "OK" : "FAIL", test.name, kQualityNames[quality], bc1_error, bc3_error);
+			failed_count += is_passed ? 0 : 1;
+		}
+	}
+	return (failed_count == 0) ? 0 : 1;
+}
+
+
+//	EOF
@@ -0,0 +1,316 @@
+﻿#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <memory>
+#include <functional>
+#include <algorithm>
+
+#include "mesh_work.h"
+#include "job_system.h"
+#include "stats.h"
+#include "scene_generator.h"
+
+
+namespace
+{
+	struct BenchOptions
+	{
+		std::vector<SceneKind::Type>	scenes;
+		std::vector<double>				triangleMillions;
+		uint32_t						threadCount = 0;
+		uint32_t						repeatCount = 3;
+		uint32_t						seed = 1;
+		std::string						outputPath = "";
+		std::string						baselinePath = "";
+	};	// struct BenchOptions
+
+	struct StageResult
+	{
+		std::string		scene;
+		size_t			triangleCount = 0;
+		std::string		stage;
+		double			seconds = 0.0;			// best of all repeats.
+		uint64_t		allocatedBytes = 0;		// total bytes allocated by all threads in the stage.
+		size_t			peakBytes = 0;			// peak heap usage above the usage at the start of the stage.
+	};	// struct StageResult
+
+	// stages are measured in this order. each stage uses the result of the previous stages.
+	struct Stage
+	{
+		const char*							name;
+		std::function<void(MeshWork&)>		func;
+	};	// struct Stage
+
+	std::vector<std::string> SplitList(const std::string& str)
+	{
+		std::vector<std::string> ret;
+		std::stringstream ss(str);
+		std::string item;
+		while (std::getline(ss, item, ','))
+		{
+			if (!item.empty())
+			{
+				ret.push_back(item);
+			}
+		}
+		return ret;
+	}
+
+	std::string MakeResultKey(const std::string& scene, size_t triangleCount, const std::string& stage)
+	{
+		return scene + " " + std::to_string(triangleCount) + " " + stage;
+	}
+
+	bool ParseBenchOptions(int argc, char* argv[], BenchOptions& options)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			std::string op = argv[i];
+			if (i == argc - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			std::string value = argv[++i];
+
+			if (op == "-scene")
+			{
+				options.scenes.clear();
+				for (auto&& name : SplitList(value))
+				{
+					if (name == "all")
+					{
+						for (int k = 0; k < SceneKind::Max; k++)
+						{
+							options.scenes.push_back((SceneKind::Type)k);
+						}
+						continue;
+					}
+					SceneKind::Type kind;
+					if (!ParseSceneKind(name, kind))
+					{
+						fprintf(stderr, "unknown scene. (%s)\n", name.c_str());
+						return false;
+					}
+					options.scenes.push_back(kind);
+				}
+			}
+			else if (op == "-tris")
+			{
+				options.triangleMillions.clear();
+				for (auto&& count : SplitList(value))
+				{
+					options.triangleMillions.push_back(std::max(std::stod(count), 0.000001));
+				}
+			}
+			else if (op == "-j")
+			{
+				options.threadCount = (uint32_t)std::max(std::stoi(value), 0);
+			}
+			else if (op == "-repeat")
+			{
+				options.repeatCount = (uint32_t)std::max(std::stoi(value), 1);
+			}
+			else if (op == "-seed")
+			{
+				options.seed = (uint32_t)std::stoul(value);
+			}
+			else if (op == "-o")
+			{
+				options.outputPath = value;
+			}
+			else if (op == "-baseline")
+			{
+				options.baselinePath = value;
+			}
+			else
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+		}
+
+		if (options.scenes.empty())
+		{
+			for (int k = 0; k < SceneKind::Max; k++)
+			{
+				options.scenes.push_back((SceneKind::Type)k);
+			}
+		}
+		if (options.triangleMillions.empty())
+		{
+			options.triangleMillions.push_back(1.0);
+		}
+		return true;
+	}
+
+	// result file has one stage per line. "scene triangles stage seconds allocatedBytes peakBytes"
+	bool WriteResults(const std::string& filePath, const std::vector<StageResult>& results)
+	{
+		std::ofstream ofs(filePath);
+		if (!ofs)
+		{
+			return false;
+		}
+		ofs << "# scene triangles stage seconds allocatedBytes peakBytes\n";
+		for (auto&& r : results)
+		{
+			ofs << r.scene << " " << r.triangleCount << " " << r.stage << " " << r.seconds << " " << r.allocatedBytes << " " << r.peakBytes << "\n";
+		}
+		return true;
+	}
+
+	bool ReadResults(const std::string& filePath, std::map<std::string, StageResult>& outResults)
+	{
+		std::ifstream ifs(filePath);
+		if (!ifs)
+		{
+			return false;
+		}
+		std::string line;
+		while (std::getline(ifs, line))
+		{
+			if (line.empty() || line[0] == '#')
+			{
+				continue;
+			}
+			std::stringstream ss(line);
+			StageResult r;
+			if (ss >> r.scene >> r.triangleCount >> r.stage >> r.seconds >> r.allocatedBytes >> r.peakBytes)
+			{
+				outResults[MakeResultKey(r.scene, r.triangleCount, r.stage)] = r;
+			}
+		}
+		return true;
+	}
+}
+
+void DisplayHelp()
+{
+	fprintf(stdout, "glTFtoMeshBench : benchmark mesh stages of glTFtoMesh with procedural scenes.\n");
+	fprintf(stdout, "options:\n");
+	fprintf(stdout, "    -scene <list>    : comma separated scenes. grid, sphere, scan, many or all. (default: all)\n");
+	fprintf(stdout, "    -tris <list>     : comma separated triangle counts in millions. (default: 1)\n");
+	fprintf(stdout, "    -j <count>       : worker thread count. 0 means all hardware threads. (default: 0)\n");
+	fprintf(stdout, "    -repeat <count>  : repeat count. the best time is reported. (default: 3)\n");
+	fprintf(stdout, "    -seed <value>    : seed of the scene generator. (default: 1)\n");
+	fprintf(stdout, "    -o <file>        : write results to a file.\n");
+	fprintf(stdout, "    -baseline <file> : compare results with a file written by -o.\n");
+	fprintf(stdout, "\n");
+	fprintf(stdout, "example:\n");
+	fprintf(stdout, "    glTFtoMeshBench -scene grid,scan -tris 1,10,50 -o base.txt\n");
+	fprintf(stdout, "    glTFtoMeshBench -scene grid,scan -tris 1,10,50 -baseline base.txt\n");
+}
+
+int main(int argc, char* argv[])
+{
+	BenchOptions options;
+	if (argc > 1 && (std::string(argv[1]) == "-h" || std::string(argv[1]) == "-help"))
+	{
+		DisplayHelp();
+		return 0;
+	}
+	if (!ParseBenchOptions(argc, argv, options))
+	{
+		DisplayHelp();
+		return -1;
+	}
+
+	std::map<std::string, StageResult> baseline;
+	if (!options.baselinePath.empty() && !ReadResults(options.baselinePath, baseline))
+	{
+		fprintf(stderr, "failed to read baseline. (%s)\n", options.baselinePath.c_str());
+		return -1;
+	}
+
+	EnableAllocationTracking();
+	JobSystem job_system(options.threadCount);
+	fprintf(stdout, "threads: %u, repeat: %u, seed: %u\n", job_system.GetThreadCount(), options.repeatCount, options.seed);
+
+	const Stage kStages[] = {
+		{ "GenerateTangents",	[](MeshWork& mesh) { mesh.GenerateTangents(); } },
+		{ "ComputeBounds",		[](MeshWork& mesh) { mesh.ComputeBounds(); } },
+		{ "MergeSubmesh",		[](MeshWork& mesh) { mesh.MergeSubmesh(); } },
+		{ "OptimizeSubmesh",	[](MeshWork& mesh) { mesh.OptimizeSubmesh(); } },
+		{ "BuildLods",			[](MeshWork& mesh) { mesh.BuildLods(4, 0.5f, 0.05f); } },
+		{ "BuildMeshlets",		[](MeshWork& mesh) { mesh.BuildMeshlets(); } },
+		{ "BuildClusterDag",	[](MeshWork& mesh) { mesh.BuildClusterDag(); } },
+	};
+	static const size_t kStageCount = sizeof(kStages) / sizeof(kStages[0]);
+
+	std::vector<StageResult> results;
+	for (auto scene : options.scenes)
+	{
+		for (auto millions : options.triangleMillions)
+		{
+			size_t requested_count = (size_t)(millions * 1000000.0);
+			std::vector<StageResult> scene_results(kStageCount);
+			for (uint32_t repeat = 0; repeat < options.repeatCount; repeat++)
+			{
+				// scene generation is not measured.
+				auto mesh = std::make_unique<MeshWork>(&job_system);
+				size_t tri_count = GenerateScene(scene, requested_count, options.seed, *mesh);
+
+				for (size_t s = 0; s < kStageCount; s++)
+				{
+					size_t start_current = GetCurrentAllocatedBytes();
+					ResetPeakAllocatedBytes();
+					uint64_t start_total = GetTotalAllocatedBytes();
+					auto start_time = std::chrono::steady_clock::now();
+
+					kStages[s].func(*mesh);
+
+					double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+					uint64_t allocated = GetTotalAllocatedBytes() - start_total;
+					size_t peak = GetPeakAllocatedBytes() - start_current;
+
+					auto&& r = scene_results[s];
+					if (repeat == 0 || seconds < r.seconds)
+					{
+						r.seconds = seconds;
+					}
+					r.scene = GetSceneKindName(scene);
+					r.triangleCount = tri_count;
+					r.stage = kStages[s].name;
+					r.allocatedBytes = allocated;
+					r.peakBytes = peak;
+				}
+			}
+
+			fprintf(stdout, "\nscene: %s, triangles: %zu\n", GetSceneKindName(scene), scene_results[0].triangleCount);
+			fprintf(stdout, "  stage               time(ms)  Mtris/sec  alloc(MB)   peak(MB)  baseline\n");
+			for (auto&& r : scene_results)
+			{
+				std::string compare = "-";
+				auto it = baseline.find(MakeResultKey(r.scene, r.triangleCount, r.stage));
+				if (it != baseline.end() && it->second.seconds > 0.0)
+				{
+					char buf[64];
+					snprintf(buf, sizeof(buf), "%+.1f%%", (r.seconds / it->second.seconds - 1.0) * 100.0);
+					compare = buf;
+				}
+				fprintf(stdout, "  %-16s  %10.2f  %9.2f  %9.1f  %9.1f  %s\n",
+					r.stage.c_str(),
+					r.seconds * 1000.0,
+					(double)r.triangleCount / std::max(r.seconds, 1e-9) / 1000000.0,
+					(double)r.allocatedBytes / (1024.0 * 1024.0),
+					(double)r.peakBytes / (1024.0 * 1024.0),
+					compare.c_str());
+				results.push_back(r);
+			}
+		}
+	}
+
+	if (!options.outputPath.empty() && !WriteResults(options.outputPath, results))
+	{
+		fprintf(stderr, "failed to write results. (%s)\n", options.outputPath.c_str());
+		return -1;
+	}
+	return 0;
+}
+
+
+//	EOF
@@ -0,0 +1,281 @@
+﻿#include "scene_generator.h"
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "mesh_work.h"
+
+
+namespace
+{
+	static const float kPi = 3.14159265358979f;
+
+	// small deterministic generator. the results do not depend on the standard library.
+	class Random
+	{
+	public:
+		Random(uint32_t seed)
+			: state_((uint64_t)seed * 0x9E3779B97F4A7C15ull + 1)
+		{}
+
+		uint32_t Next()
+		{
+			state_ ^= state_ << 13;
+			state_ ^= state_ >> 7;
+			state_ ^= state_ << 17;
+			return (uint32_t)(state_ >> 32);
+		}
+
+		// [0, 1)
+		float NextFloat()
+		{
+			return (float)(Next() >> 8) / 16777216.0f;
+		}
+
+		// [minValue, maxValue)
+		float NextFloat(float minValue, float maxValue)
+		{
+			return minValue + (maxValue - minValue) * NextFloat();
+		}
+
+	private:
+		uint64_t	state_;
+	};	// class Random
+
+	// UV sphere. the seam vertices are duplicated like exported assets.
+	void AppendSphere(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const DirectX::XMFLOAT3& center, float radius, uint32_t rings, uint32_t segments)
+	{
+		uint32_t base = (uint32_t)vertices.size();
+		for (uint32_t r = 0; r <= rings; r++)
+		{
+			float v = (float)r / (float)rings;
+			float theta = v * kPi;
+			for (uint32_t s = 0; s <= segments; s++)
+			{
+				float u = (float)s / (float)segments;
+				float phi = u * kPi * 2.0f;
+
+				Vertex vtx;
+				vtx.normal.x = sinf(theta) * cosf(phi);
+				vtx.normal.y = cosf(theta);
+				vtx.normal.z = sinf(theta) * sinf(phi);
+				vtx.pos.x = center.x + vtx.normal.x * radius;
+				vtx.pos.y = center.y + vtx.normal.y * radius;
+				vtx.pos.z = center.z + vtx.normal.z * radius;
+				vtx.tangent = DirectX::XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+				vtx.uv.x = u;
+				vtx.uv.y = v;
+				vertices.push_back(vtx);
+			}
+		}
+
+		uint32_t stride = segments + 1;
+		for (uint32_t r = 0; r < rings; r++)
+		{
+			for (uint32_t s = 0; s < segments; s++)
+			{
+				uint32_t i0 = base + r * stride + s;
+				uint32_t i1 = i0 + 1;
+				uint32_t i2 = i0 + stride;
+				uint32_t i3 = i2 + 1;
+				indices.push_back(i0); indices.push_back(i2); indices.push_back(i1);
+				indices.push_back(i1); indices.push_back(i2); indices.push_back(i3);
+			}
+		}
+	}
+
+	// rings and segments for about triangleCount triangles. (segments = rings * 2)
+	uint32_t GetSphereRings(size_t triangleCount)
+	{
+		return std::max((uint32_t)sqrt((double)triangleCount / 4.0), 2u);
+	}
+
+	size_t GenerateGrid(size_t triangleCount, uint32_t seed, MeshWork& outMesh)
+	{
+		uint32_t quads = std::max((uint32_t)sqrt((double)triangleCount / 2.0), 1u);
+		uint32_t stride = quads + 1;
+		float size = 100.0f;
+		float cell = size / (float)quads;
+
+		// height field of a few waves.
+		Random rnd(seed);
+		float freq_x = rnd.NextFloat(0.05f, 0.2f);
+		float freq_z = rnd.NextFloat(0.05f, 0.2f);
+		float amp = rnd.NextFloat(1.0f, 4.0f);
+
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		vertices.reserve((size_t)stride * stride);
+		indices.reserve((size_t)quads * quads * 6);
+		for (uint32_t z = 0; z <= quads; z++)
+		{
+			for (uint32_t x = 0; x <= quads; x++)
+			{
+				float px = (float)x * cell - size * 0.5f;
+				float pz = (float)z * cell - size * 0.5f;
+				float dx = amp * freq_x * cosf(px * freq_x);
+				float dz = -amp * freq_z * sinf(pz * freq_z);
+				float len = sqrtf(dx * dx + 1.0f + dz * dz);
+
+				Vertex vtx;
+				vtx.pos = DirectX::XMFLOAT3(px, amp * (sinf(px * freq_x) + cosf(pz * freq_z)), pz);
+				vtx.normal = DirectX::XMFLOAT3(-dx / len, 1.0f / len, -dz / len);
+				vtx.tangent = DirectX::XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+				vtx.uv = DirectX::XMFLOAT2((float)x / (float)quads, (float)z / (float)quads);
+				vertices.push_back(vtx);
+			}
+		}
+		for (uint32_t z = 0; z < quads; z++)
+		{
+			for (uint32_t x = 0; x < quads; x++)
+			{
+				uint32_t i0 = z * stride + x;
+				uint32_t i1 = i0 + 1;
+				uint32_t i2 = i0 + stride;
+				uint32_t i3 = i2 + 1;
+				indices.push_back(i0); indices.push_back(i2); indices.push_back(i1);
+				indices.push_back(i1); indices.push_back(i2); indices.push_back(i3);
+			}
+		}
+
+		size_t ret = indices.size() / 3;
+		outMesh.AddSubmesh(0, std::move(vertices), std::move(indices));
+		return ret;
+	}
+
+	size_t GenerateSpheres(size_t triangleCount, uint32_t seed, MeshWork& outMesh)
+	{
+		static const int kSphereCount = 4;
+
+		Random rnd(seed);
+		uint32_t rings = GetSphereRings(triangleCount / kSphereCount);
+		size_t ret = 0;
+		for (int i = 0; i < kSphereCount; i++)
+		{
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+			DirectX::XMFLOAT3 center(rnd.NextFloat(-50.0f, 50.0f), rnd.NextFloat(-50.0f, 50.0f), rnd.NextFloat(-50.0f, 50.0f));
+			AppendSphere(vertices, indices, center, rnd.NextFloat(5.0f, 20.0f), rings, rings * 2);
+
+			ret += indices.size() / 3;
+			outMesh.AddSubmesh(i % 2, std::move(vertices), std::move(indices));
+		}
+		return ret;
+	}
+
+	size_t GenerateScan(size_t triangleCount, uint32_t seed, MeshWork& outMesh)
+	{
+		Random rnd(seed);
+		uint32_t rings = GetSphereRings(triangleCount);
+		float radius = 20.0f;
+
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		AppendSphere(vertices, indices, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), radius, rings, rings * 2);
+
+		// displace along the normal with noise.
+		float noise = radius * kPi / (float)rings * 0.3f;
+		for (auto&& v : vertices)
+		{
+			float d = rnd.NextFloat(-noise, noise);
+			v.pos.x += v.normal.x * d;
+			v.pos.y += v.normal.y * d;
+			v.pos.z += v.normal.z * d;
+		}
+
+		// scanners do not output vertices and triangles in a cache friendly order.
+		std::vector<uint32_t> remap(vertices.size());
+		for (uint32_t i = 0; i < (uint32_t)remap.size(); i++)
+		{
+			remap[i] = i;
+		}
+		for (size_t i = remap.size() - 1; i > 0; i--)
+		{
+			std::swap(remap[i], remap[rnd.Next() % (i + 1)]);
+		}
+		std::vector<Vertex> shuffled_vertices(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			shuffled_vertices[remap[i]] = vertices[i];
+		}
+		for (auto&& index : indices)
+		{
+			index = remap[index];
+		}
+
+		size_t tri_count = indices.size() / 3;
+		for (size_t i = tri_count - 1; i > 0; i--)
+		{
+			size_t j = rnd.Next() % (i + 1);
+			std::swap(indices[i * 3 + 0], indices[j * 3 + 0]);
+			std::swap(indices[i * 3 + 1], indices[j * 3 + 1]);
+			std::swap(indices[i * 3 + 2], indices[j * 3 + 2]);
+		}
+
+		outMesh.AddSubmesh(0, std::move(shuffled_vertices), std::move(indices));
+		return tri_count;
+	}
+
+	size_t GenerateManyPrimitives(size_t triangleCount, uint32_t seed, MeshWork& outMesh)
+	{
+		static const uint32_t kRings = 7;
+		static const size_t kPrimitiveTriangles = kRings * kRings * 4;
+		static const int kMaterialCount = 16;
+
+		Random rnd(seed);
+		size_t prim_count = std::max(triangleCount / kPrimitiveTriangles, (size_t)1);
+		size_t ret = 0;
+		for (size_t i = 0; i < prim_count; i++)
+		{
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+			DirectX::XMFLOAT3 center(rnd.NextFloat(-100.0f, 100.0f), rnd.NextFloat(-100.0f, 100.0f), rnd.NextFloat(-100.0f, 100.0f));
+			AppendSphere(vertices, indices, center, rnd.NextFloat(0.1f, 1.0f), kRings, kRings * 2);
+
+			ret += indices.size() / 3;
+			outMesh.AddSubmesh((int)(i % kMaterialCount), std::move(vertices), std::move(indices));
+		}
+		return ret;
+	}
+}
+
+const char* GetSceneKindName(SceneKind::Type kind)
+{
+	static const char* kNames[] = {
+		"grid",
+		"sphere",
+		"scan",
+		"many",
+	};
+	static_assert(sizeof(kNames) / sizeof(kNames[0]) == SceneKind::Max, "scene name count mismatch.");
+	return kNames[kind];
+}
+
+bool ParseSceneKind(const std::string& name, SceneKind::Type& outKind)
+{
+	for (int i = 0; i < SceneKind::Max; i++)
+	{
+		if (name == GetSceneKindName((SceneKind::Type)i))
+		{
+			outKind = (SceneKind::Type)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+size_t GenerateScene(SceneKind::Type kind, size_t triangleCount, uint32_t seed, MeshWork& outMesh)
+{
+	switch (kind)
+	{
+	case SceneKind::Grid:			return GenerateGrid(triangleCount, seed, outMesh);
+	case SceneKind::Sphere:			return GenerateSpheres(triangleCount, seed, outMesh);
+	case SceneKind::Scan:			return GenerateScan(triangleCount, seed, outMesh);
+	case SceneKind::ManyPrimitives:	return GenerateManyPrimitives(triangleCount, seed, outMesh);
+	default:						return 0;
+	}
+}
+
+
+//	EOF
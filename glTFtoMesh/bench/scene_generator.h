@@ -0,0 +1,31 @@
+﻿#pragma once
+
+#include <string>
+#include <cstdint>
+
+class MeshWork;
+
+
+// procedural scenes for benchmarks of the mesh stages.
+struct SceneKind
+{
+	enum Type
+	{
+		Grid,				// one large height field.
+		Sphere,				// a few UV spheres, two submeshes share each material.
+		Scan,				// noisy sphere with shuffled vertices and triangles, like raw scan data.
+		ManyPrimitives,		// many small spheres, each one is a submesh.
+
+		Max
+	};
+};	// struct SceneKind
+
+const char* GetSceneKindName(SceneKind::Type kind);
+bool ParseSceneKind(const std::string& name, SceneKind::Type& outKind);
+
+// add submeshes of about triangleCount triangles to the mesh.
+// the same seed always generates the same scene.
+// return the actual triangle count.
+size_t GenerateScene(SceneKind::Type kind, size_t triangleCount, uint32_t seed, MeshWork& outMesh);
+
+//	EOF
@@ -0,0 +1,1025 @@
+﻿#include "bc_encoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BC_ENCODER_SSE2
+#include <emmintrin.h>
+#endif
+
+
+namespace
+{
+	// pixels of a block for the index search.
+	// channels are int16 and interleaved in pairs, so that _mm_madd_epi16 sums two squared differences.
+	struct BlockPixels
+	{
+		alignas(16) int16_t	rg[32];		// r0, g0, r1, g1, ...
+		alignas(16) int16_t	ba[32];		// b0, a0, b1, a1, ...
+	};	// struct BlockPixels
+
+	// if useAlpha is false, alpha is ignored in the index search.
+	void SetupBlockPixels(const uint8_t* pPixels, bool useAlpha, BlockPixels& outPixels)
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			outPixels.rg[i * 2 + 0] = pPixels[i * 4 + 0];
+			outPixels.rg[i * 2 + 1] = pPixels[i * 4 + 1];
+			outPixels.ba[i * 2 + 0] = pPixels[i * 4 + 2];
+			outPixels.ba[i * 2 + 1] = useAlpha ? pPixels[i * 4 + 3] : 0;
+		}
+	}
+
+	// find the nearest palette entry of each pixel, and return the sum of squared errors.
+	// the first entry wins ties, so the SIMD and scalar paths give the same result.
+	uint32_t FindNearestIndices(const BlockPixels& pixels, const int (*pPalette)[4], int paletteCount, bool useAlpha, uint8_t* pOutIndices, uint32_t* pOutErrors)
+	{
+#if defined(BC_ENCODER_SSE2)
+		__m128i rg[4], ba[4], best_error[4], best_index[4];
+		for (int k = 0; k < 4; k++)
+		{
+			rg[k] = _mm_load_si128(reinterpret_cast<const __m128i*>(&pixels.rg[k * 8]));
+			ba[k] = _mm_load_si128(reinterpret_cast<const __m128i*>(&pixels.ba[k * 8]));
+			best_error[k] = _mm_set1_epi32(0x7fffffff);
+			best_index[k] = _mm_setzero_si128();
+		}
+		for (int p = 0; p < paletteCount; p++)
+		{
+			uint32_t alpha = useAlpha ? (uint32_t)pPalette[p][3] : 0;
+			__m128i palette_rg = _mm_set1_epi32((int)((uint32_t)pPalette[p][0] | ((uint32_t)pPalette[p][1] << 16)));
+			__m128i palette_ba = _mm_set1_epi32((int)((uint32_t)pPalette[p][2] | (alpha << 16)));
+			__m128i index = _mm_set1_epi32(p);
+			for (int k = 0; k < 4; k++)
+			{
+				__m128i diff_rg = _mm_sub_epi16(rg[k], palette_rg);
+				__m128i diff_ba = _mm_sub_epi16(ba[k], palette_ba);
+				__m128i error = _mm_add_epi32(_mm_madd_epi16(diff_rg, diff_rg), _mm_madd_epi16(diff_ba, diff_ba));
+				__m128i less = _mm_cmplt_epi32(error, best_error[k]);
+				best_error[k] = _mm_or_si128(_mm_and_si128(less, error), _mm_andnot_si128(less, best_error[k]));
+				best_index[k] = _mm_or_si128(_mm_and_si128(less, index), _mm_andnot_si128(less, best_index[k]));
+			}
+		}
+		alignas(16) uint32_t errors[16];
+		alignas(16) uint32_t indices[16];
+		for (int k = 0; k < 4; k++)
+		{
+			_mm_store_si128(reinterpret_cast<__m128i*>(&errors[k * 4]), best_error[k]);
+			_mm_store_si128(reinterpret_cast<__m128i*>(&indices[k * 4]), best_index[k]);
+		}
+		uint32_t total = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			pOutIndices[i] = (uint8_t)indices[i];
+			if (pOutErrors)
+			{
+				pOutErrors[i] = errors[i];
+			}
+			total += errors[i];
+		}
+		return total;
+#else
+		uint32_t total = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			uint32_t best_error = 0x7fffffff;
+			uint8_t best_index = 0;
+			for (int p = 0; p < paletteCount; p++)
+			{
+				int dr = pixels.rg[i * 2 + 0] - pPalette[p][0];
+				int dg = pixels.rg[i * 2 + 1] - pPalette[p][1];
+				int db = pixels.ba[i * 2 + 0] - pPalette[p][2];
+				int da = pixels.ba[i * 2 + 1] - (useAlpha ? pPalette[p][3] : 0);
+				uint32_t error = (uint32_t)(dr * dr + dg * dg + db * db + da * da);
+				if (error < best_error)
+				{
+					best_error = error;
+					best_index = (uint8_t)p;
+				}
+			}
+			pOutIndices[i] = best_index;
+			if (pOutErrors)
+			{
+				pOutErrors[i] = best_error;
+			}
+			total += best_error;
+		}
+		return total;
+#endif
+	}
+
+	// pSubsets selects the pixels of the subset. if null, all pixels are used.
+	bool IsInSubset(const uint8_t* pSubsets, int subset, int pixel)
+	{
+		return !pSubsets || pSubsets[pixel] == subset;
+	}
+
+	// fit endpoints to the principal axis of the pixels. endpoints are the extremes of the projections.
+	void FitEndpoints(const uint8_t* pPixels, const uint8_t* pSubsets, int subset, int channels, float* pOutE0, float* pOutE1)
+	{
+		float mean[4] = {};
+		int count = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			if (IsInSubset(pSubsets, subset, i))
+			{
+				for (int c = 0; c < channels; c++)
+				{
+					mean[c] += pPixels[i * 4 + c];
+				}
+				count++;
+			}
+		}
+		if (count == 0)
+		{
+			for (int c = 0; c < channels; c++)
+			{
+				pOutE0[c] = pOutE1[c] = 0.0f;
+			}
+			return;
+		}
+		for (int c = 0; c < channels; c++)
+		{
+			mean[c] /= (float)count;
+		}
+
+		float cov[4][4] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			if (!IsInSubset(pSubsets, subset, i))
+			{
+				continue;
+			}
+			float d[4];
+			for (int c = 0; c < channels; c++)
+			{
+				d[c] = pPixels[i * 4 + c] - mean[c];
+			}
+			for (int r = 0; r < channels; r++)
+			{
+				for (int c = 0; c < channels; c++)
+				{
+					cov[r][c] += d[r] * d[c];
+				}
+			}
+		}
+
+		// power iteration from the covariance column of the channel which has the largest variance.
+		// a fixed start such as (1, 1, 1, 1) is orthogonal to the axis of anticorrelated channels (e.g. red to green gradients),
+		// and the iteration collapses to zero. the column is never orthogonal to the principal axis unless the block is flat.
+		int max_channel = 0;
+		for (int c = 1; c < channels; c++)
+		{
+			if (cov[c][c] > cov[max_channel][max_channel])
+			{
+				max_channel = c;
+			}
+		}
+		float axis[4] = {};
+		for (int c = 0; c < channels; c++)
+		{
+			axis[c] = cov[max_channel][c];
+		}
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = {};
+			float length = 0.0f;
+			for (int r = 0; r < channels; r++)
+			{
+				for (int c = 0; c < channels; c++)
+				{
+					next[r] += cov[r][c] * axis[c];
+				}
+				length = std::max(length, std::fabs(next[r]));
+			}
+			if (length < 1e-6f)
+			{
+				break;
+			}
+			for (int c = 0; c < channels; c++)
+			{
+				axis[c] = next[c] / length;
+			}
+		}
+		float length = 0.0f;
+		for (int c = 0; c < channels; c++)
+		{
+			length += axis[c] * axis[c];
+		}
+		length = std::sqrt(length);
+		for (int c = 0; c < channels; c++)
+		{
+			axis[c] = (length > 1e-6f) ? axis[c] / length : 0.0f;
+		}
+
+		float t_min = 0.0f, t_max = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			if (!IsInSubset(pSubsets, subset, i))
+			{
+				continue;
+			}
+			float t = 0.0f;
+			for (int c = 0; c < channels; c++)
+			{
+				t += (pPixels[i * 4 + c] - mean[c]) * axis[c];
+			}
+			t_min = std::min(t_min, t);
+			t_max = std::max(t_max, t);
+		}
+		for (int c = 0; c < channels; c++)
+		{
+			pOutE0[c] = std::min(std::max(mean[c] + axis[c] * t_min, 0.0f), 255.0f);
+			pOutE1[c] = std::min(std::max(mean[c] + axis[c] * t_max, 0.0f), 255.0f);
+		}
+	}
+
+	// least squares endpoints for the interpolation weights of the pixels. (0 is e0, 1 is e1)
+	// returns false if the weights can not determine the endpoints.
+	bool RefineEndpoints(const uint8_t* pPixels, const uint8_t* pSubsets, int subset, int channels, const float* pWeights, float* pOutE0, float* pOutE1)
+	{
+		float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+		float ax[4] = {}, bx[4] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			if (!IsInSubset(pSubsets, subset, i))
+			{
+				continue;
+			}
+			float b = pWeights[i];
+			float a = 1.0f - b;
+			aa += a * a;
+			bb += b * b;
+			ab += a * b;
+			for (int c = 0; c < channels; c++)
+			{
+				ax[c] += a * pPixels[i * 4 + c];
+				bx[c] += b * pPixels[i * 4 + c];
+			}
+		}
+		float det = aa * bb - ab * ab;
+		if (std::fabs(det) < 1e-6f)
+		{
+			return false;
+		}
+		float inv_det = 1.0f / det;
+		for (int c = 0; c < channels; c++)
+		{
+			pOutE0[c] = std::min(std::max((ax[c] * bb - bx[c] * ab) * inv_det, 0.0f), 255.0f);
+			pOutE1[c] = std::min(std::max((bx[c] * aa - ax[c] * ab) * inv_det, 0.0f), 255.0f);
+		}
+		return true;
+	}
+
+	// 128 bit block, written from the lowest bit.
+	class BlockBitWriter
+	{
+	public:
+		explicit BlockBitWriter(uint8_t* pDst)
+			: pDst_(pDst)
+		{
+			memset(pDst_, 0, 16);
+		}
+
+		void Write(uint32_t value, uint32_t bits)
+		{
+			for (uint32_t i = 0; i < bits; i++, position_++)
+			{
+				if ((value >> i) & 1)
+				{
+					pDst_[position_ >> 3] |= (uint8_t)(1 << (position_ & 7));
+				}
+			}
+		}
+
+	private:
+		uint8_t*	pDst_;
+		uint32_t	position_ = 0;
+	};	// class BlockBitWriter
+
+	//----------------------------------------------------------------
+	// BC1
+	//----------------------------------------------------------------
+	uint16_t PackRGB565(const float* pColor)
+	{
+		int r = std::min(std::max((int)(pColor[0] * 31.0f / 255.0f + 0.5f), 0), 31);
+		int g = std::min(std::max((int)(pColor[1] * 63.0f / 255.0f + 0.5f), 0), 63);
+		int b = std::min(std::max((int)(pColor[2] * 31.0f / 255.0f + 0.5f), 0), 31);
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	void UnpackRGB565(uint16_t color, int* pOut)
+	{
+		int r = (color >> 11) & 31;
+		int g = (color >> 5) & 63;
+		int b = color & 31;
+		pOut[0] = (r << 3) | (r >> 2);
+		pOut[1] = (g << 2) | (g >> 4);
+		pOut[2] = (b << 3) | (b >> 2);
+		pOut[3] = 0;
+	}
+
+	struct BC1Block
+	{
+		uint16_t	color0;
+		uint16_t	color1;
+		uint8_t		indices[16];
+		uint32_t	error;
+	};	// struct BC1Block
+
+	// 4 color mode. color0 > color1 is kept, so the block is the same in BC1 and BC3.
+	void EncodeBC1Colors(const BlockPixels& pixels, uint16_t color0, uint16_t color1, BC1Block& outBlock)
+	{
+		if (color0 < color1)
+		{
+			std::swap(color0, color1);
+		}
+		int palette[4][4];
+		UnpackRGB565(color0, palette[0]);
+		UnpackRGB565(color1, palette[1]);
+		for (int c = 0; c < 4; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		outBlock.color0 = color0;
+		outBlock.color1 = color1;
+		// if the colors are the same, the block is in 3 color mode, and only index 0 is safe.
+		outBlock.error = FindNearestIndices(pixels, palette, (color0 == color1) ? 1 : 4, false, outBlock.indices, nullptr);
+	}
+
+	void EncodeBC1(const uint8_t* pPixels, uint32_t quality, uint8_t* pDst)
+	{
+		BlockPixels pixels;
+		SetupBlockPixels(pPixels, false, pixels);
+
+		float e0[4], e1[4];
+		FitEndpoints(pPixels, nullptr, 0, 3, e0, e1);
+		BC1Block best;
+		EncodeBC1Colors(pixels, PackRGB565(e1), PackRGB565(e0), best);
+
+		if (quality == BCQuality::Final)
+		{
+			static const float kWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+			for (int iteration = 0; iteration < 2 && best.error > 0; iteration++)
+			{
+				float weights[16];
+				for (int i = 0; i < 16; i++)
+				{
+					weights[i] = kWeights[best.indices[i]];
+				}
+				if (!RefineEndpoints(pPixels, nullptr, 0, 3, weights, e0, e1))
+				{
+					break;
+				}
+				BC1Block block;
+				EncodeBC1Colors(pixels, PackRGB565(e0), PackRGB565(e1), block);
+				if (block.error >= best.error)
+				{
+					break;
+				}
+				best = block;
+			}
+		}
+
+		uint32_t bits = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			bits |= (uint32_t)best.indices[i] << (i * 2);
+		}
+		memcpy(pDst + 0, &best.color0, 2);
+		memcpy(pDst + 2, &best.color1, 2);
+		memcpy(pDst + 4, &bits, 4);
+	}
+
+	//----------------------------------------------------------------
+	// BC4 (also the alpha block of BC3)
+	//----------------------------------------------------------------
+	struct BC4Block
+	{
+		uint8_t		value0;
+		uint8_t		value1;
+		uint8_t		indices[16];
+		uint32_t	error;
+	};	// struct BC4Block
+
+	// value0 > value1 is the 8 value mode, otherwise the 6 value mode with 0 and 255.
+	void EncodeBC4Values(const uint8_t* pValues, int value0, int value1, BC4Block& outBlock)
+	{
+		int palette[8];
+		palette[0] = value0;
+		palette[1] = value1;
+		if (value0 > value1)
+		{
+			for (int i = 2; i < 8; i++)
+			{
+				palette[i] = ((8 - i) * value0 + (i - 1) * value1 + 3) / 7;
+			}
+		}
+		else
+		{
+			for (int i = 2; i < 6; i++)
+			{
+				palette[i] = ((6 - i) * value0 + (i - 1) * value1 + 2) / 5;
+			}
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+
+		outBlock.value0 = (uint8_t)value0;
+		outBlock.value1 = (uint8_t)value1;
+		outBlock.error = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			int best_error = 0x7fffffff;
+			for (int p = 0; p < 8; p++)
+			{
+				int d = pValues[i] - palette[p];
+				if (d * d < best_error)
+				{
+					best_error = d * d;
+					outBlock.indices[i] = (uint8_t)p;
+				}
+			}
+			outBlock.error += (uint32_t)best_error;
+		}
+	}
+
+	void EncodeBC4Channel(const uint8_t* pPixels, int channel, uint32_t quality, uint8_t* pDst)
+	{
+		uint8_t values[16];
+		int min_value = 255, max_value = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			values[i] = pPixels[i * 4 + channel];
+			min_value = std::min(min_value, (int)values[i]);
+			max_value = std::max(max_value, (int)values[i]);
+		}
+
+		BC4Block best;
+		EncodeBC4Values(values, max_value, min_value, best);
+
+		if (quality == BCQuality::Final && best.error > 0)
+		{
+			// 6 value mode for the values except 0 and 255, which are exact in this mode.
+			int inner_min = 255, inner_max = 0;
+			for (auto v : values)
+			{
+				if (v != 0 && v != 255)
+				{
+					inner_min = std::min(inner_min, (int)v);
+					inner_max = std::max(inner_max, (int)v);
+				}
+			}
+			if (inner_min <= inner_max)
+			{
+				BC4Block block;
+				EncodeBC4Values(values, inner_min, inner_max, block);
+				if (block.error < best.error)
+				{
+					best = block;
+				}
+			}
+
+			// least squares refinement of the 8 value mode.
+			static const float kWeights[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+			if (best.value0 > best.value1)
+			{
+				uint8_t expanded[64] = {};
+				float weights[16];
+				for (int i = 0; i < 16; i++)
+				{
+					expanded[i * 4] = values[i];
+					weights[i] = kWeights[best.indices[i]];
+				}
+				float e0, e1;
+				if (RefineEndpoints(expanded, nullptr, 0, 1, weights, &e0, &e1))
+				{
+					int value0 = (int)(e0 + 0.5f), value1 = (int)(e1 + 0.5f);
+					if (value0 < value1)
+					{
+						std::swap(value0, value1);
+					}
+					if (value0 > value1)
+					{
+						BC4Block block;
+						EncodeBC4Values(values, value0, value1, block);
+						if (block.error < best.error)
+						{
+							best = block;
+						}
+					}
+				}
+			}
+		}
+
+		uint64_t bits = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			bits |= (uint64_t)best.indices[i] << (i * 3);
+		}
+		pDst[0] = best.value0;
+		pDst[1] = best.value1;
+		for (int i = 0; i < 6; i++)
+		{
+			pDst[2 + i] = (uint8_t)(bits >> (i * 8));
+		}
+	}
+
+	//----------------------------------------------------------------
+	// BC7
+	//----------------------------------------------------------------
+	const int kWeights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	const int kWeights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// 2 subset partitions. bit i is the subset of pixel i.
+	const uint16_t kPartitions2[64] = {
+		0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+		0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+		0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+		0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+		0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+		0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+		0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+		0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22,
+	};
+
+	// anchor pixel of subset 1. the anchor of subset 0 is pixel 0.
+	const uint8_t kAnchors2[64] = {
+		15, 15, 15, 15, 15, 15, 15, 15,
+		15, 15, 15, 15, 15, 15, 15, 15,
+		15,  2,  8,  2,  2,  8,  8, 15,
+		 2,  8,  2,  2,  8,  8,  2,  2,
+		15, 15,  6,  8,  2,  8, 15, 15,
+		 2,  8,  2,  2,  2, 15, 15,  6,
+		 6,  2,  6,  8, 15, 15,  2,  2,
+		15, 15, 15, 15, 15,  2,  2, 15,
+	};
+
+	int Interpolate(int e0, int e1, int weight)
+	{
+		return ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+	}
+
+	// mode 6: 1 subset, RGBA 7 bit endpoints with a p-bit each, 4 bit indices.
+	struct Mode6Block
+	{
+		int			endpoints[2][4];	// 7 bit
+		int			pbits[2];
+		uint8_t		indices[16];
+		uint32_t	error;
+	};	// struct Mode6Block
+
+	int QuantizeMode6(float value, int pbit)
+	{
+		return std::min(std::max((int)((value - pbit) * 0.5f + 0.5f), 0), 127);
+	}
+
+	// p-bit of one endpoint with the smallest quantization error.
+	int SelectMode6PBit(const float* pEndpoint)
+	{
+		float errors[2] = {};
+		for (int p = 0; p < 2; p++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				float d = pEndpoint[c] - (float)((QuantizeMode6(pEndpoint[c], p) << 1) | p);
+				errors[p] += d * d;
+			}
+		}
+		return (errors[1] < errors[0]) ? 1 : 0;
+	}
+
+	void EncodeMode6Endpoints(const BlockPixels& pixels, const float* pE0, const float* pE1, int pbit0, int pbit1, Mode6Block& outBlock)
+	{
+		int values[2][4];
+		for (int c = 0; c < 4; c++)
+		{
+			outBlock.endpoints[0][c] = QuantizeMode6(pE0[c], pbit0);
+			outBlock.endpoints[1][c] = QuantizeMode6(pE1[c], pbit1);
+			values[0][c] = (outBlock.endpoints[0][c] << 1) | pbit0;
+			values[1][c] = (outBlock.endpoints[1][c] << 1) | pbit1;
+		}
+		outBlock.pbits[0] = pbit0;
+		outBlock.pbits[1] = pbit1;
+
+		int palette[16][4];
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				palette[i][c] = Interpolate(values[0][c], values[1][c], kWeights4[i]);
+			}
+		}
+		outBlock.error = FindNearestIndices(pixels, palette, 16, true, outBlock.indices, nullptr);
+	}
+
+	void EncodeMode6(const uint8_t* pPixels, const BlockPixels& pixels, uint32_t quality, Mode6Block& outBlock)
+	{
+		float e0[4], e1[4];
+		FitEndpoints(pPixels, nullptr, 0, 4, e0, e1);
+		EncodeMode6Endpoints(pixels, e0, e1, SelectMode6PBit(e0), SelectMode6PBit(e1), outBlock);
+		if (quality != BCQuality::Final)
+		{
+			return;
+		}
+
+		for (int iteration = 0; iteration < 2 && outBlock.error > 0; iteration++)
+		{
+			float weights[16];
+			for (int i = 0; i < 16; i++)
+			{
+				weights[i] = kWeights4[outBlock.indices[i]] / 64.0f;
+			}
+			if (!RefineEndpoints(pPixels, nullptr, 0, 4, weights, e0, e1))
+			{
+				break;
+			}
+			Mode6Block best = outBlock;
+			for (int p = 0; p < 4; p++)
+			{
+				Mode6Block block;
+				EncodeMode6Endpoints(pixels, e0, e1, p & 1, p >> 1, block);
+				if (block.error < best.error)
+				{
+					best = block;
+				}
+			}
+			if (best.error >= outBlock.error)
+			{
+				break;
+			}
+			outBlock = best;
+		}
+	}
+
+	void WriteMode6(Mode6Block block, uint8_t* pDst)
+	{
+		// the highest index bit of the anchor is implicit 0.
+		if (block.indices[0] & 8)
+		{
+			std::swap(block.endpoints[0], block.endpoints[1]);
+			std::swap(block.pbits[0], block.pbits[1]);
+			for (auto&& index : block.indices)
+			{
+				index = (uint8_t)(15 - index);
+			}
+		}
+
+		BlockBitWriter writer(pDst);
+		writer.Write(1 << 6, 7);
+		for (int c = 0; c < 4; c++)
+		{
+			writer.Write(block.endpoints[0][c], 7);
+			writer.Write(block.endpoints[1][c], 7);
+		}
+		writer.Write(block.pbits[0], 1);
+		writer.Write(block.pbits[1], 1);
+		for (int i = 0; i < 16; i++)
+		{
+			writer.Write(block.indices[i], (i == 0) ? 3 : 4);
+		}
+	}
+
+	// mode 1: 2 subsets, RGB 6 bit endpoints with a shared p-bit per subset, 3 bit indices. alpha is 255.
+	struct Mode1Block
+	{
+		int			partition;
+		int			endpoints[2][2][3];		// [subset][endpoint][channel] 6 bit
+		int			pbits[2];
+		uint8_t		indices[16];
+		uint32_t	error;
+	};	// struct Mode1Block
+
+	int ExpandMode1(int value6, int pbit)
+	{
+		int value7 = (value6 << 1) | pbit;
+		return (value7 << 1) | (value7 >> 6);
+	}
+
+	int QuantizeMode1(float value, int pbit)
+	{
+		int base = std::min(std::max((int)((value - 2.0f * pbit) * 0.25f), 0), 63);
+		int best = base;
+		float best_error = std::fabs(value - ExpandMode1(base, pbit));
+		if (base < 63 && std::fabs(value - ExpandMode1(base + 1, pbit)) < best_error)
+		{
+			best = base + 1;
+		}
+		return best;
+	}
+
+	// encode one subset of mode 1 with both p-bits, and keep the better one.
+	uint32_t EncodeMode1Subset(const BlockPixels& pixels, const uint8_t* pSubsets, int subset, const float* pE0, const float* pE1, Mode1Block& block)
+	{
+		uint32_t best_error = 0xffffffff;
+		for (int p = 0; p < 2; p++)
+		{
+			int values[2][3];
+			int endpoints[2][3];
+			for (int c = 0; c < 3; c++)
+			{
+				endpoints[0][c] = QuantizeMode1(pE0[c], p);
+				endpoints[1][c] = QuantizeMode1(pE1[c], p);
+				values[0][c] = ExpandMode1(endpoints[0][c], p);
+				values[1][c] = ExpandMode1(endpoints[1][c], p);
+			}
+			int palette[8][4];
+			for (int i = 0; i < 8; i++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					palette[i][c] = Interpolate(values[0][c], values[1][c], kWeights3[i]);
+				}
+				palette[i][3] = 255;
+			}
+			uint8_t indices[16];
+			uint32_t errors[16];
+			FindNearestIndices(pixels, palette, 8, false, indices, errors);
+			uint32_t error = 0;
+			for (int i = 0; i < 16; i++)
+			{
+				if (pSubsets[i] == subset)
+				{
+					error += errors[i];
+				}
+			}
+			if (error < best_error)
+			{
+				best_error = error;
+				memcpy(block.endpoints[subset], endpoints, sizeof(endpoints));
+				block.pbits[subset] = p;
+				for (int i = 0; i < 16; i++)
+				{
+					if (pSubsets[i] == subset)
+					{
+						block.indices[i] = indices[i];
+					}
+				}
+			}
+		}
+		return best_error;
+	}
+
+	void EncodeMode1Partition(const uint8_t* pPixels, const BlockPixels& pixels, int partition, Mode1Block& outBlock)
+	{
+		uint8_t subsets[16];
+		for (int i = 0; i < 16; i++)
+		{
+			subsets[i] = (uint8_t)((kPartitions2[partition] >> i) & 1);
+		}
+		outBlock.partition = partition;
+		outBlock.error = 0;
+		for (int s = 0; s < 2; s++)
+		{
+			float e0[3], e1[3];
+			FitEndpoints(pPixels, subsets, s, 3, e0, e1);
+			uint32_t error = EncodeMode1Subset(pixels, subsets, s, e0, e1, outBlock);
+
+			// one least squares refinement.
+			float weights[16];
+			for (int i = 0; i < 16; i++)
+			{
+				weights[i] = kWeights3[outBlock.indices[i]] / 64.0f;
+			}
+			if (error > 0 && RefineEndpoints(pPixels, subsets, s, 3, weights, e0, e1))
+			{
+				Mode1Block refined = outBlock;
+				uint32_t refined_error = EncodeMode1Subset(pixels, subsets, s, e0, e1, refined);
+				if (refined_error < error)
+				{
+					outBlock = refined;
+					error = refined_error;
+				}
+			}
+			outBlock.error += error;
+		}
+	}
+
+	// rough error of a partition. the variance which is not on the principal axis of each subset.
+	float EstimatePartitionError(const uint8_t* pPixels, int partition)
+	{
+		float total = 0.0f;
+		for (int s = 0; s < 2; s++)
+		{
+			uint8_t subsets[16];
+			for (int i = 0; i < 16; i++)
+			{
+				subsets[i] = (uint8_t)((kPartitions2[partition] >> i) & 1);
+			}
+			float e0[3], e1[3];
+			FitEndpoints(pPixels, subsets, s, 3, e0, e1);
+			float axis[3] = { e1[0] - e0[0], e1[1] - e0[1], e1[2] - e0[2] };
+			float length2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+			for (int i = 0; i < 16; i++)
+			{
+				if (subsets[i] != s)
+				{
+					continue;
+				}
+				float d[3] = { pPixels[i * 4 + 0] - e0[0], pPixels[i * 4 + 1] - e0[1], pPixels[i * 4 + 2] - e0[2] };
+				float t = (length2 > 0.0f) ? std::min(std::max((d[0] * axis[0] + d[1] * axis[1] + d[2] * axis[2]) / length2, 0.0f), 1.0f) : 0.0f;
+				for (int c = 0; c < 3; c++)
+				{
+					float r = d[c] - axis[c] * t;
+					total += r * r;
+				}
+			}
+		}
+		return total;
+	}
+
+	void WriteMode1(Mode1Block block, uint8_t* pDst)
+	{
+		// the highest index bits of the anchors are implicit 0.
+		int anchors[2] = { 0, kAnchors2[block.partition] };
+		for (int s = 0; s < 2; s++)
+		{
+			if (block.indices[anchors[s]] & 4)
+			{
+				std::swap(block.endpoints[s][0], block.endpoints[s][1]);
+				for (int i = 0; i < 16; i++)
+				{
+					if (((kPartitions2[block.partition] >> i) & 1) == s)
+					{
+						block.indices[i] = (uint8_t)(7 - block.indices[i]);
+					}
+				}
+			}
+		}
+
+		BlockBitWriter writer(pDst);
+		writer.Write(1 << 1, 2);
+		writer.Write(block.partition, 6);
+		for (int c = 0; c < 3; c++)
+		{
+			for (int s = 0; s < 2; s++)
+			{
+				writer.Write(block.endpoints[s][0][c], 6);
+				writer.Write(block.endpoints[s][1][c], 6);
+			}
+		}
+		writer.Write(block.pbits[0], 1);
+		writer.Write(block.pbits[1], 1);
+		for (int i = 0; i < 16; i++)
+		{
+			writer.Write(block.indices[i], (i == anchors[0] || i == anchors[1]) ? 2 : 3);
+		}
+	}
+
+	void EncodeBC7(const uint8_t* pPixels, uint32_t quality, uint8_t* pDst)
+	{
+		BlockPixels pixels;
+		SetupBlockPixels(pPixels, true, pixels);
+
+		Mode6Block mode6;
+		EncodeMode6(pPixels, pixels, quality, mode6);
+
+		bool is_opaque = true;
+		for (int i = 0; i < 16; i++)
+		{
+			is_opaque = is_opaque && (pPixels[i * 4 + 3] == 255);
+		}
+		if (quality != BCQuality::Final || !is_opaque || mode6.error == 0)
+		{
+			WriteMode6(mode6, pDst);
+			return;
+		}
+
+		// full encoding of the most promising partitions.
+		static const int kCandidateCount = 4;
+		int candidates[kCandidateCount];
+		float candidate_errors[kCandidateCount];
+		for (int i = 0; i < kCandidateCount; i++)
+		{
+			candidates[i] = -1;
+			candidate_errors[i] = 1e30f;
+		}
+		for (int partition = 0; partition < 64; partition++)
+		{
+			float error = EstimatePartitionError(pPixels, partition);
+			for (int i = 0; i < kCandidateCount; i++)
+			{
+				if (error < candidate_errors[i])
+				{
+					for (int j = kCandidateCount - 1; j > i; j--)
+					{
+						candidates[j] = candidates[j - 1];
+						candidate_errors[j] = candidate_errors[j - 1];
+					}
+					candidates[i] = partition;
+					candidate_errors[i] = error;
+					break;
+				}
+			}
+		}
+
+		SetupBlockPixels(pPixels, false, pixels);
+		Mode1Block best_mode1 = {};
+		best_mode1.error = 0xffffffff;
+		for (int i = 0; i < kCandidateCount; i++)
+		{
+			Mode1Block block;
+			EncodeMode1Partition(pPixels, pixels, candidates[i], block);
+			if (block.error < best_mode1.error)
+			{
+				best_mode1 = block;
+			}
+		}
+		if (best_mode1.error < mode6.error)
+		{
+			WriteMode1(best_mode1, pDst);
+		}
+		else
+		{
+			WriteMode6(mode6, pDst);
+		}
+	}
+
+	// 4x4 pixels at the block. pixels outside of the image are clamped to the edges.
+	void LoadBlock(const RGBAImageView& image, uint32_t blockX, uint32_t blockY, uint8_t* pOut)
+	{
+		for (uint32_t y = 0; y < 4; y++)
+		{
+			uint32_t sy = std::min(blockY * 4 + y, image.height - 1);
+			for (uint32_t x = 0; x < 4; x++)
+			{
+				uint32_t sx = std::min(blockX * 4 + x, image.width - 1);
+				memcpy(pOut + (y * 4 + x) * 4, image.pPixels + ((size_t)sy * image.width + sx) * 4, 4);
+			}
+		}
+	}
+}
+
+size_t GetBCBlockSize(uint32_t format)
+{
+	return (format == BCFormat::BC1 || format == BCFormat::BC4) ? 8 : 16;
+}
+
+size_t GetBCImageSize(uint32_t format, uint32_t width, uint32_t height)
+{
+	return (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4) * GetBCBlockSize(format);
+}
+
+void EncodeBCBlock(uint32_t format, uint32_t quality, const uint8_t* pPixels, uint8_t* pDst)
+{
+	switch (format)
+	{
+	case BCFormat::BC1:
+		EncodeBC1(pPixels, quality, pDst);
+		break;
+	case BCFormat::BC3:
+		EncodeBC4Channel(pPixels, 3, quality, pDst);
+		EncodeBC1(pPixels, quality, pDst + 8);
+		break;
+	case BCFormat::BC4:
+		EncodeBC4Channel(pPixels, 0, quality, pDst);
+		break;
+	case BCFormat::BC5:
+		EncodeBC4Channel(pPixels, 0, quality, pDst);
+		EncodeBC4Channel(pPixels, 1, quality, pDst + 8);
+		break;
+	default:
+		EncodeBC7(pPixels, quality, pDst);
+		break;
+	}
+}
+
+void CompressBCMips(const std::vector<RGBAImageView>& mips, uint32_t format, uint32_t quality, JobSystem* pJobSystem, std::vector<std::vector<uint8_t>>& outMips)
+{
+	// a task is one block row of one mip, so small mips do not wait for large ones.
+	struct Task
+	{
+		uint32_t	mip;
+		uint32_t	blockY;
+	};	// struct Task
+	std::vector<Task> tasks;
+	outMips.resize(mips.size());
+	for (uint32_t mip = 0; mip < (uint32_t)mips.size(); mip++)
+	{
+		outMips[mip].resize(GetBCImageSize(format, mips[mip].width, mips[mip].height));
+		for (uint32_t y = 0; y < (mips[mip].height + 3) / 4; y++)
+		{
+			tasks.push_back(Task{ mip, y });
+		}
+	}
+
+	size_t block_size = GetBCBlockSize(format);
+	ParallelFor(pJobSystem, tasks.size(), [&](size_t index)
+	{
+		auto&& task = tasks[index];
+		auto&& image = mips[task.mip];
+		uint32_t blocks_x = (image.width + 3) / 4;
+		uint8_t* pDst = outMips[task.mip].data() + (size_t)task.blockY * blocks_x * block_size;
+		uint8_t pixels[64];
+		for (uint32_t x = 0; x < blocks_x; x++)
+		{
+			LoadBlock(image, x, task.blockY, pixels);
+			EncodeBCBlock(format, quality, pixels, pDst + x * block_size);
+		}
+	});
+}
+
+
+//	EOF
@@ -0,0 +1,50 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "job_system.h"
+#include "rgba_image.h"
+
+
+// portable BC texture encoder. it does not depend on DirectXTex or COM.
+struct BCFormat
+{
+	enum Type : uint32_t
+	{
+		BC1,		// RGB. 4 bpp.
+		BC3,		// RGBA. 8 bpp.
+		BC4,		// R. 4 bpp.
+		BC5,		// RG. 8 bpp.
+		BC7,		// RGBA. 8 bpp. mode 6, and mode 1 for opaque blocks in Final quality.
+
+		Max
+	};
+};	// struct BCFormat
+
+struct BCQuality
+{
+	enum Type : uint32_t
+	{
+		Fast,		// one principal axis fit per block. for previews.
+		Final,		// least squares refinement, p-bit search and BC7 partitions.
+
+		Max
+	};
+};	// struct BCQuality
+
+// byte size of one 4x4 block.
+size_t GetBCBlockSize(uint32_t format);
+
+// byte size of a compressed image. partial blocks at the right and bottom edges are counted.
+size_t GetBCImageSize(uint32_t format, uint32_t width, uint32_t height);
+
+// encode one 4x4 block. pPixels is 16 RGBA8 pixels in row major order.
+void EncodeBCBlock(uint32_t format, uint32_t quality, const uint8_t* pPixels, uint8_t* pDst);
+
+// compress all mips. blocks of all mips are encoded in parallel.
+// edge pixels are replicated into the partial blocks.
+void CompressBCMips(const std::vector<RGBAImageView>& mips, uint32_t format, uint32_t quality, JobSystem* pJobSystem, std::vector<std::vector<uint8_t>>& outMips);
+
+//	EOF
@@ -0,0 +1,233 @@
+﻿#include "build_cache.h"
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <filesystem>
+
+
+namespace
+{
+	// read only stream buffer on memory. the data is not copied.
+	class MemoryStreamBuf
+		: public std::streambuf
+	{
+	public:
+		MemoryStreamBuf(const char* pData, size_t size)
+		{
+			char* p = const_cast<char*>(pData);
+			setg(p, p, p + size);
+		}
+
+	protected:
+		// readers may measure the size with seekg/tellg.
+		pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+		{
+			if (!(which & std::ios_base::in))
+			{
+				return pos_type(off_type(-1));
+			}
+			off_type base = (dir == std::ios_base::beg) ? 0 : (dir == std::ios_base::cur) ? gptr() - eback() : egptr() - eback();
+			off_type pos = base + off;
+			if (pos < 0 || pos > egptr() - eback())
+			{
+				return pos_type(off_type(-1));
+			}
+			setg(eback(), eback() + pos, egptr());
+			return pos_type(pos);
+		}
+		pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+		{
+			return seekoff(off_type(pos), std::ios_base::beg, which);
+		}
+	};	// class MemoryStreamBuf
+
+	bool ReadFromMemory(const std::string& data, const std::function<bool(std::istream&)>& reader)
+	{
+		MemoryStreamBuf buf(data.data(), data.size());
+		std::istream is(&buf);
+		return reader(is);
+	}
+}
+
+BuildCache::BuildCache(const std::string& rootPath, size_t memoryBudget)
+	: rootPath_(rootPath), isDiskEnabled_(!rootPath.empty()), memoryBudget_(memoryBudget)
+{
+	if (!rootPath_.empty() && rootPath_.back() != '/' && rootPath_.back() != '\\')
+	{
+		rootPath_ += '/';
+	}
+}
+
+BuildCache::MemoryObject BuildCache::FindMemoryObject(const std::string& objectPath) const
+{
+	if (memoryBudget_ == 0)
+	{
+		return nullptr;
+	}
+	std::lock_guard<std::mutex> lock(memoryMutex_);
+	auto it = memoryObjects_.find(objectPath);
+	if (it == memoryObjects_.end())
+	{
+		return nullptr;
+	}
+	memoryLru_.splice(memoryLru_.begin(), memoryLru_, it->second.lruIt);
+	return it->second.object;
+}
+
+void BuildCache::AddMemoryObject(const std::string& objectPath, MemoryObject object) const
+{
+	if (memoryBudget_ == 0 || object->size() > memoryBudget_)
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lock(memoryMutex_);
+	auto it = memoryObjects_.find(objectPath);
+	if (it != memoryObjects_.end())
+	{
+		memoryUsedSize_ -= it->second.object->size();
+		memoryLru_.erase(it->second.lruIt);
+		memoryObjects_.erase(it);
+	}
+	while (!memoryLru_.empty() && memoryUsedSize_ + object->size() > memoryBudget_)
+	{
+		auto evict = memoryObjects_.find(memoryLru_.back());
+		memoryUsedSize_ -= evict->second.object->size();
+		memoryObjects_.erase(evict);
+		memoryLru_.pop_back();
+	}
+	memoryLru_.push_front(objectPath);
+	memoryUsedSize_ += object->size();
+	memoryObjects_[objectPath] = MemoryEntry{ std::move(object), memoryLru_.begin() };
+}
+
+std::string BuildCache::GetObjectPath(const std::string& category, const ContentHash& key) const
+{
+	auto key_str = key.ToString();
+	return rootPath_ + category + "/" + key_str.substr(0, 2) + "/" + key_str;
+}
+
+bool BuildCache::Exists(const std::string& category, const ContentHash& key) const
+{
+	auto path = GetObjectPath(category, key);
+	if (FindMemoryObject(path))
+	{
+		return true;
+	}
+	std::error_code ec;
+	return isDiskEnabled_ && std::filesystem::is_regular_file(path, ec);
+}
+
+bool BuildCache::Load(const std::string& category, const ContentHash& key, const std::function<bool(std::istream&)>& reader) const
+{
+	auto path = GetObjectPath(category, key);
+	MemoryObject object = FindMemoryObject(path);
+	if (object)
+	{
+		return ReadFromMemory(*object, reader);
+	}
+	if (!isDiskEnabled_)
+	{
+		return false;
+	}
+
+	std::ifstream ifs(path, std::ios::in | std::ios::binary);
+	if (!ifs)
+	{
+		return false;
+	}
+	if (memoryBudget_ == 0)
+	{
+		return reader(ifs);
+	}
+
+	// keep the object in memory for the next load.
+	std::stringstream ss;
+	ss << ifs.rdbuf();
+	object = std::make_shared<const std::string>(ss.str());
+	AddMemoryObject(path, object);
+	return ReadFromMemory(*object, reader);
+}
+
+bool BuildCache::Store(const std::string& category, const ContentHash& key, const std::function<bool(std::ostream&)>& writer) const
+{
+	auto path = GetObjectPath(category, key);
+	if (memoryBudget_ == 0)
+	{
+		return isDiskEnabled_ && StoreToDisk(path, writer);
+	}
+
+	std::stringstream ss;
+	if (!writer(ss))
+	{
+		return false;
+	}
+	MemoryObject object = std::make_shared<const std::string>(ss.str());
+	AddMemoryObject(path, object);
+	if (!isDiskEnabled_)
+	{
+		return true;
+	}
+	return StoreToDisk(path, [&](std::ostream& os)
+	{
+		os.write(object->data(), (std::streamsize)object->size());
+		return os.good();
+	});
+}
+
+bool BuildCache::StoreToDisk(const std::string& path, const std::function<bool(std::ostream&)>& writer) const
+{
+	static std::atomic<uint32_t> s_TempCounter{ 0 };
+
+	std::error_code ec;
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+
+	std::stringstream temp_name;
+	temp_name << path << ".tmp" << std::this_thread::get_id() << "_" << s_TempCounter++;
+	auto temp_path = temp_name.str();
+	{
+		std::ofstream ofs(temp_path, std::ios::out | std::ios::binary);
+		if (!ofs || !writer(ofs))
+		{
+			ofs.close();
+			std::filesystem::remove(temp_path, ec);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(temp_path, path, ec);
+	if (ec)
+	{
+		std::filesystem::remove(temp_path, ec);
+		return false;
+	}
+	return true;
+}
+
+bool BuildCache::RestoreFile(const std::string& category, const ContentHash& key, const std::string& dstFilePath) const
+{
+	return Load(category, key, [&](std::istream& is)
+	{
+		std::ofstream ofs(dstFilePath, std::ios::out | std::ios::binary);
+		ofs << is.rdbuf();
+		return ofs.good();
+	});
+}
+
+bool BuildCache::StoreFile(const std::string& category, const ContentHash& key, const std::string& srcFilePath) const
+{
+	std::ifstream ifs(srcFilePath, std::ios::in | std::ios::binary);
+	if (!ifs)
+	{
+		return false;
+	}
+	return Store(category, key, [&](std::ostream& os)
+	{
+		os << ifs.rdbuf();
+		return os.good();
+	});
+}
+
+
+//	EOF
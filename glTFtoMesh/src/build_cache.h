@@ -0,0 +1,65 @@
+﻿#pragma once
+
+#include <string>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <memory>
+#include <mutex>
+#include <list>
+#include <unordered_map>
+
+#include "content_hash.h"
+
+
+// content addressed object store on the local file system.
+// objects are stored as <root>/<category>/<key[0:2]>/<key>.
+// if memoryBudget is not 0, recently used objects up to the size are also kept in memory,
+// so a long running process does not read them from the disk again. if rootPath is empty, objects are kept only in memory.
+class BuildCache
+{
+public:
+	BuildCache(const std::string& rootPath, size_t memoryBudget = 0);
+	~BuildCache()
+	{}
+
+	bool Exists(const std::string& category, const ContentHash& key) const;
+
+	// return false if the object does not exist or the reader fails.
+	bool Load(const std::string& category, const ContentHash& key, const std::function<bool(std::istream&)>& reader) const;
+	// the object is written to a temporary file and renamed, so concurrent jobs never see a partial object.
+	bool Store(const std::string& category, const ContentHash& key, const std::function<bool(std::ostream&)>& writer) const;
+
+	// copy between the cache and output files.
+	bool RestoreFile(const std::string& category, const ContentHash& key, const std::string& dstFilePath) const;
+	bool StoreFile(const std::string& category, const ContentHash& key, const std::string& srcFilePath) const;
+
+private:
+	typedef std::shared_ptr<const std::string>	MemoryObject;
+
+	std::string GetObjectPath(const std::string& category, const ContentHash& key) const;
+
+	// null if the object is not in memory.
+	MemoryObject FindMemoryObject(const std::string& objectPath) const;
+	// least recently used objects are evicted to keep the budget.
+	void AddMemoryObject(const std::string& objectPath, MemoryObject object) const;
+	bool StoreToDisk(const std::string& objectPath, const std::function<bool(std::ostream&)>& writer) const;
+
+private:
+	struct MemoryEntry
+	{
+		MemoryObject						object;
+		std::list<std::string>::iterator	lruIt;
+	};	// struct MemoryEntry
+
+	std::string		rootPath_;
+	bool			isDiskEnabled_;
+	size_t			memoryBudget_;
+
+	mutable std::mutex										memoryMutex_;
+	mutable std::unordered_map<std::string, MemoryEntry>	memoryObjects_;
+	mutable std::list<std::string>							memoryLru_;			// front is the most recently used.
+	mutable size_t											memoryUsedSize_ = 0;
+};	// class BuildCache
+
+//	EOF
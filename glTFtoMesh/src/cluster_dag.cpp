@@ -0,0 +1,434 @@
+﻿#include "cluster_dag.h"
+
+#include <cfloat>
+#include <unordered_map>
+
+
+namespace
+{
+	// clusters in a group. the group is simplified to half, so it generates about half of the clusters.
+	static const size_t kGroupSize = 8;
+	// a group is not simplified if the triangles are not reduced below this ratio.
+	static const float kMinReduction = 0.85f;
+	static const uint32_t kMaxLevel = 32;
+
+	struct ClusterWork
+	{
+		std::vector<uint32_t>	indices;		// vertex indices of the submesh.
+		uint32_t				level = 0;
+		BoundSphere				lodBounds = {};
+		float					error = 0.0f;
+		BoundSphere				parentLodBounds = {};
+		float					parentError = FLT_MAX;
+	};	// struct ClusterWork
+
+	struct GroupResult
+	{
+		bool								simplified = false;
+		BoundSphere							lodBounds = {};
+		float								error = 0.0f;
+		std::vector<std::vector<uint32_t>>	clusters;		// vertex indices of the submesh.
+	};	// struct GroupResult
+
+	// split triangles into clusters. returned indices are the same space as indices.
+	std::vector<std::vector<uint32_t>> SplitClusters(const Vertex* pVertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, size_t maxVertices, size_t maxTriangles)
+	{
+		size_t max_meshlets = meshopt_buildMeshletsBound(indexCount, maxVertices, maxTriangles);
+		std::vector<meshopt_Meshlet> meshlets(max_meshlets);
+		std::vector<unsigned int> meshlet_vertices(max_meshlets * maxVertices);
+		std::vector<unsigned char> meshlet_triangles(max_meshlets * maxTriangles * 3);
+		meshlets.resize(meshopt_buildMeshlets(
+			meshlets.data(), meshlet_vertices.data(), meshlet_triangles.data(),
+			indices, indexCount,
+			&pVertices[0].pos.x, vertexCount, sizeof(Vertex),
+			maxVertices, maxTriangles, 0.0f));
+
+		std::vector<std::vector<uint32_t>> ret;
+		ret.reserve(meshlets.size());
+		for (auto&& meshlet : meshlets)
+		{
+			std::vector<uint32_t> cluster(meshlet.triangle_count * 3);
+			for (uint32_t i = 0; i < meshlet.triangle_count * 3; i++)
+			{
+				cluster[i] = meshlet_vertices[meshlet.vertex_offset + meshlet_triangles[meshlet.triangle_offset + i]];
+			}
+			ret.push_back(std::move(cluster));
+		}
+		return ret;
+	}
+
+	BoundSphere ComputeClusterSphere(const std::vector<Vertex>& vertexBuffer, const std::vector<uint32_t>& indices)
+	{
+		auto bounds = meshopt_computeClusterBounds(indices.data(), indices.size(), &vertexBuffer[0].pos.x, vertexBuffer.size(), sizeof(Vertex));
+		BoundSphere ret;
+		ret.center = DirectX::XMFLOAT3(bounds.center[0], bounds.center[1], bounds.center[2]);
+		ret.radius = bounds.radius;
+		return ret;
+	}
+
+	// group neighboring clusters greedily. the neighbor which shares the most vertices is added first.
+	// positionIds are the vertex indices welded by position, so that uv seams do not split groups.
+	std::vector<std::vector<uint32_t>> PartitionClusters(
+		const std::vector<ClusterWork>& clusters,
+		const std::vector<uint32_t>& pending,
+		const std::vector<uint32_t>& positionIds)
+	{
+		// (position id, pending index) pairs sorted by position id.
+		std::vector<std::pair<uint32_t, uint32_t>> refs;
+		for (uint32_t i = 0; i < (uint32_t)pending.size(); i++)
+		{
+			for (auto index : clusters[pending[i]].indices)
+			{
+				refs.push_back(std::make_pair(positionIds[index], i));
+			}
+		}
+		std::sort(refs.begin(), refs.end());
+		refs.erase(std::unique(refs.begin(), refs.end()), refs.end());
+
+		// adjacency weight is the number of shared vertices.
+		std::vector<std::vector<std::pair<uint32_t, uint32_t>>> adjacency(pending.size());
+		for (size_t begin = 0; begin < refs.size();)
+		{
+			size_t end = begin + 1;
+			while (end < refs.size() && refs[end].first == refs[begin].first)
+			{
+				end++;
+			}
+			for (size_t a = begin; a < end; a++)
+			{
+				for (size_t b = begin; b < end; b++)
+				{
+					if (a != b)
+					{
+						adjacency[refs[a].second].push_back(std::make_pair(refs[b].second, 1u));
+					}
+				}
+			}
+			begin = end;
+		}
+		for (auto&& adj : adjacency)
+		{
+			std::sort(adj.begin(), adj.end());
+			size_t count = 0;
+			for (size_t i = 0; i < adj.size(); i++)
+			{
+				if (count > 0 && adj[count - 1].first == adj[i].first)
+				{
+					adj[count - 1].second++;
+				}
+				else
+				{
+					adj[count++] = adj[i];
+				}
+			}
+			adj.resize(count);
+		}
+
+		std::vector<std::vector<uint32_t>> groups;
+		std::vector<bool> grouped(pending.size(), false);
+		std::unordered_map<uint32_t, uint32_t> candidates;
+		for (uint32_t seed = 0; seed < (uint32_t)pending.size(); seed++)
+		{
+			if (grouped[seed])
+			{
+				continue;
+			}
+
+			std::vector<uint32_t> group;
+			group.push_back(seed);
+			grouped[seed] = true;
+			candidates.clear();
+			uint32_t last = seed;
+			while (group.size() < kGroupSize)
+			{
+				for (auto&& adj : adjacency[last])
+				{
+					if (!grouped[adj.first])
+					{
+						candidates[adj.first] += adj.second;
+					}
+				}
+
+				uint32_t best = UINT32_MAX, best_weight = 0;
+				for (auto&& c : candidates)
+				{
+					if (!grouped[c.first] && (c.second > best_weight || (c.second == best_weight && c.first < best)))
+					{
+						best = c.first;
+						best_weight = c.second;
+					}
+				}
+				if (best == UINT32_MAX)
+				{
+					break;
+				}
+				candidates.erase(best);
+				group.push_back(best);
+				grouped[best] = true;
+				last = best;
+			}
+
+			for (auto&& g : group)
+			{
+				g = pending[g];
+			}
+			groups.push_back(std::move(group));
+		}
+		return groups;
+	}
+
+	// simplify the group to half and split it into clusters again.
+	// locks are indexed by position id, and locked vertices are on the borders with the other groups.
+	void SimplifyGroup(
+		const std::vector<Vertex>& vertexBuffer,
+		const std::vector<ClusterWork>& clusters,
+		const std::vector<uint32_t>& group,
+		const std::vector<uint32_t>& positionIds,
+		const std::vector<uint8_t>& locks,
+		size_t maxVertices,
+		size_t maxTriangles,
+		GroupResult& outResult)
+	{
+		// copy the vertices of the group, so that the cost does not depend on the submesh size.
+		std::unordered_map<uint32_t, uint32_t> local_map;
+		std::vector<Vertex> local_vertices;
+		std::vector<uint8_t> local_locks;
+		std::vector<uint32_t> local_to_global;
+		std::vector<uint32_t> local_indices;
+		for (auto cluster_index : group)
+		{
+			for (auto index : clusters[cluster_index].indices)
+			{
+				auto it = local_map.find(index);
+				if (it == local_map.end())
+				{
+					it = local_map.insert(std::make_pair(index, (uint32_t)local_vertices.size())).first;
+					local_vertices.push_back(vertexBuffer[index]);
+					local_locks.push_back(locks[positionIds[index]]);
+					local_to_global.push_back(index);
+				}
+				local_indices.push_back(it->second);
+			}
+		}
+
+		size_t target_count = local_indices.size() / 6 * 3;
+		std::vector<uint32_t> simplified(local_indices.size());
+		float result_error = 0.0f;
+		simplified.resize(meshopt_simplifyWithAttributes(
+			simplified.data(),
+			local_indices.data(), local_indices.size(),
+			&local_vertices[0].pos.x, local_vertices.size(), sizeof(Vertex),
+			&local_vertices[0].normal.x, sizeof(Vertex), kSimplifyAttributeWeights, kSimplifyAttributeCount,
+			local_locks.data(),
+			target_count, FLT_MAX, meshopt_SimplifyErrorAbsolute, &result_error));
+		if (simplified.empty() || (float)simplified.size() > (float)local_indices.size() * kMinReduction)
+		{
+			return;
+		}
+
+		// errors and bounds must not be smaller than the children.
+		std::vector<float> spheres;
+		float error = result_error;
+		for (auto cluster_index : group)
+		{
+			auto&& c = clusters[cluster_index];
+			spheres.push_back(c.lodBounds.center.x);
+			spheres.push_back(c.lodBounds.center.y);
+			spheres.push_back(c.lodBounds.center.z);
+			spheres.push_back(c.lodBounds.radius);
+			error = std::max(error, c.error);
+		}
+		auto bounds = meshopt_computeSphereBounds(spheres.data(), group.size(), sizeof(float) * 4, spheres.data() + 3, sizeof(float) * 4);
+
+		outResult.simplified = true;
+		outResult.lodBounds.center = DirectX::XMFLOAT3(bounds.center[0], bounds.center[1], bounds.center[2]);
+		outResult.lodBounds.radius = bounds.radius;
+		outResult.error = error;
+		outResult.clusters = SplitClusters(local_vertices.data(), local_vertices.size(), simplified.data(), simplified.size(), maxVertices, maxTriangles);
+		for (auto&& cluster : outResult.clusters)
+		{
+			for (auto&& index : cluster)
+			{
+				index = local_to_global[index];
+			}
+		}
+	}
+
+	// convert a cluster to meshlet buffers.
+	void StoreCluster(const std::vector<Vertex>& vertexBuffer, const ClusterWork& cluster, SubmeshDag& outDag)
+	{
+		std::vector<uint32_t> vertices;
+		std::vector<uint8_t> triangles;
+		for (auto index : cluster.indices)
+		{
+			auto it = std::find(vertices.begin(), vertices.end(), index);
+			triangles.push_back((uint8_t)(it - vertices.begin()));
+			if (it == vertices.end())
+			{
+				vertices.push_back(index);
+			}
+		}
+
+		DagCluster out = {};
+		out.meshlet.indexOffset = (uint32_t)outDag.indexBuffer.size();
+		out.meshlet.indexCount = (uint32_t)cluster.indices.size();
+		out.meshlet.primitiveOffset = (uint32_t)outDag.primitives.size() / 3;
+		out.meshlet.primitiveCount = (uint32_t)cluster.indices.size() / 3;
+		out.meshlet.vertexIndexOffset = (uint32_t)outDag.vertexIndexBuffer.size();
+		out.meshlet.vertexIndexCount = (uint32_t)vertices.size();
+		outDag.indexBuffer.insert(outDag.indexBuffer.end(), cluster.indices.begin(), cluster.indices.end());
+		outDag.primitives.insert(outDag.primitives.end(), triangles.begin(), triangles.end());
+		outDag.vertexIndexBuffer.insert(outDag.vertexIndexBuffer.end(), vertices.begin(), vertices.end());
+
+		auto bounds = meshopt_computeMeshletBounds(vertices.data(), triangles.data(), triangles.size() / 3, &vertexBuffer[0].pos.x, vertexBuffer.size(), sizeof(Vertex));
+		out.meshlet.boundingSphere.center = DirectX::XMFLOAT3(bounds.center[0], bounds.center[1], bounds.center[2]);
+		out.meshlet.boundingSphere.radius = bounds.radius;
+		out.meshlet.cone.apex = DirectX::XMFLOAT3(bounds.cone_apex[0], bounds.cone_apex[1], bounds.cone_apex[2]);
+		out.meshlet.cone.axis = DirectX::XMFLOAT3(bounds.cone_axis[0], bounds.cone_axis[1], bounds.cone_axis[2]);
+		out.meshlet.cone.cutoff = bounds.cone_cutoff;
+
+		DirectX::XMVECTOR aabbMin = DirectX::XMLoadFloat3(&vertexBuffer[vertices[0]].pos);
+		DirectX::XMVECTOR aabbMax = aabbMin;
+		for (size_t i = 1; i < vertices.size(); i++)
+		{
+			DirectX::XMVECTOR p = DirectX::XMLoadFloat3(&vertexBuffer[vertices[i]].pos);
+			aabbMin = DirectX::XMVectorMin(aabbMin, p);
+			aabbMax = DirectX::XMVectorMax(aabbMax, p);
+		}
+		DirectX::XMStoreFloat3(&out.meshlet.boundingBox.aabbMin, aabbMin);
+		DirectX::XMStoreFloat3(&out.meshlet.boundingBox.aabbMax, aabbMax);
+
+		out.level = cluster.level;
+		out.lodBounds = cluster.lodBounds;
+		out.error = cluster.error;
+		out.parentLodBounds = cluster.parentLodBounds;
+		out.parentError = cluster.parentError;
+		outDag.clusters.push_back(out);
+	}
+}
+
+void BuildSubmeshClusterDag(
+	const std::vector<Vertex>& vertexBuffer,
+	const std::vector<uint32_t>& indexBuffer,
+	size_t maxVertices,
+	size_t maxTriangles,
+	JobSystem* pJobSystem,
+	SubmeshDag& outDag)
+{
+	outDag = SubmeshDag();
+	if (vertexBuffer.empty() || indexBuffer.empty())
+	{
+		return;
+	}
+
+	// weld vertices by position. uv and normal seams must be locked on the both sides.
+	std::vector<uint32_t> position_ids(vertexBuffer.size());
+	size_t position_count;
+	{
+		std::vector<DirectX::XMFLOAT3> positions(vertexBuffer.size());
+		for (size_t i = 0; i < vertexBuffer.size(); i++)
+		{
+			positions[i] = vertexBuffer[i].pos;
+		}
+		position_count = meshopt_generateVertexRemap(position_ids.data(), nullptr, positions.size(), positions.data(), positions.size(), sizeof(DirectX::XMFLOAT3));
+	}
+
+	// level 0.
+	std::vector<ClusterWork> clusters;
+	std::vector<uint32_t> pending;
+	for (auto&& indices : SplitClusters(vertexBuffer.data(), vertexBuffer.size(), indexBuffer.data(), indexBuffer.size(), maxVertices, maxTriangles))
+	{
+		ClusterWork cluster;
+		cluster.lodBounds = ComputeClusterSphere(vertexBuffer, indices);
+		cluster.indices = std::move(indices);
+		pending.push_back((uint32_t)clusters.size());
+		clusters.push_back(std::move(cluster));
+	}
+
+	uint32_t level = 0;
+	std::vector<uint8_t> locks(position_count);
+	std::vector<uint8_t> root_locks(position_count, 0);	// vertices of roots in the lower levels.
+	std::vector<uint32_t> owners(position_count);
+	while (pending.size() > 1 && level + 1 < kMaxLevel)
+	{
+		auto groups = PartitionClusters(clusters, pending, position_ids);
+
+		// lock vertices shared by two or more groups, or shared with roots.
+		locks = root_locks;
+		std::fill(owners.begin(), owners.end(), UINT32_MAX);
+		for (uint32_t group_index = 0; group_index < (uint32_t)groups.size(); group_index++)
+		{
+			for (auto cluster_index : groups[group_index])
+			{
+				for (auto index : clusters[cluster_index].indices)
+				{
+					auto&& owner = owners[position_ids[index]];
+					if (owner == UINT32_MAX)
+					{
+						owner = group_index;
+					}
+					else if (owner != group_index)
+					{
+						locks[position_ids[index]] = 1;
+					}
+				}
+			}
+		}
+
+		std::vector<GroupResult> results(groups.size());
+		ParallelFor(pJobSystem, groups.size(), [&](size_t group_index)
+		{
+			SimplifyGroup(vertexBuffer, clusters, groups[group_index], position_ids, locks, maxVertices, maxTriangles, results[group_index]);
+		});
+
+		// groups which are not simplified stay as roots.
+		level++;
+		std::vector<uint32_t> next_pending;
+		for (size_t group_index = 0; group_index < groups.size(); group_index++)
+		{
+			auto&& result = results[group_index];
+			if (!result.simplified)
+			{
+				for (auto cluster_index : groups[group_index])
+				{
+					for (auto index : clusters[cluster_index].indices)
+					{
+						root_locks[position_ids[index]] = 1;
+					}
+				}
+				continue;
+			}
+			for (auto cluster_index : groups[group_index])
+			{
+				clusters[cluster_index].parentLodBounds = result.lodBounds;
+				clusters[cluster_index].parentError = result.error;
+			}
+			for (auto&& indices : result.clusters)
+			{
+				ClusterWork cluster;
+				cluster.indices = std::move(indices);
+				cluster.level = level;
+				cluster.lodBounds = result.lodBounds;
+				cluster.error = result.error;
+				next_pending.push_back((uint32_t)clusters.size());
+				clusters.push_back(std::move(cluster));
+			}
+		}
+		if (next_pending.empty())
+		{
+			level--;
+			break;
+		}
+		pending.swap(next_pending);
+	}
+
+	// clusters are created in level order.
+	for (auto&& cluster : clusters)
+	{
+		StoreCluster(vertexBuffer, cluster, outDag);
+	}
+	outDag.levelCount = level + 1;
+}
+
+
+//	EOF
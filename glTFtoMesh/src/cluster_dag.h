@@ -0,0 +1,25 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mesh_work.h"
+
+
+// build the hierarchical cluster DAG of the geometry.
+//   1. split the triangles into clusters.
+//   2. group neighboring clusters.
+//   3. simplify each group to half with the borders shared with other groups locked.
+//   4. split the simplified group into clusters again, and repeat 2-4 with the new clusters.
+// groups which can not be simplified any more are roots.
+// groups are simplified in parallel if pJobSystem is not null.
+// clusters have up to maxVertices vertices and maxTriangles triangles, the same as meshlets.
+void BuildSubmeshClusterDag(
+	const std::vector<Vertex>& vertexBuffer,
+	const std::vector<uint32_t>& indexBuffer,
+	size_t maxVertices,
+	size_t maxTriangles,
+	JobSystem* pJobSystem,
+	SubmeshDag& outDag);
+
+//	EOF
@@ -0,0 +1,188 @@
+﻿#include "content_hash.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+
+namespace
+{
+	static const uint64_t kPrime1 = 11400714785074694791ULL;
+	static const uint64_t kPrime2 = 14029467366897019727ULL;
+	static const uint64_t kPrime3 = 1609587929392839161ULL;
+	static const uint64_t kPrime4 = 9650029242287828579ULL;
+	static const uint64_t kPrime5 = 2870177450012600261ULL;
+
+	static const uint64_t kSeeds[2] = { 0, 0x9E3779B97F4A7C15ULL };
+
+	inline uint64_t Rotl(uint64_t x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	inline uint64_t Read64(const uint8_t* p)
+	{
+		uint64_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	inline uint32_t Read32(const uint8_t* p)
+	{
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	inline uint64_t Round(uint64_t acc, uint64_t input)
+	{
+		acc += input * kPrime2;
+		acc = Rotl(acc, 31);
+		return acc * kPrime1;
+	}
+
+	inline uint64_t MergeRound(uint64_t acc, uint64_t val)
+	{
+		acc ^= Round(0, val);
+		return acc * kPrime1 + kPrime4;
+	}
+}
+
+std::string ContentHash::ToString() const
+{
+	char str[33];
+	snprintf(str, sizeof(str), "%016llx%016llx", (unsigned long long)value[0], (unsigned long long)value[1]);
+	return str;
+}
+
+ContentHasher::ContentHasher()
+{
+	for (int i = 0; i < 2; i++)
+	{
+		auto&& s = states_[i];
+		s.seed = kSeeds[i];
+		s.v[0] = s.seed + kPrime1 + kPrime2;
+		s.v[1] = s.seed + kPrime2;
+		s.v[2] = s.seed;
+		s.v[3] = s.seed - kPrime1;
+	}
+}
+
+void ContentHasher::Update(const void* pData, size_t size)
+{
+	auto p = reinterpret_cast<const uint8_t*>(pData);
+	auto end = p + size;
+	totalSize_ += size;
+
+	auto ConsumeStripe = [this](const uint8_t* stripe)
+	{
+		for (auto&& s : states_)
+		{
+			s.v[0] = Round(s.v[0], Read64(stripe + 0));
+			s.v[1] = Round(s.v[1], Read64(stripe + 8));
+			s.v[2] = Round(s.v[2], Read64(stripe + 16));
+			s.v[3] = Round(s.v[3], Read64(stripe + 24));
+		}
+	};
+
+	// fill the pending buffer.
+	if (bufferSize_ > 0)
+	{
+		size_t copy_size = std::min(sizeof(buffer_) - bufferSize_, size);
+		memcpy(buffer_ + bufferSize_, p, copy_size);
+		bufferSize_ += copy_size;
+		p += copy_size;
+		if (bufferSize_ < sizeof(buffer_))
+		{
+			return;
+		}
+		ConsumeStripe(buffer_);
+		bufferSize_ = 0;
+	}
+
+	for (; p + 32 <= end; p += 32)
+	{
+		ConsumeStripe(p);
+	}
+
+	if (p < end)
+	{
+		memcpy(buffer_, p, end - p);
+		bufferSize_ = end - p;
+	}
+}
+
+ContentHash ContentHasher::Finalize() const
+{
+	ContentHash ret;
+	for (int i = 0; i < 2; i++)
+	{
+		auto&& s = states_[i];
+		uint64_t h;
+		if (totalSize_ >= 32)
+		{
+			h = Rotl(s.v[0], 1) + Rotl(s.v[1], 7) + Rotl(s.v[2], 12) + Rotl(s.v[3], 18);
+			h = MergeRound(h, s.v[0]);
+			h = MergeRound(h, s.v[1]);
+			h = MergeRound(h, s.v[2]);
+			h = MergeRound(h, s.v[3]);
+		}
+		else
+		{
+			h = s.seed + kPrime5;
+		}
+		h += totalSize_;
+
+		const uint8_t* p = buffer_;
+		const uint8_t* end = buffer_ + bufferSize_;
+		for (; p + 8 <= end; p += 8)
+		{
+			h ^= Round(0, Read64(p));
+			h = Rotl(h, 27) * kPrime1 + kPrime4;
+		}
+		if (p + 4 <= end)
+		{
+			h ^= (uint64_t)Read32(p) * kPrime1;
+			h = Rotl(h, 23) * kPrime2 + kPrime3;
+			p += 4;
+		}
+		for (; p < end; p++)
+		{
+			h ^= (*p) * kPrime5;
+			h = Rotl(h, 11) * kPrime1;
+		}
+
+		h ^= h >> 33;
+		h *= kPrime2;
+		h ^= h >> 29;
+		h *= kPrime3;
+		h ^= h >> 32;
+		ret.value[i] = h;
+	}
+	return ret;
+}
+
+bool HashFile(const std::string& filePath, ContentHasher& hasher)
+{
+	std::ifstream ifs(filePath, std::ios::in | std::ios::binary);
+	if (!ifs)
+	{
+		return false;
+	}
+
+	std::vector<char> chunk(1024 * 1024);
+	while (ifs)
+	{
+		ifs.read(chunk.data(), chunk.size());
+		auto read_size = ifs.gcount();
+		if (read_size > 0)
+		{
+			hasher.Update(chunk.data(), (size_t)read_size);
+		}
+	}
+	return true;
+}
+
+
+//	EOF
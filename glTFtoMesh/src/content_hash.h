@@ -0,0 +1,73 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// 128bit content hash. (two XXH64 streams with different seeds)
+struct ContentHash
+{
+	uint64_t	value[2] = { 0, 0 };
+
+	bool operator==(const ContentHash& rhs) const
+	{
+		return value[0] == rhs.value[0] && value[1] == rhs.value[1];
+	}
+	bool operator!=(const ContentHash& rhs) const
+	{
+		return !(*this == rhs);
+	}
+
+	std::string ToString() const;
+};	// struct ContentHash
+
+class ContentHasher
+{
+	struct State
+	{
+		uint64_t	v[4];
+		uint64_t	seed;
+	};	// struct State
+
+public:
+	ContentHasher();
+	~ContentHasher()
+	{}
+
+	void Update(const void* pData, size_t size);
+	void Update(const std::string& str)
+	{
+		UpdateValue((uint64_t)str.size());
+		Update(str.data(), str.size());
+	}
+	template <typename T>
+	void Update(const std::vector<T>& vec)
+	{
+		UpdateValue((uint64_t)vec.size());
+		Update(vec.data(), sizeof(T) * vec.size());
+	}
+	template <typename T>
+	void UpdateValue(const T& value)
+	{
+		Update(&value, sizeof(T));
+	}
+	void Update(const ContentHash& hash)
+	{
+		UpdateValue(hash.value[0]);
+		UpdateValue(hash.value[1]);
+	}
+
+	ContentHash Finalize() const;
+
+private:
+	State		states_[2];
+	uint8_t		buffer_[32];
+	size_t		bufferSize_ = 0;
+	uint64_t	totalSize_ = 0;
+};	// class ContentHasher
+
+// hash of the whole file. return false if the file cannot be read.
+bool HashFile(const std::string& filePath, ContentHasher& hasher);
+
+//	EOF
@@ -0,0 +1,1590 @@
+﻿#include <algorithm>
+#include "GLTFSDK/GLTF.h"
+#include "GLTFSDK/GLBResourceReader.h"
+#include "GLTFSDK/Deserialize.h"
+#include "meshoptimizer.h"
+#include "mikktspace.h"
+
+#include <cereal/cereal.hpp>
+#include <cereal/archives/json.hpp>
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/vector.hpp>
+
+#if defined(_WIN32)
+#include <DirectXTex.h>
+#endif
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+
+#include "converter.h"
+#include "mesh_work.h"
+#include "build_cache.h"
+#include "content_hash.h"
+#include "rmesh_writer.h"
+#include "bc_encoder.h"
+#include "dds_file.h"
+#include "mip_generator.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../../External/stb/stb_image.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+
+using namespace Microsoft::glTF;
+
+namespace
+{
+	std::string ConvYenToSlash(const std::string& path)
+	{
+		std::string ret;
+		ret.reserve(path.length() + 1);
+		for (auto&& it : path)
+		{
+			ret += (it == '\\') ? '/' : it;
+		}
+		return ret;
+	}
+
+	std::string GetExtent(const std::string& filename)
+	{
+		std::string ret;
+		auto pos = filename.rfind('.');
+		if (pos != std::string::npos)
+		{
+			ret = filename.data() + pos;
+		}
+		return ret;
+	}
+
+	std::string GetFileName(const std::string& filename)
+	{
+		std::string ret = filename;
+		auto pos = filename.rfind('.');
+		if (pos != std::string::npos)
+		{
+			ret.erase(pos);
+		}
+		return ret;
+	}
+
+	std::string GetPath(const std::string& filename)
+	{
+		std::string ret = "./";
+		auto pos = filename.rfind('/');
+		if (pos != std::string::npos)
+		{
+			ret = filename.substr(0, pos + 1);
+		}
+		return ret;
+	}
+
+	std::string GetTextureKind(const std::string& filename)
+	{
+		std::string name = GetFileName(filename);
+		size_t pos = name.rfind(".");
+		std::string ret;
+		if (pos != std::string::npos)
+		{
+			ret = name.data() + pos + 1;
+		}
+		return ret;
+	}
+}
+
+// rough peak memory size of ConvertToDDSWithDirectXTex and ConvertToDDSWithBCEncoder. (RGBA image, mip chain, DirectX image, compressed mip chain)
+size_t EstimateDDSMemorySize(TextureWork* pTex)
+{
+	int width, height, bpp;
+	if (!stbi_info_from_memory(reinterpret_cast<const stbi_uc*>(pTex->GetBinary().data()), static_cast<int>(pTex->GetBinary().size()), &width, &height, &bpp))
+	{
+		return pTex->GetBinary().size();
+	}
+	size_t pixel_size = (size_t)width * (size_t)height * 4;
+	size_t occlusion_size = 0;
+	if (pTex->GetOcclusionSource())
+	{
+		auto&& binary = pTex->GetOcclusionSource()->GetBinary();
+		if (stbi_info_from_memory(reinterpret_cast<const stbi_uc*>(binary.data()), static_cast<int>(binary.size()), &width, &height, &bpp))
+		{
+			occlusion_size = (size_t)width * (size_t)height * 4;
+		}
+	}
+	return pixel_size + pixel_size + pixel_size * 4 / 3 + pixel_size * 4 / 3 + occlusion_size;
+}
+
+namespace
+{
+	// replace the red channel of the RGBA pixels by the red channel of the occlusion texture.
+	// the occlusion texture is resampled to the size with the nearest filter.
+	bool MergeOcclusion(const TextureWork* pOcclusion, uint8_t* pPixels, uint32_t width, uint32_t height)
+	{
+		int src_width, src_height, src_bpp;
+		stbi_uc* src = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(pOcclusion->GetBinary().data()), static_cast<int>(pOcclusion->GetBinary().size()), &src_width, &src_height, &src_bpp, 4);
+		if (!src)
+		{
+			return false;
+		}
+		for (uint32_t y = 0; y < height; y++)
+		{
+			size_t sy = (size_t)y * (size_t)src_height / height;
+			for (uint32_t x = 0; x < width; x++)
+			{
+				size_t sx = (size_t)x * (size_t)src_width / width;
+				pPixels[((size_t)y * width + x) * 4] = src[(sy * src_width + sx) * 4];
+			}
+		}
+		stbi_image_free(src);
+		return true;
+	}
+
+	// true if red, green and blue are the same in all pixels.
+	bool IsGrayscale(const uint8_t* pPixels, size_t pixelCount)
+	{
+		for (size_t i = 0; i < pixelCount; i++, pPixels += 4)
+		{
+			if (pPixels[0] != pPixels[1] || pPixels[0] != pPixels[2])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// BCFormat of a texture.
+	// if channelAware is true, normal maps use BC5 (x and y), and grayscale linear textures use BC4 (red).
+	uint32_t SelectBCFormat(bool isSrgb, bool isNormal, bool isBC7, bool channelAware, bool hasAlpha, bool isGrayscale)
+	{
+		if (channelAware)
+		{
+			if (isNormal)
+			{
+				return BCFormat::BC5;
+			}
+			if (!isSrgb && !hasAlpha && isGrayscale)
+			{
+				return BCFormat::BC4;
+			}
+		}
+		if (hasAlpha || isNormal)
+		{
+			return (isBC7) ? BCFormat::BC7 : BCFormat::BC3;
+		}
+		return BCFormat::BC1;
+	}
+}
+
+namespace
+{
+	MipOptions GetMipOptions(const ToolOptions& options, const TextureWork* pTex)
+	{
+		MipOptions ret;
+		ret.filter = options.mipFilter;
+		ret.gammaCorrect = options.mipGammaCorrect;
+		ret.alphaCutoff = (options.mipAlphaCoverage) ? pTex->GetAlphaCutoff() : -1.0f;
+		return ret;
+	}
+
+	// decoded RGBA image of a texture and its mips.
+	// the top mip is the stb_image output itself. RGB images are expanded to RGBA by stb_image, and not copied.
+	struct TextureSource
+	{
+		stbi_uc*				pPixels = nullptr;
+		uint32_t				width = 0;
+		uint32_t				height = 0;
+		bool					hasAlpha = false;
+		bool					isGrayscale = false;
+		std::vector<RGBAImage>	mips;				// mip 1 or later.
+
+		TextureSource()
+		{}
+		~TextureSource()
+		{
+			if (pPixels)
+			{
+				stbi_image_free(pPixels);
+			}
+		}
+
+		RGBAImageView GetTopView() const
+		{
+			RGBAImageView ret;
+			ret.pPixels = pPixels;
+			ret.width = width;
+			ret.height = height;
+			return ret;
+		}
+		std::vector<RGBAImageView> GetMipViews() const
+		{
+			std::vector<RGBAImageView> ret;
+			ret.reserve(mips.size() + 1);
+			ret.push_back(GetTopView());
+			for (auto&& mip : mips)
+			{
+				ret.push_back(mip.GetView());
+			}
+			return ret;
+		}
+	};	// struct TextureSource
+
+	// decode the image, merge the occlusion source, and generate full mips.
+	bool LoadTextureSource(TextureWork* pTex, bool isSrgb, const ToolOptions& options, JobSystem* pJobSystem, ConvertStats* pStats, TextureSource& outSource)
+	{
+		int width, height, bpp;
+		{
+			ScopedStats stats(pStats, "texture", pTex->GetName(), "stbi_load");
+			outSource.pPixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(pTex->GetBinary().data()), static_cast<int>(pTex->GetBinary().size()), &width, &height, &bpp, 4);
+		}
+		// the pixels are always expanded to RGBA. bpp is the channel count of the source image.
+		if (!outSource.pPixels)
+		{
+			return false;
+		}
+		outSource.width = (uint32_t)width;
+		outSource.height = (uint32_t)height;
+
+		size_t pixel_count = (size_t)width * (size_t)height;
+		// gray + alpha (2) and RGBA (4) images have alpha channels.
+		outSource.hasAlpha = false;
+		if (bpp == 2 || bpp == 4)
+		{
+			for (size_t i = 0; i < pixel_count && !outSource.hasAlpha; i++)
+			{
+				outSource.hasAlpha = outSource.pPixels[i * 4 + 3] < 0xff;
+			}
+		}
+		if (pTex->GetOcclusionSource() && !MergeOcclusion(pTex->GetOcclusionSource(), outSource.pPixels, outSource.width, outSource.height))
+		{
+			return false;
+		}
+		outSource.isGrayscale = options.textureChannels && IsGrayscale(outSource.pPixels, pixel_count);
+
+		ScopedStats stats(pStats, "texture", pTex->GetName(), "GenerateMipMaps");
+		GenerateMips(outSource.GetTopView(), isSrgb, GetMipOptions(options, pTex), pJobSystem, outSource.mips);
+		return true;
+	}
+}
+
+#if defined(_WIN32)
+namespace
+{
+	DXGI_FORMAT GetDXGIFormat(uint32_t format, bool isSrgb)
+	{
+		switch (format)
+		{
+		case BCFormat::BC1: return (isSrgb) ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+		case BCFormat::BC3: return (isSrgb) ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+		case BCFormat::BC4: return DXGI_FORMAT_BC4_UNORM;
+		case BCFormat::BC5: return DXGI_FORMAT_BC5_UNORM;
+		default:			return (isSrgb) ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+		}
+	}
+}
+
+bool ConvertToDDSWithDirectXTex(TextureWork* pTex, const std::string& outputFilePath, bool isSrgb, bool isNormal, const ToolOptions& options, JobSystem* pJobSystem, bool isParallel, ConvertStats* pStats)
+{
+	TextureSource source;
+	if (!LoadTextureSource(pTex, isSrgb, options, pJobSystem, pStats, source))
+	{
+		return false;
+	}
+
+	// mip chain to DirectX image.
+	std::vector<RGBAImageView> mips = source.GetMipViews();
+	std::unique_ptr<DirectX::ScratchImage> image(new DirectX::ScratchImage());
+	auto hr = image->Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, source.width, source.height, 1, mips.size());
+	if (FAILED(hr))
+	{
+		return false;
+	}
+	for (size_t level = 0; level < mips.size(); level++)
+	{
+		const DirectX::Image* pDst = image->GetImage(level, 0, 0);
+		size_t row_size = (size_t)mips[level].width * 4;
+		for (uint32_t y = 0; y < mips[level].height; y++)
+		{
+			memcpy(pDst->pixels + y * pDst->rowPitch, mips[level].pPixels + y * row_size, row_size);
+		}
+	}
+
+	// compress.
+	DXGI_FORMAT compress_format = GetDXGIFormat(SelectBCFormat(isSrgb, isNormal, options.compressBC7, options.textureChannels, source.hasAlpha, source.isGrayscale), isSrgb);
+	DirectX::TEX_COMPRESS_FLAGS comp_flag = (isParallel) ? DirectX::TEX_COMPRESS_PARALLEL : DirectX::TEX_COMPRESS_DEFAULT;
+	if (isSrgb)
+	{
+		comp_flag |= DirectX::TEX_COMPRESS_SRGB_OUT;
+	}
+	std::unique_ptr<DirectX::ScratchImage> comp_image(new DirectX::ScratchImage());
+	{
+		ScopedStats stats(pStats, "texture", pTex->GetName(), "Compress");
+		hr = DirectX::Compress(
+			image->GetImages(),
+			image->GetImageCount(),
+			image->GetMetadata(),
+			compress_format,
+			comp_flag,
+			DirectX::TEX_THRESHOLD_DEFAULT,
+			*comp_image);
+	}
+	if (FAILED(hr))
+	{
+		return false;
+	}
+	image.swap(comp_image);
+
+	size_t len;
+	mbstowcs_s(&len, nullptr, 0, outputFilePath.c_str(), 0);
+	std::wstring of;
+	of.resize(len + 1);
+	mbstowcs_s(&len, (wchar_t*)of.data(), of.length(), outputFilePath.c_str(), of.length());
+	{
+		ScopedStats stats(pStats, "texture", pTex->GetName(), "SaveToDDSFile");
+		hr = DirectX::SaveToDDSFile(
+			image->GetImages(),
+			image->GetImageCount(),
+			image->GetMetadata(),
+			DirectX::DDS_FLAGS_NONE,
+			of.c_str());
+	}
+	if (FAILED(hr))
+	{
+		return false;
+	}
+
+	return true;
+}
+#endif
+
+// portable path. no DirectXTex and COM.
+bool ConvertToDDSWithBCEncoder(TextureWork* pTex, const std::string& outputFilePath, bool isSrgb, bool isNormal, const ToolOptions& options, JobSystem* pJobSystem, ConvertStats* pStats)
+{
+	TextureSource source;
+	if (!LoadTextureSource(pTex, isSrgb, options, pJobSystem, pStats, source))
+	{
+		return false;
+	}
+
+	// compress.
+	uint32_t format = SelectBCFormat(isSrgb, isNormal, options.compressBC7, options.textureChannels, source.hasAlpha, source.isGrayscale);
+	std::vector<std::vector<uint8_t>> compressed;
+	{
+		ScopedStats stats(pStats, "texture", pTex->GetName(), "Compress");
+		CompressBCMips(source.GetMipViews(), format, options.textureQuality, pJobSystem, compressed);
+	}
+
+	ScopedStats stats(pStats, "texture", pTex->GetName(), "SaveToDDSFile");
+	return WriteDDSFile(outputFilePath, format, isSrgb, source.width, source.height, compressed);
+}
+
+namespace
+{
+	// bump this version if outputs are changed, so that old cache objects are not used.
+	static const char* kCacheToolVersion = "glTFtoMesh-14";
+
+	// options which affect outputs. output paths are not included.
+	void HashToolOptions(ContentHasher& hasher, const ToolOptions& options)
+	{
+		hasher.UpdateValue(options.textureDDS);
+		hasher.UpdateValue(options.compressBC7);
+		hasher.UpdateValue(options.textureEncoder);
+		hasher.UpdateValue(options.textureQuality);
+		hasher.UpdateValue(options.textureChannels);
+		hasher.UpdateValue(options.packOcclusion);
+		hasher.UpdateValue(options.textureDedup);
+		hasher.UpdateValue(options.mipFilter);
+		hasher.UpdateValue(options.mipGammaCorrect);
+		hasher.UpdateValue(options.mipAlphaCoverage);
+		hasher.UpdateValue(options.mergeFlag);
+		hasher.UpdateValue(options.optimizeFlag);
+		hasher.UpdateValue(options.optimizeVertexCache);
+		hasher.UpdateValue(options.optimizeOverdraw);
+		hasher.UpdateValue(options.optimizeVertexFetch);
+		hasher.UpdateValue(options.optimizeMeshletOrder);
+		hasher.UpdateValue(options.overdrawThreshold);
+		hasher.UpdateValue(options.meshletFlag);
+		hasher.UpdateValue(options.meshletMaxVertices);
+		hasher.UpdateValue(options.meshletMaxTriangles);
+		hasher.UpdateValue(options.meshletMode);
+		hasher.UpdateValue(options.meshletConeWeight);
+		hasher.UpdateValue(options.meshletAutoTune);
+		hasher.UpdateValue(options.meshletCompact);
+		hasher.UpdateValue(options.quantizeVertex);
+		hasher.UpdateValue(options.texcoordUnorm16);
+		hasher.UpdateValue(options.index16);
+		hasher.UpdateValue(options.splitIndex16);
+		hasher.UpdateValue(options.compressMesh);
+		hasher.UpdateValue(options.containerFormat);
+		hasher.UpdateValue(options.lodCount);
+		hasher.UpdateValue(options.lodRatio);
+		hasher.UpdateValue(options.lodError);
+		hasher.UpdateValue(options.clusterDag);
+		hasher.UpdateValue(options.instancing);
+	}
+
+	// input file and external buffers.
+	bool HashInputFiles(const ToolOptions& options, ContentHasher& hasher)
+	{
+		std::vector<std::string> files;
+		if (!CollectInputFiles(options, files))
+		{
+			return false;
+		}
+		for (auto&& file : files)
+		{
+			if (!HashFile(file, hasher))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// file entry is a text object.
+	//   submesh <count>
+	//   rmesh <key>
+	//   texture <key> <file name>
+	bool RestoreFileFromCache(const BuildCache& cache, const ContentHash& fileKey, const ToolOptions& options, ConvertResult* pResult)
+	{
+		auto ParseKey = [](const std::string& str, ContentHash& key)
+		{
+			unsigned long long v0, v1;
+			if (str.length() != 32 || sscanf(str.c_str(), "%16llx%16llx", &v0, &v1) != 2)
+			{
+				return false;
+			}
+			key.value[0] = v0;
+			key.value[1] = v1;
+			return true;
+		};
+
+		size_t submesh_count = 0;
+		ContentHash rmesh_key;
+		std::vector<std::pair<std::string, ContentHash>> textures;
+		bool has_rmesh = false;
+		bool result = cache.Load("file", fileKey, [&](std::istream& is)
+		{
+			std::string line;
+			while (std::getline(is, line))
+			{
+				std::stringstream ss(line);
+				std::string tag, key_str;
+				ss >> tag;
+				if (tag == "submesh")
+				{
+					ss >> submesh_count;
+				}
+				else if (tag == "rmesh")
+				{
+					ss >> key_str;
+					has_rmesh = ParseKey(key_str, rmesh_key);
+				}
+				else if (tag == "texture")
+				{
+					ContentHash key;
+					std::string name;
+					ss >> key_str;
+					std::getline(ss >> std::ws, name);
+					if (!ParseKey(key_str, key) || name.empty())
+					{
+						return false;
+					}
+					textures.push_back(std::make_pair(name, key));
+				}
+			}
+			return has_rmesh;
+		});
+		if (!result)
+		{
+			return false;
+		}
+
+		// all objects must exist before restoring.
+		if (!cache.Exists("rmesh", rmesh_key))
+		{
+			return false;
+		}
+		for (auto&& tex : textures)
+		{
+			if (!cache.Exists("texture", tex.second))
+			{
+				return false;
+			}
+		}
+
+		for (auto&& tex : textures)
+		{
+			if (!cache.RestoreFile("texture", tex.second, options.outputTexPath + tex.first))
+			{
+				return false;
+			}
+		}
+		if (!cache.RestoreFile("rmesh", rmesh_key, options.outputFilePath))
+		{
+			return false;
+		}
+
+		if (pResult)
+		{
+			std::error_code ec;
+			pResult->isSucceeded = true;
+			pResult->isCacheHit = true;
+			pResult->submeshCount = submesh_count;
+			pResult->textureCount = textures.size();
+			pResult->outputSize = (size_t)std::filesystem::file_size(options.outputFilePath, ec);
+		}
+		return true;
+	}
+
+	void StoreFileToCache(const BuildCache& cache, const ContentHash& fileKey, const ToolOptions& options, size_t submeshCount, const std::vector<std::pair<std::string, ContentHash>>& textures)
+	{
+		// rmesh is stored with the file key, because it depends on all inputs.
+		if (!cache.StoreFile("rmesh", fileKey, options.outputFilePath))
+		{
+			return;
+		}
+		cache.Store("file", fileKey, [&](std::ostream& os)
+		{
+			os << "submesh " << submeshCount << "\n";
+			os << "rmesh " << fileKey.ToString() << "\n";
+			for (auto&& tex : textures)
+			{
+				os << "texture " << tex.second.ToString() << " " << tex.first << "\n";
+			}
+			return os.good();
+		});
+	}
+
+	static const char* kMeshletModeNames[MeshletMode::Max] = { "scan", "cone", "flex" };
+
+	static const char* kTextureEncoderNames[TextureEncoder::Max] = { "dxtex", "portable" };
+	static const char* kBCQualityNames[BCQuality::Max] = { "fast", "final" };
+	static const char* kMipFilterNames[MipFilter::Max] = { "box", "kaiser" };
+
+	// index of the name in the table.
+	bool ParseName(const std::string& name, const char* const* pNames, uint32_t nameCount, uint32_t& outIndex)
+	{
+		for (uint32_t i = 0; i < nameCount; i++)
+		{
+			if (name == pNames[i])
+			{
+				outIndex = i;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool ParseMeshletMode(const std::string& name, uint32_t& outMode)
+	{
+		return ParseName(name, kMeshletModeNames, MeshletMode::Max, outMode);
+	}
+
+	// meshlet presets for target GPUs. they are starting points, and -letauto can find better ones for each mesh.
+	bool ApplyMeshletPreset(const std::string& target, ToolOptions& options)
+	{
+		struct Preset
+		{
+			const char*		name;
+			uint32_t		maxVertices;
+			uint32_t		maxTriangles;
+			uint32_t		mode;
+		};
+		static const Preset kPresets[] = {
+			{ "default",	64,		124,	MeshletMode::Scan },
+			{ "nvidia",		64,		124,	MeshletMode::Cone },		// NVIDIA recommends 64 vertices and 126 primitives. 124 is the nearest multiple of 4 meshoptimizer accepts.
+			{ "amd",		128,	256,	MeshletMode::Cone },		// larger meshlets amortize the per group cost of RDNA.
+			{ "culling",	64,		64,		MeshletMode::Flex },			// small and tight meshlets for fine grained culling.
+		};
+		for (auto&& preset : kPresets)
+		{
+			if (target == preset.name)
+			{
+				options.meshletMaxVertices = preset.maxVertices;
+				options.meshletMaxTriangles = preset.maxTriangles;
+				options.meshletMode = preset.mode;
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+// split a manifest line to arguments. double quoted string is one argument.
+std::vector<std::string> SplitArguments(const std::string& line)
+{
+	std::vector<std::string> ret;
+	std::string arg;
+	bool in_quote = false, has_arg = false;
+	for (auto&& c : line)
+	{
+		if (c == '"')
+		{
+			in_quote = !in_quote;
+			has_arg = true;
+		}
+		else if (!in_quote && (c == ' ' || c == '\t' || c == '\r'))
+		{
+			if (has_arg)
+			{
+				ret.push_back(arg);
+				arg.clear();
+				has_arg = false;
+			}
+		}
+		else
+		{
+			arg += c;
+			has_arg = true;
+		}
+	}
+	if (has_arg)
+	{
+		ret.push_back(arg);
+	}
+	return ret;
+}
+
+bool ParseToolOptions(const std::vector<std::string>& args, ToolOptions& options, ProcessOptions* pProcessOptions)
+{
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		const std::string& op = args[i];
+		if (op.empty() || (op[0] != '-' && op[0] != '/'))
+		{
+			fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+			return false;
+		}
+
+		if (op == "-i" || op == "/i")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.inputPath = ConvYenToSlash(args[++i]);
+			auto slash = options.inputPath.rfind('/');
+			if (slash == std::string::npos)
+			{
+				options.inputFileName = options.inputPath;
+				options.inputPath = "./";
+			}
+			else
+			{
+				options.inputFileName = &options.inputPath.data()[slash + 1];
+				options.inputPath = options.inputPath.erase(slash + 1, std::string::npos);
+			}
+		}
+		else if (op == "-o" || op == "/o")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.outputFilePath = args[++i];
+		}
+		else if (op == "-to" || op == "/to")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.outputTexPath = args[++i];
+		}
+		else if (op == "-dds" || op == "/dds")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.textureDDS = std::stoi(args[++i]);
+		}
+		else if (op == "-bc7" || op == "/bc7")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.compressBC7 = std::stoi(args[++i]);
+		}
+		else if (op == "-texenc" || op == "/texenc")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			if (!ParseName(args[++i], kTextureEncoderNames, TextureEncoder::Max, options.textureEncoder))
+			{
+				fprintf(stderr, "invalid texture encoder. (%s)\n", args[i].c_str());
+				return false;
+			}
+#if !defined(_WIN32)
+			if (options.textureEncoder == TextureEncoder::DirectXTex)
+			{
+				fprintf(stderr, "DirectXTex encoder is not available on this platform.\n");
+				return false;
+			}
+#endif
+		}
+		else if (op == "-texch" || op == "/texch")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.textureChannels = std::stoi(args[++i]);
+		}
+		else if (op == "-orm" || op == "/orm")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.packOcclusion = std::stoi(args[++i]);
+		}
+		else if (op == "-texdedup" || op == "/texdedup")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.textureDedup = std::stoi(args[++i]);
+		}
+		else if (op == "-mipfilter" || op == "/mipfilter")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			if (!ParseName(args[++i], kMipFilterNames, MipFilter::Max, options.mipFilter))
+			{
+				fprintf(stderr, "invalid mip filter. (%s)\n", args[i].c_str());
+				return false;
+			}
+		}
+		else if (op == "-mipgamma" || op == "/mipgamma")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.mipGammaCorrect = std::stoi(args[++i]);
+		}
+		else if (op == "-mipcoverage" || op == "/mipcoverage")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.mipAlphaCoverage = std::stoi(args[++i]);
+		}
+		else if (op == "-texquality" || op == "/texquality")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			if (!ParseName(args[++i], kBCQualityNames, BCQuality::Max, options.textureQuality))
+			{
+				fprintf(stderr, "invalid texture quality. (%s)\n", args[i].c_str());
+				return false;
+			}
+		}
+		else if (op == "-merge" || op == "/merge")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.mergeFlag = std::stoi(args[++i]);
+		}
+		else if (op == "-opt" || op == "/opt")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.optimizeFlag = std::stoi(args[++i]);
+		}
+		else if (op == "-optpass" || op == "/optpass")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.optimizeVertexCache = false;
+			options.optimizeOverdraw = false;
+			options.optimizeVertexFetch = false;
+			options.optimizeMeshletOrder = false;
+			std::stringstream passes(args[++i]);
+			std::string pass;
+			while (std::getline(passes, pass, ','))
+			{
+				if (pass == "vcache") options.optimizeVertexCache = true;
+				else if (pass == "overdraw") options.optimizeOverdraw = true;
+				else if (pass == "vfetch") options.optimizeVertexFetch = true;
+				else if (pass == "meshlet") options.optimizeMeshletOrder = true;
+				else if (pass != "none")
+				{
+					fprintf(stderr, "invalid optimization pass. (%s)\n", pass.c_str());
+					return false;
+				}
+			}
+		}
+		else if (op == "-overdraw" || op == "/overdraw")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.overdrawThreshold = std::max(std::stof(args[++i]), 1.0f);
+		}
+		else if (op == "-optreport" || op == "/optreport")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.optimizeReport = std::stoi(args[++i]);
+		}
+		else if (op == "-let" || op == "/let")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.meshletFlag = std::stoi(args[++i]);
+		}
+		else if (op == "-letvtx" || op == "/letvtx")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.meshletMaxVertices = (uint32_t)std::min(std::max(std::stoi(args[++i]), 3), 256);
+		}
+		else if (op == "-lettri" || op == "/lettri")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			// meshoptimizer requires the triangle limit to be a multiple of 4.
+			options.meshletMaxTriangles = (uint32_t)std::min(std::max(std::stoi(args[++i]), 4), 256) & ~3u;
+		}
+		else if (op == "-letmode" || op == "/letmode")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			if (!ParseMeshletMode(args[++i], options.meshletMode))
+			{
+				fprintf(stderr, "invalid meshlet mode. (%s)\n", args[i].c_str());
+				return false;
+			}
+		}
+		else if (op == "-letcone" || op == "/letcone")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.meshletConeWeight = std::min(std::max(std::stof(args[++i]), 0.0f), 1.0f);
+		}
+		else if (op == "-lettarget" || op == "/lettarget")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			if (!ApplyMeshletPreset(args[++i], options))
+			{
+				fprintf(stderr, "invalid meshlet target. (%s)\n", args[i].c_str());
+				return false;
+			}
+		}
+		else if (op == "-letauto" || op == "/letauto")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.meshletAutoTune = std::stoi(args[++i]);
+		}
+		else if (op == "-letcompact" || op == "/letcompact")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.meshletCompact = std::stoi(args[++i]);
+		}
+		else if (op == "-qvtx" || op == "/qvtx")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.quantizeVertex = std::stoi(args[++i]);
+		}
+		else if (op == "-quv" || op == "/quv")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.texcoordUnorm16 = std::stoi(args[++i]);
+		}
+		else if (op == "-comp" || op == "/comp")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.compressMesh = std::stoi(args[++i]);
+		}
+		else if (op == "-idx16" || op == "/idx16")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.index16 = std::stoi(args[++i]);
+		}
+		else if (op == "-idxsplit" || op == "/idxsplit")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.splitIndex16 = std::stoi(args[++i]);
+		}
+		else if (op == "-container" || op == "/container")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.containerFormat = std::stoi(args[++i]);
+		}
+		else if (op == "-lod" || op == "/lod")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.lodCount = (uint32_t)std::max(std::stoi(args[++i]), 1);
+		}
+		else if (op == "-lodratio" || op == "/lodratio")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.lodRatio = std::min(std::max(std::stof(args[++i]), 0.0f), 1.0f);
+		}
+		else if (op == "-loderr" || op == "/loderr")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.lodError = std::max(std::stof(args[++i]), 0.0f);
+		}
+		else if (op == "-dag" || op == "/dag")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.clusterDag = std::stoi(args[++i]);
+		}
+		else if (op == "-inst" || op == "/inst")
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			options.instancing = std::stoi(args[++i]);
+		}
+		else if (pProcessOptions && (op == "-batch" || op == "/batch"))
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			pProcessOptions->batchPath = ConvYenToSlash(args[++i]);
+		}
+		else if (pProcessOptions && (op == "-cache" || op == "/cache"))
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			pProcessOptions->cachePath = ConvYenToSlash(args[++i]);
+		}
+		else if (pProcessOptions && (op == "-stats" || op == "/stats"))
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			pProcessOptions->statsPath = ConvYenToSlash(args[++i]);
+		}
+		else if (pProcessOptions && (op == "-j" || op == "/j"))
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			pProcessOptions->threadCount = (uint32_t)std::max(std::stoi(args[++i]), 0);
+		}
+		else if (pProcessOptions && (op == "-texmem" || op == "/texmem"))
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			pProcessOptions->textureMemoryMB = (uint32_t)std::max(std::stoi(args[++i]), 1);
+		}
+		else if (pProcessOptions && (op == "-serve" || op == "/serve"))
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			pProcessOptions->servePath = ConvYenToSlash(args[++i]);
+		}
+		else if (pProcessOptions && (op == "-cachemem" || op == "/cachemem"))
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			pProcessOptions->cacheMemoryMB = (uint32_t)std::max(std::stoi(args[++i]), 0);
+		}
+		else if (pProcessOptions && (op == "-watch" || op == "/watch"))
+		{
+			if (i == args.size() - 1)
+			{
+				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+				return false;
+			}
+			pProcessOptions->watchFlag = std::stoi(args[++i]);
+		}
+		else
+		{
+			fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FinalizeToolOptions(ToolOptions& options)
+{
+	if (options.inputFileName.empty() || options.inputPath.empty())
+	{
+		fprintf(stderr, "invalid input file name.\n");
+		return false;
+	}
+	if (options.outputFilePath.empty())
+	{
+		fprintf(stderr, "invalid output file name.\n");
+		return false;
+	}
+	if (options.outputTexPath.empty())
+	{
+		options.outputTexPath = GetPath(ConvYenToSlash(options.outputFilePath));
+	}
+	else
+	{
+		options.outputTexPath = ConvYenToSlash(options.outputTexPath);
+		if (options.outputTexPath[options.outputTexPath.length() - 1] != '/')
+		{
+			options.outputTexPath += '/';
+		}
+	}
+
+	{
+		auto outDir = GetPath(ConvYenToSlash(options.outputFilePath));
+		std::error_code ec;
+		if (!outDir.empty())
+		{
+			std::filesystem::create_directories(outDir, ec);
+		}
+		std::filesystem::create_directories(options.outputTexPath, ec);
+	}
+
+	return true;
+}
+
+bool CollectInputFiles(const ToolOptions& options, std::vector<std::string>& outFiles)
+{
+	std::string input_file = options.inputPath + options.inputFileName;
+	outFiles.push_back(input_file);
+	if (GetExtent(options.inputFileName) == ".glb")
+	{
+		return true;
+	}
+
+	std::ifstream ifs(input_file, std::ios::in | std::ios::binary);
+	if (!ifs)
+	{
+		return false;
+	}
+	std::stringstream manifest;
+	manifest << ifs.rdbuf();
+	auto document = Deserialize(manifest.str());
+	for (auto&& buffer : document.buffers.Elements())
+	{
+		if (buffer.uri.empty() || buffer.uri.compare(0, 5, "data:") == 0)
+		{
+			continue;
+		}
+		outFiles.push_back(options.inputPath + buffer.uri);
+	}
+	return true;
+}
+
+bool ConvertFile(const ToolOptions& options, ConvertContext& context, ConvertResult* pResult)
+{
+	JobSystem& jobSystem = *context.pJobSystem;
+	MemoryBudget& textureBudget = *context.pTextureBudget;
+	BuildCache* pCache = context.pCache;
+
+	auto start_time = std::chrono::steady_clock::now();
+
+	ConvertStats* pStats = nullptr;
+	if (pResult && context.isStatsEnabled)
+	{
+		pResult->pStats = std::make_shared<ConvertStats>();
+		pStats = pResult->pStats.get();
+	}
+	auto FinishStats = [&]()
+	{
+		if (pStats)
+		{
+			double total_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+			pStats->SetFileInfo(options.inputFileName, total_seconds);
+		}
+	};
+
+	// restore all outputs if the same input was converted with the same options.
+	ContentHash file_key;
+	bool has_file_key = false;
+	if (pCache)
+	{
+		bool restored = false;
+		{
+			ScopedStats stats(pStats, "RestoreFileCache");
+			ContentHasher hasher;
+			hasher.Update(std::string(kCacheToolVersion));
+			HashToolOptions(hasher, options);
+			has_file_key = HashInputFiles(options, hasher);
+			file_key = hasher.Finalize();
+			restored = has_file_key && RestoreFileFromCache(*pCache, file_key, options, pResult);
+		}
+		if (restored)
+		{
+			if (pResult)
+			{
+				pResult->elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+			}
+			FinishStats();
+			fprintf(stdout, "restored from build cache. (%s)\n", options.inputFileName.c_str());
+			return true;
+		}
+	}
+
+	fprintf(stdout, "read glTF mesh. (%s)\n", options.inputFileName.c_str());
+	auto mesh_work = std::make_unique<MeshWork>(&jobSystem, pStats);
+	{
+		ScopedStats stats(pStats, "ReadGLTFMesh");
+		if (!mesh_work->ReadGLTFMesh(options.inputPath, options.inputFileName, options.instancing))
+		{
+			fprintf(stderr, "failed to read glTF mesh. (%s)\n", options.inputFileName.c_str());
+			return false;
+		}
+	}
+	if (options.instancing)
+	{
+		fprintf(stdout, "instancing: %zu meshes, %zu instances.\n", mesh_work->GetInstancedMeshes().size(), mesh_work->GetInstances().size());
+	}
+
+	if (options.textureDedup)
+	{
+		size_t removed_count = mesh_work->DeduplicateTextures();
+		if (removed_count > 0)
+		{
+			fprintf(stdout, "removed %zu duplicated textures.\n", removed_count);
+		}
+	}
+
+	// texture outputs for build cache.
+	std::vector<std::pair<std::string, ContentHash>> texture_outputs(mesh_work->GetTextures().size());
+
+	// output DDS textures in parallel with mesh processing.
+	JobGroup texture_group;
+	std::atomic<bool> texture_failed{ false };
+	// texture jobs refer to the locals above and textures of mesh_work. any exit from here waits for them.
+	ScopedJobWait texture_wait(jobSystem, texture_group);
+	if (options.textureDDS)
+	{
+		if (!mesh_work->GetTextures().empty())
+		{
+			fprintf(stdout, "output DDS textures.\n");
+			if (options.packOcclusion)
+			{
+				size_t packed_count = mesh_work->PackOcclusionTextures();
+				fprintf(stdout, "packed occlusion into %zu ORM textures.\n", packed_count);
+			}
+
+			// DirectXTex parallel compression is used only if textures are converted one by one.
+			bool parallel_compress = jobSystem.GetThreadCount() == 1;
+			for (size_t tex_index = 0; tex_index < mesh_work->GetTextures().size(); tex_index++)
+			{
+				TextureWork* pTex = mesh_work->GetTextures()[tex_index].get();
+				auto pOutput = &texture_outputs[tex_index];
+				jobSystem.Push(texture_group, [&options, &jobSystem, &textureBudget, &texture_failed, pCache, pStats, pTex, pOutput, parallel_compress]
+				{
+					std::string name = GetFileName(pTex->GetName()) + ".dds";
+					std::string kind = GetTextureKind(pTex->GetName());
+
+					ContentHasher hasher;
+					hasher.Update(std::string(kCacheToolVersion));
+					hasher.Update(std::string("dds"));
+					hasher.Update(pTex->GetBinary());
+					hasher.UpdateValue(kind == "bc");
+					hasher.UpdateValue(kind == "n");
+					hasher.UpdateValue(options.compressBC7);
+					hasher.UpdateValue(options.textureEncoder);
+					hasher.UpdateValue(options.textureQuality);
+					hasher.UpdateValue(options.textureChannels);
+					hasher.UpdateValue(options.mipFilter);
+					hasher.UpdateValue(options.mipGammaCorrect);
+					hasher.UpdateValue(options.mipAlphaCoverage ? pTex->GetAlphaCutoff() : -1.0f);
+					if (pTex->GetOcclusionSource())
+					{
+						hasher.Update(pTex->GetOcclusionSource()->GetBinary());
+					}
+					*pOutput = std::make_pair(name, hasher.Finalize());
+					if (pCache && pCache->RestoreFile("texture", pOutput->second, options.outputTexPath + name))
+					{
+						fprintf(stdout, "restored %s texture from build cache.\n", name.c_str());
+						return;
+					}
+					fprintf(stdout, "writing %s texture... (kind: %s)\n", name.c_str(), kind.c_str());
+
+					bool result = false;
+					{
+						MemoryBudgetLease lease(textureBudget, EstimateDDSMemorySize(pTex));
+#if defined(_WIN32)
+						if (options.textureEncoder == TextureEncoder::DirectXTex)
+						{
+							HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+							result = ConvertToDDSWithDirectXTex(pTex, options.outputTexPath + name, kind == "bc", kind == "n", options, &jobSystem, parallel_compress, pStats);
+							if (SUCCEEDED(hr))
+							{
+								CoUninitialize();
+							}
+						}
+						else
+#endif
+						{
+							// blocks are encoded in parallel. ParallelFor waits only for its own jobs, so other textures do not run on this thread while the budget is held.
+							result = ConvertToDDSWithBCEncoder(pTex, options.outputTexPath + name, kind == "bc", kind == "n", options, &jobSystem, pStats);
+						}
+					}
+
+					if (!result)
+					{
+						fprintf(stderr, "failed to write %s texture...\n", name.c_str());
+						texture_failed = true;
+					}
+					else if (pCache)
+					{
+						pCache->StoreFile("texture", pOutput->second, options.outputTexPath + name);
+					}
+				});
+			}
+		}
+	}
+
+	// processed geometry does not depend on materials and textures, except whether tangents are needed. (in the geometry hash)
+	ContentHash geometry_key;
+	{
+		ContentHasher hasher;
+		hasher.Update(std::string(kCacheToolVersion));
+		hasher.Update(std::string("geometry"));
+		hasher.UpdateValue(options.mergeFlag);
+		hasher.UpdateValue(options.optimizeFlag);
+		hasher.UpdateValue(options.optimizeVertexCache);
+		hasher.UpdateValue(options.optimizeOverdraw);
+		hasher.UpdateValue(options.optimizeVertexFetch);
+		hasher.UpdateValue(options.optimizeMeshletOrder);
+		hasher.UpdateValue(options.overdrawThreshold);
+		hasher.UpdateValue(options.meshletFlag);
+		hasher.UpdateValue(options.meshletMaxVertices);
+		hasher.UpdateValue(options.meshletMaxTriangles);
+		hasher.UpdateValue(options.meshletMode);
+		hasher.UpdateValue(options.meshletConeWeight);
+		hasher.UpdateValue(options.meshletAutoTune);
+		hasher.UpdateValue(options.splitIndex16);
+		hasher.UpdateValue(options.lodCount);
+		hasher.UpdateValue(options.lodRatio);
+		hasher.UpdateValue(options.lodError);
+		hasher.UpdateValue(options.clusterDag);
+		hasher.UpdateValue(options.instancing);
+		hasher.Update(mesh_work->GetGeometryHash());
+		geometry_key = hasher.Finalize();
+	}
+	bool geometry_restored = false;
+	if (pCache)
+	{
+		ScopedStats stats(pStats, "RestoreGeometryCache");
+		geometry_restored = pCache->Load("geometry", geometry_key, [&](std::istream& is) { return mesh_work->LoadGeometry(is); });
+	}
+	if (geometry_restored)
+	{
+		fprintf(stdout, "restored geometry from build cache.\n");
+		if (options.optimizeReport)
+		{
+			// the passes did not run, so there is nothing to measure.
+			fprintf(stdout, "optimization metrics: unavailable (geometry restored from build cache)\n");
+		}
+	}
+	else
+	{
+		OptimizeOptions optimize_options;
+		optimize_options.passes = 0;
+		if (options.optimizeFlag)
+		{
+			if (options.optimizeVertexCache) optimize_options.passes |= OptimizePass::VertexCache;
+			if (options.optimizeOverdraw) optimize_options.passes |= OptimizePass::Overdraw;
+			if (options.optimizeVertexFetch) optimize_options.passes |= OptimizePass::VertexFetch;
+			if (options.optimizeMeshletOrder) optimize_options.passes |= OptimizePass::MeshletOrder;
+		}
+		optimize_options.overdrawThreshold = options.overdrawThreshold;
+		optimize_options.analyze = options.optimizeReport;
+
+		MeshletOptions meshlet_options;
+		meshlet_options.maxVertices = options.meshletMaxVertices;
+		meshlet_options.maxTriangles = options.meshletMaxTriangles;
+		meshlet_options.mode = options.meshletMode;
+		meshlet_options.coneWeight = options.meshletConeWeight;
+		meshlet_options.autoTune = options.meshletAutoTune;
+
+		fprintf(stdout, "generate tangents.\n");
+		{
+			ScopedStats stats(pStats, "GenerateTangentAndBounds");
+			mesh_work->GenerateTangentAndBounds();
+		}
+
+		if (options.mergeFlag)
+		{
+			fprintf(stdout, "merge submeshes.\n");
+			ScopedStats stats(pStats, "MergeSubmesh");
+			if (mesh_work->MergeSubmesh() == 0)
+			{
+				fprintf(stderr, "failed to merge submeshes.\n");
+				return false;
+			}
+		}
+
+		if (options.optimizeFlag)
+		{
+			fprintf(stdout, "optimize mesh.\n");
+			ScopedStats stats(pStats, "OptimizeSubmesh");
+			mesh_work->OptimizeSubmesh(optimize_options);
+		}
+
+		if (options.splitIndex16)
+		{
+			ScopedStats stats(pStats, "SplitSubmesh");
+			size_t split_count = mesh_work->SplitSubmesh();
+			if (split_count > 0)
+			{
+				fprintf(stdout, "split %zu submeshes for 16bit indices. (%zu submeshes)\n", split_count, mesh_work->GetSubmeshes().size());
+			}
+		}
+
+		if (options.lodCount > 1)
+		{
+			fprintf(stdout, "build LODs.\n");
+			ScopedStats stats(pStats, "BuildLods");
+			mesh_work->BuildLods(options.lodCount, options.lodRatio, options.lodError);
+		}
+
+		if (options.meshletFlag)
+		{
+			fprintf(stdout, "build meshlets.\n");
+			ScopedStats stats(pStats, "BuildMeshlets");
+			mesh_work->BuildMeshlets(meshlet_options, optimize_options);
+			meshlet_options = mesh_work->GetMeshletOptions();
+
+			for (auto&& candidate : mesh_work->GetMeshletCandidates())
+			{
+				fprintf(stdout, "  meshlet %3u/%3u %-7s: fill %.3f, tightness %.3f, cone %.3f, total %.3f\n",
+					candidate.options.maxVertices, candidate.options.maxTriangles, kMeshletModeNames[candidate.options.mode],
+					candidate.score.fill, candidate.score.tightness, candidate.score.cone, candidate.score.total);
+			}
+			if (options.meshletAutoTune)
+			{
+				fprintf(stdout, "meshlet auto tune: %u vertices, %u triangles, %s.\n",
+					meshlet_options.maxVertices, meshlet_options.maxTriangles, kMeshletModeNames[meshlet_options.mode]);
+			}
+		}
+
+		if (options.clusterDag)
+		{
+			fprintf(stdout, "build cluster DAG.\n");
+			ScopedStats stats(pStats, "BuildClusterDag");
+			mesh_work->BuildClusterDag(meshlet_options);
+		}
+
+		if (options.optimizeReport)
+		{
+			fprintf(stdout, "optimization metrics: (ACMR / ATVR / overdraw / overfetch)\n");
+			for (auto&& metrics : mesh_work->GetPassMetrics())
+			{
+				fprintf(stdout, "  %-12s: %.3f / %.3f / %.3f / %.3f -> %.3f / %.3f / %.3f / %.3f\n",
+					metrics.pass.c_str(),
+					metrics.before.acmr, metrics.before.atvr, metrics.before.overdraw, metrics.before.overfetch,
+					metrics.after.acmr, metrics.after.atvr, metrics.after.overdraw, metrics.after.overfetch);
+			}
+		}
+
+		if (pCache)
+		{
+			ScopedStats stats(pStats, "StoreGeometryCache");
+			pCache->Store("geometry", geometry_key, [&](std::ostream& os) { return mesh_work->SaveGeometry(os); });
+		}
+	}
+
+	// wait for DDS textures.
+	if (options.textureDDS)
+	{
+		if (!mesh_work->GetTextures().empty())
+		{
+			{
+				ScopedStats stats(pStats, "WaitTextures");
+				jobSystem.Wait(texture_group);
+			}
+			if (texture_failed)
+			{
+				return false;
+			}
+			fprintf(stdout, "complete to output DDS textures.\n");
+		}
+	}
+	else
+	{
+		fprintf(stdout, "output PNG textures.\n");
+		for (size_t tex_index = 0; tex_index < mesh_work->GetTextures().size(); tex_index++)
+		{
+			auto&& tex = mesh_work->GetTextures()[tex_index];
+			fprintf(stdout, "writing %s texture...\n", tex->GetName().c_str());
+			{
+				std::fstream ofs(options.outputTexPath + tex->GetName(), std::ios::out | std::ios::binary);
+				ofs.write((const char*)tex->GetBinary().data(), tex->GetBinary().size());
+			}
+
+			ContentHasher hasher;
+			hasher.Update(std::string("png"));
+			hasher.Update(tex->GetBinary());
+			texture_outputs[tex_index] = std::make_pair(tex->GetName(), hasher.Finalize());
+			if (pCache)
+			{
+				pCache->StoreFile("texture", texture_outputs[tex_index].second, options.outputTexPath + tex->GetName());
+			}
+		}
+		fprintf(stdout, "complete to output PNG textures.\n");
+	}
+
+	// output binary.
+	fprintf(stdout, "output rmesh binary.\n");
+	size_t output_size = 0;
+	{
+		ScopedStats stats(pStats, "WriteRMesh");
+		if (!WriteRMesh(*mesh_work, options, &jobSystem, true, &output_size))
+		{
+			fprintf(stderr, "failed to write rmesh. (%s)\n", options.outputFilePath.c_str());
+			return false;
+		}
+	}
+
+	if (pCache && has_file_key)
+	{
+		ScopedStats stats(pStats, "StoreFileCache");
+		StoreFileToCache(*pCache, file_key, options, mesh_work->GetSubmeshes().size(), texture_outputs);
+	}
+
+	fprintf(stdout, "convert succeeded!!. (%s)\n", options.inputFileName.c_str());
+
+	if (pResult)
+	{
+		pResult->isSucceeded = true;
+		pResult->submeshCount = mesh_work->GetSubmeshes().size();
+		pResult->textureCount = mesh_work->GetTextures().size();
+		pResult->outputSize = output_size;
+		pResult->elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+	}
+	FinishStats();
+	return true;
+}
+
+
+//	EOF
@@ -0,0 +1,129 @@
+﻿#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <memory>
+
+#include "job_system.h"
+#include "stats.h"
+#include "bc_encoder.h"
+#include "mip_generator.h"
+
+class BuildCache;
+
+
+// backend of DDS texture compression.
+struct TextureEncoder
+{
+	enum Type : uint32_t
+	{
+		DirectXTex,		// DirectXTex with COM. windows only.
+		Portable,		// built in BC encoder. see bc_encoder.h.
+
+		Max
+	};
+};	// struct TextureEncoder
+
+
+// options for one conversion job.
+// options which affect outputs must be added to HashToolOptions() for build cache.
+struct ToolOptions
+{
+	std::string		inputFileName = "";
+	std::string		inputPath = "";
+	std::string		outputFilePath = "";
+	std::string		outputTexPath = "";
+
+	bool			textureDDS = true;
+	bool			compressBC7 = false;
+#if defined(_WIN32)
+	uint32_t		textureEncoder = TextureEncoder::DirectXTex;
+#else
+	uint32_t		textureEncoder = TextureEncoder::Portable;
+#endif
+	uint32_t		textureQuality = BCQuality::Final;	// BCQuality::Type for the portable encoder.
+	bool			textureChannels = false;	// BC5 for normal maps, BC4 for grayscale non color textures. the runtime reconstructs normal z and replicates BC4 red.
+	bool			packOcclusion = false;		// pack glTF occlusion textures into the red channel of ORM textures.
+	bool			textureDedup = true;		// textures with the same image bytes are written once.
+	uint32_t		mipFilter = MipFilter::Kaiser;	// MipFilter::Type
+	bool			mipGammaCorrect = true;		// filter mips of sRGB textures in linear space.
+	bool			mipAlphaCoverage = true;	// keep the alpha test coverage in mips of base color textures of alpha mask materials.
+	bool			mergeFlag = true;
+	bool			optimizeFlag = true;
+	bool			optimizeVertexCache = true;		// passes of optimizeFlag. see OptimizePass.
+	bool			optimizeOverdraw = false;
+	bool			optimizeVertexFetch = true;
+	bool			optimizeMeshletOrder = false;
+	float			overdrawThreshold = 1.05f;		// ACMR increase allowed for the overdraw pass.
+	bool			optimizeReport = false;			// print ACMR/ATVR/overdraw/overfetch before and after each pass.
+	bool			meshletFlag = false;
+	uint32_t		meshletMaxVertices = 64;		// limits of meshlets and DAG clusters.
+	uint32_t		meshletMaxTriangles = 124;
+	uint32_t		meshletMode = 0;				// MeshletMode::Type
+	float			meshletConeWeight = 0.25f;
+	bool			meshletAutoTune = false;		// pick the limits and mode by the meshlet scores.
+	bool			meshletCompact = false;			// uint8 triangles and uint16 vertex indices. see RMeshMeshletEncoding.
+	bool			quantizeVertex = false;		// quantized vertex streams. see RMeshVertexFormat.
+	bool			texcoordUnorm16 = false;	// quantized texcoords are unorm16 in the submesh range. if false, half float.
+	bool			index16 = true;				// uint16 indices for submeshes which have 65536 vertices or less.
+	bool			splitIndex16 = false;		// split larger submeshes, so that all submeshes can use uint16 indices.
+	bool			compressMesh = false;		// compress mesh buffers with meshoptimizer codecs. see RMeshCompression.
+	bool			containerFormat = false;	// memory mappable container. if false, cereal binary archive.
+	uint32_t		lodCount = 1;				// LOD levels including LOD 0. 1 means no LOD.
+	float			lodRatio = 0.5f;			// triangle ratio of each LOD to the previous level.
+	float			lodError = 0.05f;			// max simplification error relative to the submesh extent.
+	bool			clusterDag = false;			// hierarchical cluster DAG for continuous LOD.
+	bool			instancing = false;			// meshes are written once with an instance table. if false, node transforms are baked.
+};	// struct ToolOptions
+
+// options shared by all jobs in this process.
+struct ProcessOptions
+{
+	std::string		batchPath = "";
+	std::string		cachePath = "";
+	std::string		statsPath = "";
+	uint32_t		threadCount = 0;
+	uint32_t		textureMemoryMB = 4096;
+	std::string		servePath = "";				// "stdin" or a unix socket path. if not empty, run as a conversion server.
+	uint32_t		cacheMemoryMB = 1024;		// memory cache of the build cache in server and watch mode.
+	bool			watchFlag = false;			// convert again whenever the input files are changed.
+};	// struct ProcessOptions
+
+struct ConvertResult
+{
+	bool			isSucceeded = false;
+	bool			isCacheHit = false;
+	size_t			submeshCount = 0;
+	size_t			textureCount = 0;
+	size_t			outputSize = 0;
+	double			elapsedSeconds = 0.0;
+
+	std::shared_ptr<ConvertStats>	pStats;		// valid if ConvertContext::isStatsEnabled.
+};	// struct ConvertResult
+
+// split a manifest line to arguments. double quoted string is one argument.
+std::vector<std::string> SplitArguments(const std::string& line);
+
+// if pProcessOptions is null, process options are treated as invalid arguments.
+bool ParseToolOptions(const std::vector<std::string>& args, ToolOptions& options, ProcessOptions* pProcessOptions);
+
+// check the options and resolve the output paths.
+bool FinalizeToolOptions(ToolOptions& options);
+
+// shared resources for conversion jobs.
+struct ConvertContext
+{
+	JobSystem*		pJobSystem = nullptr;
+	MemoryBudget*	pTextureBudget = nullptr;
+	BuildCache*		pCache = nullptr;			// if null, build cache is not used.
+	bool			isStatsEnabled = false;		// collect per stage statistics to ConvertResult.
+};	// struct ConvertContext
+
+// input file and external buffer files which the outputs depend on.
+// images of .gltf files are not converted, so they are not included.
+bool CollectInputFiles(const ToolOptions& options, std::vector<std::string>& outFiles);
+
+bool ConvertFile(const ToolOptions& options, ConvertContext& context, ConvertResult* pResult);
+
+//	EOF
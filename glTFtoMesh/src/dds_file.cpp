@@ -0,0 +1,151 @@
+﻿#include "dds_file.h"
+
+#include <cstdio>
+
+#include "bc_encoder.h"
+
+
+namespace
+{
+	constexpr uint32_t MakeFourCC(char c0, char c1, char c2, char c3)
+	{
+		return (uint32_t)(uint8_t)c0 | ((uint32_t)(uint8_t)c1 << 8) | ((uint32_t)(uint8_t)c2 << 16) | ((uint32_t)(uint8_t)c3 << 24);
+	}
+
+	const uint32_t kDDSMagic = MakeFourCC('D', 'D', 'S', ' ');
+
+	const uint32_t kDDSD_Caps = 0x1;
+	const uint32_t kDDSD_Height = 0x2;
+	const uint32_t kDDSD_Width = 0x4;
+	const uint32_t kDDSD_PixelFormat = 0x1000;
+	const uint32_t kDDSD_MipMapCount = 0x20000;
+	const uint32_t kDDSD_LinearSize = 0x80000;
+	const uint32_t kDDPF_FourCC = 0x4;
+	const uint32_t kDDSCaps_Complex = 0x8;
+	const uint32_t kDDSCaps_Texture = 0x1000;
+	const uint32_t kDDSCaps_MipMap = 0x400000;
+	const uint32_t kD3D10ResourceDimensionTexture2D = 3;
+
+	struct DDSPixelFormat
+	{
+		uint32_t	size;
+		uint32_t	flags;
+		uint32_t	fourCC;
+		uint32_t	rgbBitCount;
+		uint32_t	rBitMask;
+		uint32_t	gBitMask;
+		uint32_t	bBitMask;
+		uint32_t	aBitMask;
+	};	// struct DDSPixelFormat
+
+	struct DDSHeader
+	{
+		uint32_t		size;
+		uint32_t		flags;
+		uint32_t		height;
+		uint32_t		width;
+		uint32_t		pitchOrLinearSize;
+		uint32_t		depth;
+		uint32_t		mipMapCount;
+		uint32_t		reserved1[11];
+		DDSPixelFormat	pixelFormat;
+		uint32_t		caps;
+		uint32_t		caps2;
+		uint32_t		caps3;
+		uint32_t		caps4;
+		uint32_t		reserved2;
+	};	// struct DDSHeader
+	static_assert(sizeof(DDSHeader) == 124, "DDS header size");
+
+	struct DDSHeaderDX10
+	{
+		uint32_t	dxgiFormat;
+		uint32_t	resourceDimension;
+		uint32_t	miscFlag;
+		uint32_t	arraySize;
+		uint32_t	miscFlags2;
+	};	// struct DDSHeaderDX10
+	static_assert(sizeof(DDSHeaderDX10) == 20, "DDS DX10 header size");
+
+	// DXGI_FORMAT values.
+	uint32_t GetDXGIFormat(uint32_t format, bool isSrgb)
+	{
+		switch (format)
+		{
+		case BCFormat::BC1: return isSrgb ? 72 : 71;
+		case BCFormat::BC3: return isSrgb ? 78 : 77;
+		case BCFormat::BC4: return 80;
+		case BCFormat::BC5: return 83;
+		default:			return isSrgb ? 99 : 98;
+		}
+	}
+
+	// legacy FourCC for UNORM formats, 0 if the format needs the DX10 header.
+	uint32_t GetLegacyFourCC(uint32_t format, bool isSrgb)
+	{
+		if (isSrgb)
+		{
+			return 0;
+		}
+		switch (format)
+		{
+		case BCFormat::BC1: return MakeFourCC('D', 'X', 'T', '1');
+		case BCFormat::BC3: return MakeFourCC('D', 'X', 'T', '5');
+		case BCFormat::BC4: return MakeFourCC('B', 'C', '4', 'U');
+		case BCFormat::BC5: return MakeFourCC('B', 'C', '5', 'U');
+		default:			return 0;
+		}
+	}
+}
+
+bool WriteDDSFile(const std::string& filePath, uint32_t format, bool isSrgb, uint32_t width, uint32_t height, const std::vector<std::vector<uint8_t>>& mips)
+{
+	DDSHeader header = {};
+	header.size = sizeof(DDSHeader);
+	header.flags = kDDSD_Caps | kDDSD_Height | kDDSD_Width | kDDSD_PixelFormat | kDDSD_MipMapCount | kDDSD_LinearSize;
+	header.height = height;
+	header.width = width;
+	header.pitchOrLinearSize = (uint32_t)GetBCImageSize(format, width, height);
+	header.depth = 1;
+	header.mipMapCount = (uint32_t)mips.size();
+	header.pixelFormat.size = sizeof(DDSPixelFormat);
+	header.pixelFormat.flags = kDDPF_FourCC;
+	header.pixelFormat.fourCC = GetLegacyFourCC(format, isSrgb);
+	header.caps = kDDSCaps_Texture | kDDSCaps_MipMap | kDDSCaps_Complex;
+
+	DDSHeaderDX10 header_dx10 = {};
+	bool use_dx10 = header.pixelFormat.fourCC == 0;
+	if (use_dx10)
+	{
+		header.pixelFormat.fourCC = MakeFourCC('D', 'X', '1', '0');
+		header_dx10.dxgiFormat = GetDXGIFormat(format, isSrgb);
+		header_dx10.resourceDimension = kD3D10ResourceDimensionTexture2D;
+		header_dx10.arraySize = 1;
+	}
+
+	FILE* fp = fopen(filePath.c_str(), "wb");
+	if (!fp)
+	{
+		fprintf(stderr, "failed to open dds file. (%s)\n", filePath.c_str());
+		return false;
+	}
+	bool is_ok = fwrite(&kDDSMagic, sizeof(kDDSMagic), 1, fp) == 1;
+	is_ok = is_ok && fwrite(&header, sizeof(header), 1, fp) == 1;
+	if (use_dx10)
+	{
+		is_ok = is_ok && fwrite(&header_dx10, sizeof(header_dx10), 1, fp) == 1;
+	}
+	for (auto&& mip : mips)
+	{
+		is_ok = is_ok && fwrite(mip.data(), 1, mip.size(), fp) == mip.size();
+	}
+	fclose(fp);
+	if (!is_ok)
+	{
+		fprintf(stderr, "failed to write dds file. (%s)\n", filePath.c_str());
+	}
+	return is_ok;
+}
+
+
+//	EOF
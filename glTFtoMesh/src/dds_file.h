@@ -0,0 +1,13 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// write BC compressed mips to a DDS file.
+// format is BCFormat. the header is the same as DirectXTex writes, so the runtime loader reads both.
+// BC7 and sRGB formats use the DX10 extended header.
+bool WriteDDSFile(const std::string& filePath, uint32_t format, bool isSrgb, uint32_t width, uint32_t height, const std::vector<std::vector<uint8_t>>& mips);
+
+//	EOF
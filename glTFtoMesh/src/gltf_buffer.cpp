@@ -0,0 +1,349 @@
+﻿#include "gltf_buffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define GLTF_BUFFER_SSE2 1
+#include <emmintrin.h>
+#else
+#define GLTF_BUFFER_SSE2 0
+#endif
+
+
+using namespace Microsoft::glTF;
+
+namespace
+{
+	static const uint32_t kGlbMagic = 0x46546C67;		// "glTF"
+	static const uint32_t kGlbChunkJson = 0x4E4F534A;	// "JSON"
+	static const uint32_t kGlbChunkBin = 0x004E4942;	// "BIN\0"
+
+	uint32_t ReadU32(const uint8_t* p)
+	{
+		uint32_t ret;
+		memcpy(&ret, p, sizeof(ret));
+		return ret;
+	}
+
+	// relative uris may be percent encoded.
+	std::string DecodeUri(const std::string& uri)
+	{
+		std::string ret;
+		ret.reserve(uri.length());
+		for (size_t i = 0; i < uri.length(); i++)
+		{
+			if (uri[i] == '%' && i + 2 < uri.length())
+			{
+				ret += (char)std::stoi(uri.substr(i + 1, 2), nullptr, 16);
+				i += 2;
+			}
+			else
+			{
+				ret += uri[i];
+			}
+		}
+		return ret;
+	}
+
+	template <typename T>
+	void WidenStrided(const AccessorView& view, uint32_t* pDst)
+	{
+		const uint8_t* src = view.pData;
+		for (size_t i = 0; i < view.count; i++, src += view.stride)
+		{
+			T v;
+			memcpy(&v, src, sizeof(T));
+			pDst[i] = v;
+		}
+	}
+}
+
+bool ParseGLB(const uint8_t* pData, size_t size, std::string& outJson, const uint8_t*& outBin, size_t& outBinSize)
+{
+	outBin = nullptr;
+	outBinSize = 0;
+	if (size < 12 || ReadU32(pData) != kGlbMagic || ReadU32(pData + 4) != 2)
+	{
+		return false;
+	}
+	size_t length = std::min((size_t)ReadU32(pData + 8), size);
+
+	bool has_json = false;
+	size_t pos = 12;
+	while (pos + 8 <= length)
+	{
+		size_t chunk_size = ReadU32(pData + pos);
+		uint32_t chunk_type = ReadU32(pData + pos + 4);
+		pos += 8;
+		if (chunk_size > length - pos)
+		{
+			return false;
+		}
+		if (chunk_type == kGlbChunkJson && !has_json)
+		{
+			outJson.assign(reinterpret_cast<const char*>(pData + pos), chunk_size);
+			has_json = true;
+		}
+		else if (chunk_type == kGlbChunkBin && !outBin)
+		{
+			outBin = pData + pos;
+			outBinSize = chunk_size;
+		}
+		pos += (chunk_size + 3) & ~(size_t)3;
+	}
+	return has_json;
+}
+
+void GLTFBufferSet::Setup(const Document& document, const std::string& inputPath, const uint8_t* pGlbBin, size_t glbBinSize)
+{
+	buffers_.clear();
+	files_.clear();
+	for (auto&& buffer : document.buffers.Elements())
+	{
+		Buffer b = { nullptr, 0 };
+		if (buffer.uri.empty())
+		{
+			// only the first buffer of GLB refers the BIN chunk.
+			if (buffers_.empty() && pGlbBin)
+			{
+				b.pData = pGlbBin;
+				b.size = glbBinSize;
+			}
+		}
+		else if (buffer.uri.compare(0, 5, "data:") != 0)
+		{
+			auto file = std::make_unique<MappedFile>();
+			if (file->Open(inputPath + DecodeUri(buffer.uri)))
+			{
+				b.pData = file->GetData();
+				b.size = file->GetSize();
+				files_.push_back(std::move(file));
+			}
+		}
+		buffers_.push_back(b);
+	}
+}
+
+bool GLTFBufferSet::GetBufferViewData(const Document& document, const std::string& bufferViewId, const uint8_t*& outData, size_t& outSize) const
+{
+	if (bufferViewId.empty())
+	{
+		return false;
+	}
+	auto&& view = document.bufferViews.Get(bufferViewId);
+	size_t buffer_index = std::stoul(view.bufferId);
+	if (buffer_index >= buffers_.size() || !buffers_[buffer_index].pData)
+	{
+		return false;
+	}
+	auto&& buffer = buffers_[buffer_index];
+	if (view.byteOffset > buffer.size || view.byteLength > buffer.size - view.byteOffset)
+	{
+		return false;
+	}
+	outData = buffer.pData + view.byteOffset;
+	outSize = view.byteLength;
+	return true;
+}
+
+bool GLTFBufferSet::GetAccessorView(const Document& document, const Accessor& accessor, AccessorView& outView) const
+{
+	if (accessor.sparse.count > 0)
+	{
+		return false;
+	}
+	const uint8_t* view_data;
+	size_t view_size;
+	if (!GetBufferViewData(document, accessor.bufferViewId, view_data, view_size))
+	{
+		return false;
+	}
+
+	auto&& view = document.bufferViews.Get(accessor.bufferViewId);
+	size_t element_size = (size_t)Accessor::GetComponentTypeSize(accessor.componentType) * Accessor::GetTypeCount(accessor.type);
+	size_t stride = (view.byteStride.HasValue() && view.byteStride.Get() > 0) ? view.byteStride.Get() : element_size;
+	if (accessor.count > 0)
+	{
+		size_t last = accessor.byteOffset + stride * (accessor.count - 1) + element_size;
+		if (element_size == 0 || last > view_size)
+		{
+			return false;
+		}
+	}
+
+	outView.pData = view_data + accessor.byteOffset;
+	outView.count = accessor.count;
+	outView.stride = stride;
+	outView.componentType = accessor.componentType;
+	outView.componentCount = Accessor::GetTypeCount(accessor.type);
+	outView.normalized = accessor.normalized;
+	return true;
+}
+
+bool ReadIndices(const AccessorView& view, uint32_t* pDst)
+{
+	switch (view.componentType)
+	{
+	case COMPONENT_UNSIGNED_BYTE:
+		if (view.stride != 1)
+		{
+			WidenStrided<uint8_t>(view, pDst);
+			return true;
+		}
+		{
+			size_t i = 0;
+#if GLTF_BUFFER_SSE2
+			const __m128i zero = _mm_setzero_si128();
+			for (; i + 16 <= view.count; i += 16)
+			{
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(view.pData + i));
+				__m128i lo = _mm_unpacklo_epi8(v, zero);
+				__m128i hi = _mm_unpackhi_epi8(v, zero);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i + 0), _mm_unpacklo_epi16(lo, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i + 4), _mm_unpackhi_epi16(lo, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i + 8), _mm_unpacklo_epi16(hi, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i + 12), _mm_unpackhi_epi16(hi, zero));
+			}
+#endif
+			for (; i < view.count; i++)
+			{
+				pDst[i] = view.pData[i];
+			}
+		}
+		return true;
+	case COMPONENT_UNSIGNED_SHORT:
+		if (view.stride != 2)
+		{
+			WidenStrided<uint16_t>(view, pDst);
+			return true;
+		}
+		{
+			size_t i = 0;
+#if GLTF_BUFFER_SSE2
+			const __m128i zero = _mm_setzero_si128();
+			for (; i + 8 <= view.count; i += 8)
+			{
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(view.pData + i * 2));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i + 0), _mm_unpacklo_epi16(v, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i + 4), _mm_unpackhi_epi16(v, zero));
+			}
+#endif
+			for (; i < view.count; i++)
+			{
+				uint16_t v;
+				memcpy(&v, view.pData + i * 2, sizeof(v));
+				pDst[i] = v;
+			}
+		}
+		return true;
+	case COMPONENT_UNSIGNED_INT:
+		if (view.stride != 4)
+		{
+			WidenStrided<uint32_t>(view, pDst);
+			return true;
+		}
+		memcpy(pDst, view.pData, view.count * sizeof(uint32_t));
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool ReadPositions(const AccessorView& view, DirectX::FXMMATRIX transform, DirectX::XMFLOAT3* pDst, size_t dstStride)
+{
+	if (view.componentType != COMPONENT_FLOAT || view.componentCount != 3)
+	{
+		return false;
+	}
+	DirectX::XMVector3TransformCoordStream(pDst, dstStride, reinterpret_cast<const DirectX::XMFLOAT3*>(view.pData), view.stride, view.count, transform);
+	return true;
+}
+
+bool ReadNormals(const AccessorView& view, DirectX::FXMMATRIX transform, DirectX::XMFLOAT3* pDst, size_t dstStride)
+{
+	if (view.componentType != COMPONENT_FLOAT || view.componentCount != 3)
+	{
+		return false;
+	}
+	DirectX::XMVector3TransformNormalStream(pDst, dstStride, reinterpret_cast<const DirectX::XMFLOAT3*>(view.pData), view.stride, view.count, transform);
+	uint8_t* dst = reinterpret_cast<uint8_t*>(pDst);
+	for (size_t i = 0; i < view.count; i++, dst += dstStride)
+	{
+		auto p = reinterpret_cast<DirectX::XMFLOAT3*>(dst);
+		DirectX::XMStoreFloat3(p, DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(p)));
+	}
+	return true;
+}
+
+bool ReadTangents(const AccessorView& view, DirectX::FXMMATRIX transform, DirectX::XMFLOAT4* pDst, size_t dstStride)
+{
+	if (view.componentType != COMPONENT_FLOAT || view.componentCount != 4)
+	{
+		return false;
+	}
+	DirectX::XMVector3TransformNormalStream(reinterpret_cast<DirectX::XMFLOAT3*>(pDst), dstStride, reinterpret_cast<const DirectX::XMFLOAT3*>(view.pData), view.stride, view.count, transform);
+	float sign = DirectX::XMVectorGetX(DirectX::XMMatrixDeterminant(transform)) < 0.0f ? -1.0f : 1.0f;
+	const uint8_t* src = view.pData;
+	uint8_t* dst = reinterpret_cast<uint8_t*>(pDst);
+	for (size_t i = 0; i < view.count; i++, src += view.stride, dst += dstStride)
+	{
+		auto p = reinterpret_cast<DirectX::XMFLOAT4*>(dst);
+		float w;
+		memcpy(&w, src + sizeof(float) * 3, sizeof(w));
+		DirectX::XMStoreFloat3(reinterpret_cast<DirectX::XMFLOAT3*>(p), DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(reinterpret_cast<DirectX::XMFLOAT3*>(p))));
+		p->w = (w < 0.0f ? -1.0f : 1.0f) * sign;
+	}
+	return true;
+}
+
+bool ReadTexcoords(const AccessorView& view, DirectX::XMFLOAT2* pDst, size_t dstStride)
+{
+	if (view.componentCount != 2)
+	{
+		return false;
+	}
+
+	const uint8_t* src = view.pData;
+	uint8_t* dst = reinterpret_cast<uint8_t*>(pDst);
+	switch (view.componentType)
+	{
+	case COMPONENT_FLOAT:
+		for (size_t i = 0; i < view.count; i++, src += view.stride, dst += dstStride)
+		{
+			memcpy(dst, src, sizeof(float) * 2);
+		}
+		return true;
+	case COMPONENT_UNSIGNED_BYTE:
+		if (!view.normalized)
+		{
+			return false;
+		}
+		for (size_t i = 0; i < view.count; i++, src += view.stride, dst += dstStride)
+		{
+			auto p = reinterpret_cast<DirectX::XMFLOAT2*>(dst);
+			p->x = (float)src[0] / 255.0f;
+			p->y = (float)src[1] / 255.0f;
+		}
+		return true;
+	case COMPONENT_UNSIGNED_SHORT:
+		if (!view.normalized)
+		{
+			return false;
+		}
+		for (size_t i = 0; i < view.count; i++, src += view.stride, dst += dstStride)
+		{
+			uint16_t v[2];
+			memcpy(v, src, sizeof(v));
+			auto p = reinterpret_cast<DirectX::XMFLOAT2*>(dst);
+			p->x = (float)v[0] / 65535.0f;
+			p->y = (float)v[1] / 65535.0f;
+		}
+		return true;
+	default:
+		return false;
+	}
+}
+
+
+//	EOF
@@ -0,0 +1,77 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "GLTFSDK/GLTF.h"
+#include <DirectXMath.h>
+
+#include "mapped_file.h"
+
+
+// typed, stride aware view of a glTF accessor. the data is not copied.
+struct AccessorView
+{
+	const uint8_t*	pData = nullptr;			// first element.
+	size_t			count = 0;
+	size_t			stride = 0;					// bytes between elements.
+	uint32_t		componentType = 0;			// Microsoft::glTF::ComponentType
+	uint32_t		componentCount = 0;
+	bool			normalized = false;
+};	// struct AccessorView
+
+// split a GLB file into the JSON chunk and the BIN chunk.
+// outBin is null if the file has no BIN chunk.
+bool ParseGLB(const uint8_t* pData, size_t size, std::string& outJson, const uint8_t*& outBin, size_t& outBinSize);
+
+// binary buffers of a glTF document.
+// the BIN chunk of GLB and external buffer files are mapped, and accessors are read from the mappings directly.
+class GLTFBufferSet
+{
+public:
+	GLTFBufferSet()
+	{}
+	~GLTFBufferSet()
+	{}
+
+	// inputPath is the directory of the glTF file. pGlbBin is the BIN chunk of GLB, or null.
+	// buffers which can not be mapped (data uris) are left for GLTFResourceReader.
+	void Setup(const Microsoft::glTF::Document& document, const std::string& inputPath, const uint8_t* pGlbBin, size_t glbBinSize);
+
+	// false if the accessor is not in the mapped buffers, or it is sparse.
+	bool GetAccessorView(const Microsoft::glTF::Document& document, const Microsoft::glTF::Accessor& accessor, AccessorView& outView) const;
+
+	// false if the buffer view is not in the mapped buffers.
+	bool GetBufferViewData(const Microsoft::glTF::Document& document, const std::string& bufferViewId, const uint8_t*& outData, size_t& outSize) const;
+
+private:
+	struct Buffer
+	{
+		const uint8_t*	pData;
+		size_t			size;
+	};	// struct Buffer
+
+	std::vector<Buffer>							buffers_;
+	std::vector<std::unique_ptr<MappedFile>>	files_;
+};	// class GLTFBufferSet
+
+// bulk conversions from accessor views. pDst is written with dstStride bytes between elements.
+// they return false if the component type is not supported.
+
+// uint8/uint16/uint32 indices to uint32.
+bool ReadIndices(const AccessorView& view, uint32_t* pDst);
+
+// float3 positions transformed by the matrix.
+bool ReadPositions(const AccessorView& view, DirectX::FXMMATRIX transform, DirectX::XMFLOAT3* pDst, size_t dstStride);
+
+// float3 normals transformed by the matrix and normalized.
+bool ReadNormals(const AccessorView& view, DirectX::FXMMATRIX transform, DirectX::XMFLOAT3* pDst, size_t dstStride);
+
+// float4 tangents. xyz are transformed by the matrix and normalized, and w is flipped if the matrix is mirrored.
+bool ReadTangents(const AccessorView& view, DirectX::FXMMATRIX transform, DirectX::XMFLOAT4* pDst, size_t dstStride);
+
+// float2, or normalized uint8/uint16 texcoords.
+bool ReadTexcoords(const AccessorView& view, DirectX::XMFLOAT2* pDst, size_t dstStride);
+
+//	EOF
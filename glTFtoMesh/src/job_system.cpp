@@ -0,0 +1,168 @@
+﻿#include "job_system.h"
+
+#include <algorithm>
+
+
+JobSystem::JobSystem(uint32_t threadCount)
+{
+	if (threadCount == 0)
+	{
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	threadCount_ = threadCount;
+
+	// the main thread works in Wait(), so create (threadCount - 1) workers.
+	workers_.reserve(threadCount_ - 1);
+	for (uint32_t i = 1; i < threadCount_; i++)
+	{
+		workers_.push_back(std::thread([this] { WorkerMain(); }));
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		isExit_ = true;
+	}
+	cv_.notify_all();
+	for (auto&& th : workers_)
+	{
+		th.join();
+	}
+}
+
+void JobSystem::Push(JobGroup& group, std::function<void()> func, bool isFront)
+{
+	group.pendingCount_++;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (isFront)
+		{
+			jobs_.push_front(Job{ std::move(func), &group });
+		}
+		else
+		{
+			jobs_.push_back(Job{ std::move(func), &group });
+		}
+	}
+	// waiting threads run only jobs of their own groups, so one notification could wake a thread which can not run this job.
+	cv_.notify_all();
+}
+
+bool JobSystem::RunOne(std::unique_lock<std::mutex>& lock, JobGroup* pGroup)
+{
+	auto it = jobs_.begin();
+	if (pGroup)
+	{
+		it = std::find_if(jobs_.begin(), jobs_.end(), [pGroup](const Job& job) { return job.pGroup == pGroup; });
+	}
+	if (it == jobs_.end())
+	{
+		return false;
+	}
+
+	Job job = std::move(*it);
+	jobs_.erase(it);
+	lock.unlock();
+
+	// an exception must not leave the group pending or escape a worker thread.
+	// it is passed to the thread waiting for the group.
+	std::exception_ptr exception;
+	try
+	{
+		job.func();
+	}
+	catch (...)
+	{
+		exception = std::current_exception();
+	}
+
+	lock.lock();
+	if (exception && !job.pGroup->exception_)
+	{
+		job.pGroup->exception_ = exception;
+	}
+	if (--job.pGroup->pendingCount_ == 0)
+	{
+		// wake up the waiting threads.
+		cv_.notify_all();
+	}
+	return true;
+}
+
+void JobSystem::Wait(JobGroup& group)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	auto HasGroupJob = [&]()
+	{
+		return std::any_of(jobs_.begin(), jobs_.end(), [&group](const Job& job) { return job.pGroup == &group; });
+	};
+	while (group.pendingCount_.load() > 0)
+	{
+		if (!RunOne(lock, &group))
+		{
+			// jobs of the group may be pushed by other jobs of the group.
+			cv_.wait(lock, [&] { return group.pendingCount_.load() == 0 || HasGroupJob(); });
+		}
+	}
+	RethrowException(lock, group);
+}
+
+void JobSystem::RethrowException(std::unique_lock<std::mutex>& lock, JobGroup& group)
+{
+	if (!group.exception_)
+	{
+		return;
+	}
+	std::exception_ptr exception = group.exception_;
+	group.exception_ = nullptr;
+	lock.unlock();
+	std::rethrow_exception(exception);
+}
+
+void JobSystem::ParallelFor(size_t count, const std::function<void(size_t)>& func)
+{
+	if (threadCount_ <= 1 || count <= 1)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			func(i);
+		}
+		return;
+	}
+
+	JobGroup group;
+	for (size_t i = 0; i < count; i++)
+	{
+		Push(group, [&func, i] { func(i); }, true);
+	}
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (group.pendingCount_.load() > 0)
+	{
+		if (!RunOne(lock, &group))
+		{
+			// the rest is running on other threads.
+			cv_.wait(lock, [&] { return group.pendingCount_.load() == 0; });
+		}
+	}
+	RethrowException(lock, group);
+}
+
+void JobSystem::WorkerMain()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (true)
+	{
+		cv_.wait(lock, [this] { return isExit_ || !jobs_.empty(); });
+		if (isExit_)
+		{
+			break;
+		}
+		RunOne(lock);
+	}
+}
+
+
+//	EOF
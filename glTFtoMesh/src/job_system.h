@@ -0,0 +1,182 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <exception>
+
+
+class JobGroup
+{
+	friend class JobSystem;
+
+public:
+	JobGroup()
+	{}
+	~JobGroup()
+	{}
+
+	bool IsDone() const
+	{
+		return pendingCount_.load() == 0;
+	}
+
+private:
+	std::atomic<uint32_t>	pendingCount_{ 0 };
+	std::exception_ptr		exception_;			// the first exception thrown by the jobs. guarded by JobSystem::mutex_.
+};	// class JobGroup
+
+class JobSystem
+{
+	struct Job
+	{
+		std::function<void()>	func;
+		JobGroup*				pGroup;
+	};	// struct Job
+
+public:
+	// threadCount includes the calling thread. 0 means hardware concurrency.
+	JobSystem(uint32_t threadCount);
+	~JobSystem();
+
+	uint32_t GetThreadCount() const
+	{
+		return threadCount_;
+	}
+
+	// if isFront is true, the job is executed before other pending jobs.
+	void Push(JobGroup& group, std::function<void()> func, bool isFront = false);
+
+	// the calling thread executes pending jobs of the group while waiting.
+	// so it is safe to wait in a job, and jobs of other groups (e.g. other files in batch mode) are not nested on its stack.
+	// if a job of the group threw, the exception is rethrown here after all jobs of the group are finished.
+	void Wait(JobGroup& group);
+
+	// execute func(0) ... func(count - 1) and wait for all.
+	// these jobs are pushed to the front of the queue, so they are not starved by long jobs.
+	// the calling thread executes only these jobs while waiting, so a job which holds a MemoryBudget
+	// does not pick up another job which blocks on the same budget.
+	// an exception thrown by func is rethrown on the calling thread.
+	void ParallelFor(size_t count, const std::function<void(size_t)>& func);
+
+private:
+	// if pGroup is not null, only jobs of the group are executed.
+	bool RunOne(std::unique_lock<std::mutex>& lock, JobGroup* pGroup = nullptr);
+	// rethrow the exception of the finished group.
+	void RethrowException(std::unique_lock<std::mutex>& lock, JobGroup& group);
+	void WorkerMain();
+
+private:
+	uint32_t					threadCount_;
+	std::vector<std::thread>	workers_;
+	std::mutex					mutex_;
+	std::condition_variable		cv_;
+	std::deque<Job>				jobs_;
+	bool						isExit_ = false;
+};	// class JobSystem
+
+// wait for the group when the scope is left, also by an exception.
+// jobs which refer to locals of the scope must not outlive them.
+// exceptions of the jobs are not rethrown here. call JobSystem::Wait() to receive them on the normal path.
+class ScopedJobWait
+{
+public:
+	ScopedJobWait(JobSystem& jobSystem, JobGroup& group)
+		: jobSystem_(jobSystem), group_(group)
+	{}
+	~ScopedJobWait()
+	{
+		try
+		{
+			jobSystem_.Wait(group_);
+		}
+		catch (...)
+		{
+			// the scope is already left by an error.
+		}
+	}
+
+	ScopedJobWait(const ScopedJobWait&) = delete;
+	ScopedJobWait& operator=(const ScopedJobWait&) = delete;
+
+private:
+	JobSystem&	jobSystem_;
+	JobGroup&	group_;
+};	// class ScopedJobWait
+
+// limit the total size of memory used by concurrent jobs.
+class MemoryBudget
+{
+public:
+	MemoryBudget(size_t budgetSize)
+		: budgetSize_(budgetSize)
+	{}
+	~MemoryBudget()
+	{}
+
+	// block until the requested size is available.
+	// a request larger than the budget is accepted when nothing else is used.
+	void Acquire(size_t size)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		cv_.wait(lock, [&] { return usedSize_ == 0 || usedSize_ + size <= budgetSize_; });
+		usedSize_ += size;
+	}
+	void Release(size_t size)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			usedSize_ -= size;
+		}
+		cv_.notify_all();
+	}
+
+private:
+	size_t						budgetSize_;
+	size_t						usedSize_ = 0;
+	std::mutex					mutex_;
+	std::condition_variable		cv_;
+};	// class MemoryBudget
+
+// acquire the size from the budget, and release it when the scope is left, also by an exception.
+class MemoryBudgetLease
+{
+public:
+	MemoryBudgetLease(MemoryBudget& budget, size_t size)
+		: budget_(budget), size_(size)
+	{
+		budget_.Acquire(size_);
+	}
+	~MemoryBudgetLease()
+	{
+		budget_.Release(size_);
+	}
+
+	MemoryBudgetLease(const MemoryBudgetLease&) = delete;
+	MemoryBudgetLease& operator=(const MemoryBudgetLease&) = delete;
+
+private:
+	MemoryBudget&	budget_;
+	size_t			size_;
+};	// class MemoryBudgetLease
+
+// execute serially if pJobSystem is null.
+inline void ParallelFor(JobSystem* pJobSystem, size_t count, const std::function<void(size_t)>& func)
+{
+	if (!pJobSystem)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			func(i);
+		}
+		return;
+	}
+	pJobSystem->ParallelFor(count, func);
+}
+
+//	EOF
@@ -1,122 +1,216 @@
-﻿#include <algorithm>
-#include "GLTFSDK/GLTF.h"
-#include "GLTFSDK/GLBResourceReader.h"
-#include "GLTFSDK/Deserialize.h"
-#include "meshoptimizer.h"
-#include "mikktspace.h"
-
-#include <cereal/cereal.hpp>
-#include <cereal/archives/json.hpp>
-#include <cereal/archives/binary.hpp>
-#include <cereal/types/vector.hpp>
-
-#include <DirectXTex.h>
-
-#include <string>
+﻿#include <string>
+#include <vector>
 #include <fstream>
-#include <sstream>
-
-#include "mesh_work.h"
-
-#define STB_IMAGE_IMPLEMENTATION
-#include "../../External/stb/stb_image.h"
-
-#define private public
-#include "sl12/resource_mesh.h"
-#undef private
-
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+
+#include "converter.h"
+#include "job_system.h"
+#include "build_cache.h"
+#include "mesh_codec.h"
+#include "server.h"
+#include "watch.h"
+
+#if defined(_WIN32)
 #define NOMINMAX
 #include <windows.h>
-#include <imagehlp.h>
-#pragma comment(lib, "imagehlp.lib")
+#endif
 
 
-using namespace Microsoft::glTF;
-
 namespace
 {
-	std::string ConvYenToSlash(const std::string& path)
+	struct BatchJob
+	{
+		ToolOptions		options;
+		uintmax_t		inputSize = 0;
+		ConvertResult	result;
+	};	// struct BatchJob
+
+	// invalid manifest lines are reported and skipped. outSkippedCount is the number of them.
+	bool CollectBatchJobs(const std::string& batchPath, const ToolOptions& baseOptions, std::vector<BatchJob>& outJobs, size_t& outSkippedCount)
 	{
-		std::string ret;
-		ret.reserve(path.length() + 1);
-		for (auto&& it : path)
+		outSkippedCount = 0;
+		std::error_code ec;
+		if (std::filesystem::is_directory(batchPath, ec))
 		{
-			ret += (it == '\\') ? '/' : it;
+			// all .gltf/.glb files in the directory tree. output tree has the same layout.
+			if (baseOptions.outputFilePath.empty())
+			{
+				fprintf(stderr, "invalid output directory.\n");
+				return false;
+			}
+			std::filesystem::path root(batchPath);
+			for (auto&& entry : std::filesystem::recursive_directory_iterator(root, ec))
+			{
+				if (!entry.is_regular_file())
+				{
+					continue;
+				}
+				auto ext = entry.path().extension().string();
+				std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return (char)tolower(c); });
+				if (ext != ".gltf" && ext != ".glb")
+				{
+					continue;
+				}
+
+				auto relative = std::filesystem::relative(entry.path(), root, ec);
+				relative.replace_extension(".rmesh");
+				std::vector<std::string> args = {
+					"-i", entry.path().generic_string(),
+					"-o", (std::filesystem::path(baseOptions.outputFilePath) / relative).generic_string(),
+				};
+				if (!baseOptions.outputTexPath.empty())
+				{
+					args.push_back("-to");
+					args.push_back((std::filesystem::path(baseOptions.outputTexPath) / relative.parent_path()).generic_string());
+				}
+
+				BatchJob job;
+				job.options = baseOptions;
+				job.options.outputTexPath.clear();
+				if (!ParseToolOptions(args, job.options, nullptr))
+				{
+					return false;
+				}
+				outJobs.push_back(job);
+			}
 		}
-		return ret;
-	}
+		else
+		{
+			// manifest file.
+			std::ifstream ifs(batchPath);
+			if (!ifs)
+			{
+				fprintf(stderr, "failed to open manifest. (%s)\n", batchPath.c_str());
+				return false;
+			}
+			std::string line;
+			int line_number = 0;
+			while (std::getline(ifs, line))
+			{
+				line_number++;
+				auto args = SplitArguments(line);
+				if (args.empty() || args[0][0] == '#')
+				{
+					continue;
+				}
 
-	std::string ConvSlashToYen(const std::string& path)
-	{
-		std::string ret;
-		ret.reserve(path.length() + 1);
-		for (auto&& it : path)
+				BatchJob job;
+				job.options = baseOptions;
+				bool is_valid = false;
+				try
+				{
+					// numeric options throw on invalid values. a bad line must not stop the batch.
+					is_valid = ParseToolOptions(args, job.options, nullptr);
+				}
+				catch (const std::exception&)
+				{
+					is_valid = false;
+				}
+				if (!is_valid)
+				{
+					fprintf(stderr, "invalid manifest line. (%s: %d)\n", batchPath.c_str(), line_number);
+					outSkippedCount++;
+					continue;
+				}
+				outJobs.push_back(job);
+			}
+		}
+
+		for (auto&& job : outJobs)
 		{
-			ret += (it == '/') ? '\\' : it;
+			if (!FinalizeToolOptions(job.options))
+			{
+				return false;
+			}
+			job.inputSize = std::filesystem::file_size(job.options.inputPath + job.options.inputFileName, ec);
 		}
-		return ret;
+		return true;
 	}
 
-	std::string GetExtent(const std::string& filename)
+	int RunBatch(const ProcessOptions& processOptions, const ToolOptions& baseOptions, ConvertContext& context, std::vector<ConvertResult>& outResults)
 	{
-		std::string ret;
-		auto pos = filename.rfind('.');
-		if (pos != std::string::npos)
+		std::vector<BatchJob> jobs;
+		size_t skipped_count = 0;
+		if (!CollectBatchJobs(processOptions.batchPath, baseOptions, jobs, skipped_count))
 		{
-			ret = filename.data() + pos;
+			return -1;
+		}
+		if (jobs.empty())
+		{
+			fprintf(stderr, "no input files. (%s)\n", processOptions.batchPath.c_str());
+			return -1;
 		}
-		return ret;
-	}
 
-	std::string GetFileName(const std::string& filename)
-	{
-		std::string ret = filename;
-		auto pos = filename.rfind('.');
-		if (pos != std::string::npos)
+		// start larger files first, so that small files fill the gaps at the end.
+		std::vector<size_t> order(jobs.size());
+		for (size_t i = 0; i < order.size(); i++)
 		{
-			ret.erase(pos);
+			order[i] = i;
 		}
-		return ret;
-	}
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return jobs[a].inputSize > jobs[b].inputSize; });
 
-	std::string GetPath(const std::string& filename)
-	{
-		std::string ret = "./";
-		auto pos = filename.rfind('/');
-		if (pos != std::string::npos)
+		auto start_time = std::chrono::steady_clock::now();
+		JobGroup group;
+		for (auto index : order)
 		{
-			ret = filename.substr(0, pos + 1);
+			BatchJob* pJob = &jobs[index];
+			context.pJobSystem->Push(group, [pJob, &context]
+			{
+				// a broken input file throws from the glTF parser. it fails only the file, not the batch.
+				bool succeeded = false;
+				try
+				{
+					succeeded = ConvertFile(pJob->options, context, &pJob->result);
+				}
+				catch (const std::exception& e)
+				{
+					fprintf(stderr, "failed to read glTF. (%s)\n", e.what());
+					pJob->result.isSucceeded = false;
+				}
+				if (!succeeded)
+				{
+					fprintf(stderr, "failed to convert. (%s)\n", pJob->options.inputFileName.c_str());
+				}
+			});
+		}
+		context.pJobSystem->Wait(group);
+		double total_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+		// summary.
+		size_t succeeded_count = 0;
+		fprintf(stdout, "\nbatch summary:\n");
+		fprintf(stdout, "  result  time(sec)  submesh  texture  output(KB)  file\n");
+		for (auto&& job : jobs)
+		{
+			auto&& r = job.result;
+			fprintf(stdout, "  %-6s  %9.2f  %7zu  %7zu  %10zu  %s%s\n",
+				r.isSucceeded ? (r.isCacheHit ? "CACHED" : "OK") : "FAILED",
+				r.elapsedSeconds,
+				r.submeshCount,
+				r.textureCount,
+				r.outputSize / 1024,
+				job.options.inputPath.c_str(), job.options.inputFileName.c_str());
+			succeeded_count += r.isSucceeded ? 1 : 0;
+		}
+		fprintf(stdout, "total: %zu files, %zu succeeded, %zu failed. (%.2f sec)\n",
+			jobs.size(), succeeded_count, jobs.size() - succeeded_count, total_seconds);
+		if (skipped_count > 0)
+		{
+			fprintf(stdout, "skipped %zu invalid manifest lines.\n", skipped_count);
 		}
-		return ret;
-	}
 
-	std::string GetTextureKind(const std::string& filename)
-	{
-		std::string name = GetFileName(filename);
-		size_t pos = name.rfind(".");
-		std::string ret;
-		if (pos != std::string::npos)
+		for (auto&& job : jobs)
 		{
-			ret = name.data() + pos + 1;
+			outResults.push_back(job.result);
 		}
-		return ret;
+
+		return (succeeded_count == jobs.size() && skipped_count == 0) ? 0 : -1;
 	}
 }
 
-struct ToolOptions
-{
-	std::string		inputFileName = "";
-	std::string		inputPath = "";
-	std::string		outputFilePath = "";
-	std::string		outputTexPath = "";
-
-	bool			textureDDS = true;
-	bool			compressBC7 = false;
-	bool			mergeFlag = true;
-	bool			optimizeFlag = true;
-	bool			meshletFlag = false;
-};	// struct ToolOptions
-
 void DisplayHelp()
 {
 	fprintf(stdout, "glTFtoMesh : Convert glTF format to sl12 mesh format.\n");
@@ -126,123 +220,63 @@ void DisplayHelp()
 	fprintf(stdout, "    -to <directory> : output texture file directory.\n");
 	fprintf(stdout, "    -dds <0/1>      : change texture format png to dds, or not. (default: 1)\n");
 	fprintf(stdout, "    -bc7 <0/1>      : if 1, use bc7 compression for a part of dds. if 0, use bc3. (default: 0)\n");
+	fprintf(stdout, "    -texenc <enc>   : dds encoder. dxtex (DirectXTex, windows only) or portable. (default: dxtex on windows, portable elsewhere)\n");
+	fprintf(stdout, "    -texquality <q> : quality of the portable encoder. fast or final. (default: final)\n");
+	fprintf(stdout, "    -texch <0/1>    : BC5 for normal maps (z is reconstructed at runtime) and BC4 for grayscale masks. (default: 0)\n");
+	fprintf(stdout, "    -orm <0/1>      : pack glTF occlusion textures into the red channel of ORM textures. (default: 0)\n");
+	fprintf(stdout, "    -texdedup <0/1> : write textures which have the same image bytes once, and share them between materials. (default: 1)\n");
+	fprintf(stdout, "    -mipfilter <f>  : mip filter. box or kaiser. (default: kaiser)\n");
+	fprintf(stdout, "    -mipgamma <0/1> : filter mips of sRGB textures in linear space. (default: 1)\n");
+	fprintf(stdout, "    -mipcoverage <0/1>: keep the alpha test coverage in mips of alpha mask materials. (default: 1)\n");
 	fprintf(stdout, "    -merge <0/1>    : merge submeshes have same material. (default: 1)\n");
 	fprintf(stdout, "    -opt <0/1>      : optimize mesh. (default: 1)\n");
+	fprintf(stdout, "    -optpass <list> : comma separated optimization passes. vcache, overdraw, vfetch, meshlet or none. (default: vcache,vfetch)\n");
+	fprintf(stdout, "    -overdraw <f>   : ACMR increase allowed for the overdraw pass. (default: 1.05)\n");
+	fprintf(stdout, "    -optreport <0/1>: print ACMR, ATVR, overdraw and overfetch before and after each pass. not available if geometry is restored from -cache. (default: 0)\n");
 	fprintf(stdout, "    -let <0/1>      : create meshlets. (default: 0)\n");
+	fprintf(stdout, "    -letvtx <n>     : max vertices of a meshlet. up to 256. (default: 64)\n");
+	fprintf(stdout, "    -lettri <n>     : max triangles of a meshlet. up to 256, a multiple of 4. (default: 124)\n");
+	fprintf(stdout, "    -letmode <mode> : meshlet build mode. scan, cone or flex. (default: scan)\n");
+	fprintf(stdout, "    -letcone <f>    : cone weight of cone mode. (default: 0.25)\n");
+	fprintf(stdout, "    -lettarget <t>  : meshlet limits and mode for the target. default, nvidia, amd or culling.\n");
+	fprintf(stdout, "    -letauto <0/1>  : score candidate limits and modes, and use the best one. (default: 0)\n");
+	fprintf(stdout, "    -letcompact <0/1>: uint8 meshlet triangles and uint16 meshlet vertex indices if possible. (default: 0)\n");
+	fprintf(stdout, "    -qvtx <0/1>     : quantize vertex streams. 16bit positions in submesh bounds, octahedral normals/tangents. (default: 0)\n");
+	fprintf(stdout, "    -quv <0/1>      : if 1, quantized texcoords are unorm16 in submesh range. if 0, half float. (default: 0)\n");
+	fprintf(stdout, "    -idx16 <0/1>    : 16bit indices for submeshes with 65536 vertices or less. 0 for runtimes which read only 32bit indices. (default: 1)\n");
+	fprintf(stdout, "    -idxsplit <0/1> : split submeshes with more than 65536 vertices, so that they can use 16bit indices. (default: 0)\n");
+	fprintf(stdout, "    -comp <0/1>     : compress vertex/index/meshlet buffers with meshoptimizer codecs. (default: 0)\n");
+	fprintf(stdout, "    -container <0/1>: write memory mappable container instead of cereal archive. (default: 0)\n");
+	fprintf(stdout, "    -lod <count>    : LOD levels including the original mesh. (default: 1)\n");
+	fprintf(stdout, "    -lodratio <f>   : triangle ratio of each LOD to the previous level. (default: 0.5)\n");
+	fprintf(stdout, "    -loderr <f>     : max simplification error relative to the mesh extent. (default: 0.05)\n");
+	fprintf(stdout, "    -dag <0/1>      : build hierarchical cluster DAG for continuous LOD. (default: 0)\n");
+	fprintf(stdout, "    -inst <0/1>     : write each mesh once with an instance table, instead of baking node transforms. (default: 0)\n");
+	fprintf(stdout, "    -j <count>      : worker thread count. 0 means all hardware threads. (default: 0)\n");
+	fprintf(stdout, "    -texmem <MB>    : memory budget for converting textures in parallel. (default: 4096)\n");
+	fprintf(stdout, "    -batch <path>   : convert multiple files in one process.\n");
+	fprintf(stdout, "                      if <path> is a directory, all .gltf/.glb files in it are converted and -o is an output directory.\n");
+	fprintf(stdout, "                      otherwise <path> is a manifest file which has options for one file per line.\n");
+	fprintf(stdout, "                      options on the command line are used as defaults of each line.\n");
+	fprintf(stdout, "    -cache <dir>    : build cache directory. unchanged files, geometries and textures are restored from it.\n");
+	fprintf(stdout, "    -stats <file>   : write elapsed time and allocated memory of each stage to a json file.\n");
+	fprintf(stdout, "    -serve <path>   : run as a conversion server. <path> is stdin, or a unix socket path.\n");
+	fprintf(stdout, "                      each request line has options in the manifest format, and \"quit\" stops the server.\n");
+	fprintf(stdout, "                      responses are \"ok <sec> <submesh> <texture> <bytes> <cached|converted>\" or \"error <message>\".\n");
+	fprintf(stdout, "    -cachemem <MB>  : memory cache size of the build cache in server and watch mode. (default: 1024)\n");
+	fprintf(stdout, "    -watch <0/1>    : convert again whenever the input file or its external buffers are changed. (default: 0)\n");
+	fprintf(stdout, "                      unchanged geometry and textures are restored from the build cache.\n");
 	fprintf(stdout, "\n");
 	fprintf(stdout, "example:\n");
 	fprintf(stdout, "    glTFtoMesh.exe -i \"D:/input/sample.glb\" -o \"D:/output/sample.rmesh\" -to \"D:/output/textures/\" -let 1\n");
-}
-
-bool ConvertToDDS(TextureWork* pTex, const std::string& outputFilePath, bool isSrgb, bool isNormal, bool isBC7)
-{
-	// read png image.
-	int width, height, bpp;
-	auto pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(pTex->GetBinary().data()), static_cast<int>(pTex->GetBinary().size()), &width, &height, &bpp, 0);
-	if (!pixels || (bpp != 3 && bpp != 4))
-	{
-		return false;
-	}
-
-	// convert to DirectX image.
-	std::unique_ptr<DirectX::ScratchImage> image(new DirectX::ScratchImage());
-	auto hr = image->Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, width, height, 1, 1);
-	bool has_alpha = false;
-	if (FAILED(hr))
-	{
-		return false;
-	}
-	if (bpp == 3)
-	{
-		auto src = pixels;
-		auto dst = image->GetPixels();
-		for (int y = 0; y < height; y++)
-		{
-			for (int x = 0; x < height; x++)
-			{
-				dst[0] = src[0];
-				dst[1] = src[1];
-				dst[2] = src[2];
-				dst[3] = 0xff;
-				src += 3;
-				dst += 4;
-			}
-		}
-	}
-	else
-	{
-		auto src = pixels;
-		auto dst = image->GetPixels();
-		for (int y = 0; y < height; y++)
-		{
-			for (int x = 0; x < height; x++)
-			{
-				has_alpha = has_alpha || (src[3] < 0xff);
-				dst[0] = src[0];
-				dst[1] = src[1];
-				dst[2] = src[2];
-				dst[3] = src[3];
-				src += 4;
-				dst += 4;
-			}
-		}
-	}
-	stbi_image_free(pixels);
-
-	// generate full mips.
-	std::unique_ptr<DirectX::ScratchImage> mipped_image(new DirectX::ScratchImage());
-	hr = DirectX::GenerateMipMaps(
-		*image->GetImage(0, 0, 0),
-		DirectX::TEX_FILTER_CUBIC | DirectX::TEX_FILTER_FORCE_NON_WIC,
-		0,
-		*mipped_image);
-	image.swap(mipped_image);
-
-	// compress.
-	DXGI_FORMAT compress_format = (isSrgb) ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
-	if (has_alpha || isNormal)
-	{
-		compress_format = (isBC7)
-			? ((isSrgb) ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM)
-			: ((isSrgb) ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM);
-	}
-	DirectX::TEX_COMPRESS_FLAGS comp_flag = DirectX::TEX_COMPRESS_PARALLEL;
-	if (isSrgb)
-	{
-		comp_flag |= DirectX::TEX_COMPRESS_SRGB_OUT;
-	}
-	std::unique_ptr<DirectX::ScratchImage> comp_image(new DirectX::ScratchImage());
-	hr = DirectX::Compress(
-		image->GetImages(),
-		image->GetImageCount(),
-		image->GetMetadata(),
-		compress_format,
-		comp_flag,
-		DirectX::TEX_THRESHOLD_DEFAULT,
-		*comp_image);
-	if (FAILED(hr))
-	{
-		return false;
-	}
-	image.swap(comp_image);
-
-	size_t len;
-	mbstowcs_s(&len, nullptr, 0, outputFilePath.c_str(), 0);
-	std::wstring of;
-	of.resize(len + 1);
-	mbstowcs_s(&len, (wchar_t*)of.data(), of.length(), outputFilePath.c_str(), of.length());
-	hr = DirectX::SaveToDDSFile(
-		image->GetImages(),
-		image->GetImageCount(),
-		image->GetMetadata(),
-		DirectX::DDS_FLAGS_NONE,
-		of.c_str());
-	if (FAILED(hr))
-	{
-		return false;
-	}
-
-	return true;
+	fprintf(stdout, "    glTFtoMesh.exe -batch \"D:/input/\" -o \"D:/output/\" -let 1\n");
+	fprintf(stdout, "    glTFtoMesh.exe -serve stdin -cache \"D:/cache/\" -let 1\n");
+	fprintf(stdout, "    glTFtoMesh.exe -i \"D:/input/sample.glb\" -o \"D:/output/sample.rmesh\" -watch 1\n");
+	fprintf(stdout, "\n");
+	fprintf(stdout, "manifest example:\n");
+	fprintf(stdout, "    # comment line\n");
+	fprintf(stdout, "    -i \"D:/input/a.glb\" -o \"D:/output/a.rmesh\" -bc7 1\n");
+	fprintf(stdout, "    -i \"D:/input/b.glb\" -o \"D:/output/b.rmesh\" -let 0\n");
 }
 
 int main(int argv, char* argc[])
@@ -256,352 +290,94 @@ int main(int argv, char* argc[])
 
 	// get options.
 	ToolOptions options;
-	for (int i = 1; i < argv; i++)
-	{
-		std::string op = argc[i];
-		if (op[0] == '-' || op[0] == '/')
-		{
-			if (op == "-i" || op == "/i")
-			{
-				if (i == argv - 1)
-				{
-					fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
-					return -1;
-				}
-				options.inputPath = ConvYenToSlash(argc[++i]);
-				auto slash = options.inputPath.rfind('/');
-				if (slash == std::string::npos)
-				{
-					options.inputFileName = options.inputPath;
-					options.inputPath = "./";
-				}
-				else
-				{
-					options.inputFileName = &options.inputPath.data()[slash + 1];
-					options.inputPath = options.inputPath.erase(slash + 1, std::string::npos);
-				}
-			}
-			else if (op == "-o" || op == "/o")
-			{
-				if (i == argv - 1)
-				{
-					fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
-					return -1;
-				}
-				options.outputFilePath = argc[++i];
-			}
-			else if (op == "-to" || op == "/to")
-			{
-				if (i == argv - 1)
-				{
-					fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
-					return -1;
-				}
-				options.outputTexPath = argc[++i];
-			}
-			else if (op == "-dds" || op == "/dds")
-			{
-				if (i == argv - 1)
-				{
-					fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
-					return -1;
-				}
-				options.textureDDS = std::stoi(argc[++i]);
-			}
-			else if (op == "-bc7" || op == "/bc7")
-			{
-				if (i == argv - 1)
-				{
-					fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
-					return -1;
-				}
-				options.compressBC7 = std::stoi(argc[++i]);
-			}
-			else if (op == "-merge" || op == "/merge")
-			{
-				if (i == argv - 1)
-				{
-					fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
-					return -1;
-				}
-				options.mergeFlag = std::stoi(argc[++i]);
-			}
-			else if (op == "-opt" || op == "/opt")
-			{
-				if (i == argv - 1)
-				{
-					fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
-					return -1;
-				}
-				options.optimizeFlag = std::stoi(argc[++i]);
-			}
-			else if (op == "-let" || op == "/let")
-			{
-				if (i == argv - 1)
-				{
-					fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
-					return -1;
-				}
-				options.meshletFlag = std::stoi(argc[++i]);
-			}
-			else
-			{
-				fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
-				return -1;
-			}
-		}
-		else
-		{
-			fprintf(stderr, "invalid argument. (%s)\n", op.c_str());
-			return -1;
-		}
-	}
-
-	if (options.inputFileName.empty() || options.inputPath.empty())
+	ProcessOptions process_options;
+	std::vector<std::string> args(argc + 1, argc + argv);
+	if (!ParseToolOptions(args, options, &process_options))
 	{
-		fprintf(stderr, "invalid input file name.\n");
 		return -1;
 	}
-	if (options.outputFilePath.empty())
-	{
-		fprintf(stderr, "invalid output file name.\n");
-		return -1;
-	}
-	if (options.outputTexPath.empty())
-	{
-		options.outputTexPath = GetPath(ConvYenToSlash(options.outputFilePath));
-	}
-	else
-	{
-		options.outputTexPath = ConvYenToSlash(options.outputTexPath);
-		if (options.outputTexPath[options.outputTexPath.length() - 1] != '/')
-		{
-			options.outputTexPath += '/';
-		}
-	}
 
-	{
-		auto outDir = GetPath(ConvYenToSlash(options.outputFilePath));
-		MakeSureDirectoryPathExists(ConvSlashToYen(outDir).c_str());
-		MakeSureDirectoryPathExists(ConvSlashToYen(options.outputTexPath).c_str());
-	}
+#if defined(_WIN32)
+	// COM is initialized once for the process.
+	HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+#endif
 
-	fprintf(stdout, "read glTF mesh. (%s)\n", options.inputFileName.c_str());
-	auto mesh_work = std::make_unique<MeshWork>();
-	if (!mesh_work->ReadGLTFMesh(options.inputPath, options.inputFileName))
+	if (!process_options.statsPath.empty())
 	{
-		fprintf(stderr, "failed to read glTF mesh. (%s)\n", options.inputFileName.c_str());
-		return -1;
+		EnableAllocationTracking();
 	}
+	InitializeMeshCodec();
 
-	if (options.mergeFlag)
+	JobSystem job_system(process_options.threadCount);
+	MemoryBudget texture_budget((size_t)process_options.textureMemoryMB * 1024 * 1024);
+	std::unique_ptr<BuildCache> cache;
+	if (!process_options.servePath.empty() || process_options.watchFlag)
 	{
-		fprintf(stdout, "merge submeshes.\n");
-		if (mesh_work->MergeSubmesh() == 0)
-		{
-			fprintf(stderr, "failed to merge submeshes.\n");
-			return -1;
-		}
+		// server and watch mode keep recently used cache objects in memory. disk cache is optional.
+		cache = std::make_unique<BuildCache>(process_options.cachePath, (size_t)process_options.cacheMemoryMB * 1024 * 1024);
 	}
-
-	if (options.optimizeFlag)
+	else if (!process_options.cachePath.empty())
 	{
-		fprintf(stdout, "optimize mesh.\n");
-		mesh_work->OptimizeSubmesh();
+		cache = std::make_unique<BuildCache>(process_options.cachePath);
 	}
 
-	if (options.meshletFlag)
+	ConvertContext context;
+	context.pJobSystem = &job_system;
+	context.pTextureBudget = &texture_budget;
+	context.pCache = cache.get();
+	context.isStatsEnabled = !process_options.statsPath.empty();
+
+	int ret = 0;
+	std::vector<ConvertResult> results;
+	if (!process_options.servePath.empty())
 	{
-		fprintf(stdout, "build meshlets.\n");
-		mesh_work->BuildMeshlets();
+		ret = RunServer(process_options.servePath, options, context);
 	}
-
-	// output textures.
-	if (options.textureDDS)
+	else if (!process_options.batchPath.empty())
 	{
-		if (!mesh_work->GetTextures().empty())
-		{
-			fprintf(stdout, "output DDS textures.\n");
-			HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
-
-			for (auto&& tex : mesh_work->GetTextures())
-			{
-				std::string name = GetFileName(tex->GetName()) + ".dds";
-				std::string kind = GetTextureKind(tex->GetName());
-				fprintf(stdout, "writing %s texture... (kind: %s)\n", name.c_str(), kind.c_str());
-				if (!ConvertToDDS(tex.get(), options.outputTexPath + name, kind == "bc", kind == "n", options.compressBC7))
-				{
-					fprintf(stderr, "failed to write %s texture...\n", name.c_str());
-					return -1;
-				}
-			}
-
-			CoUninitialize();
-			fprintf(stdout, "complete to output DDS textures.\n");
-		}
+		ret = RunBatch(process_options, options, context, results);
 	}
 	else
 	{
-		fprintf(stdout, "output PNG textures.\n");
-		for (auto&& tex : mesh_work->GetTextures())
+		if (!FinalizeToolOptions(options))
 		{
-			fprintf(stdout, "writing %s texture...\n", tex->GetName().c_str());
-			std::fstream ofs(options.outputTexPath + tex->GetName(), std::ios::out | std::ios::binary);
-			ofs.write((const char*)tex->GetBinary().data(), tex->GetBinary().size());
+			ret = -1;
 		}
-		fprintf(stdout, "complete to output PNG textures.\n");
-	}
-
-	auto PNGtoDDS = [](const std::string& filename)
-	{
-		std::string ret = filename;
-		auto pos = ret.rfind(".png");
-		if (pos != std::string::npos)
+		else if (process_options.watchFlag)
 		{
-			ret.erase(pos);
-			ret += ".dds";
+			ret = RunWatch(options, context);
 		}
-		return ret;
-	};
-
-	// output binary.
-	fprintf(stdout, "output rmesh binary.\n");
-	auto out_resource = std::make_unique<sl12::ResourceMesh>();
-	out_resource->boundingSphere_.centerX = mesh_work->GetBoundingSphere().center.x;
-	out_resource->boundingSphere_.centerY = mesh_work->GetBoundingSphere().center.y;
-	out_resource->boundingSphere_.centerZ = mesh_work->GetBoundingSphere().center.z;
-	out_resource->boundingSphere_.radius = mesh_work->GetBoundingSphere().radius;
-	out_resource->boundingBox_.minX = mesh_work->GetBoundingBox().aabbMin.x;
-	out_resource->boundingBox_.minY = mesh_work->GetBoundingBox().aabbMin.y;
-	out_resource->boundingBox_.minZ = mesh_work->GetBoundingBox().aabbMin.z;
-	out_resource->boundingBox_.maxX = mesh_work->GetBoundingBox().aabbMax.x;
-	out_resource->boundingBox_.maxY = mesh_work->GetBoundingBox().aabbMax.y;
-	out_resource->boundingBox_.maxZ = mesh_work->GetBoundingBox().aabbMax.z;
-	for (auto&& mat : mesh_work->GetMaterials())
-	{
-		auto bcName = mat->GetTextrues()[MaterialWork::TextureKind::BaseColor];
-		auto nName = mat->GetTextrues()[MaterialWork::TextureKind::Normal];
-		auto ormName = mat->GetTextrues()[MaterialWork::TextureKind::ORM];
-		if (options.textureDDS)
+		else
 		{
-			bcName = PNGtoDDS(bcName);
-			nName = PNGtoDDS(nName);
-			ormName = PNGtoDDS(ormName);
+			results.resize(1);
+			ret = ConvertFile(options, context, &results[0]) ? 0 : -1;
 		}
-
-		sl12::ResourceMeshMaterial out_mat;
-		out_mat.name_ = mat->GetName();
-		out_mat.textureNames_.push_back(bcName);
-		out_mat.textureNames_.push_back(nName);
-		out_mat.textureNames_.push_back(ormName);
-		out_mat.isOpaque_ = mat->IsOpaque();
-		out_resource->materials_.push_back(out_mat);
 	}
-	uint32_t vb_offset = 0;
-	uint32_t ib_offset = 0;
-	uint32_t pb_offset = 0;
-	uint32_t vib_offset = 0;
-	for (auto&& submesh : mesh_work->GetSubmeshes())
-	{
-		sl12::ResourceMeshSubmesh out_sub;
-		out_sub.materialIndex_ = submesh->GetMaterialIndex();
 
-		auto&& src_vb = submesh->GetVertexBuffer();
-		auto&& src_ib = submesh->GetIndexBuffer();
-		auto&& src_pb = submesh->GetPackedPrimitive();
-		auto&& src_vib = submesh->GetVertexIndexBuffer();
-		std::vector<float> vbp, vbn, vbt, vbu;
-		vbp.resize(3 * src_vb.size());
-		vbn.resize(3 * src_vb.size());
-		vbt.resize(4 * src_vb.size());
-		vbu.resize(2 * src_vb.size());
-		for (size_t i = 0; i < src_vb.size(); i++)
+	if (context.isStatsEnabled)
+	{
+		std::vector<const ConvertStats*> stats;
+		for (auto&& r : results)
 		{
-			memcpy(&vbp[i * 3], &src_vb[i].pos, sizeof(float) * 3);
-			memcpy(&vbn[i * 3], &src_vb[i].normal, sizeof(float) * 3);
-			memcpy(&vbt[i * 4], &src_vb[i].tangent, sizeof(float) * 4);
-			memcpy(&vbu[i * 2], &src_vb[i].uv, sizeof(float) * 2);
+			if (r.pStats)
+			{
+				stats.push_back(r.pStats.get());
+			}
 		}
-
-		auto CopyBuffer = [](std::vector<sl12::u8>& dst, const void* pData, size_t dataSize)
-		{
-			auto cs = dst.size();
-			dst.resize(cs + dataSize);
-			memcpy(dst.data() + cs, pData, dataSize);
-		};
-		CopyBuffer(out_resource->vbPosition_,  vbp.data(), sizeof(float) * vbp.size());
-		CopyBuffer(out_resource->vbNormal_,    vbn.data(), sizeof(float) * vbn.size());
-		CopyBuffer(out_resource->vbTangent_,   vbt.data(), sizeof(float) * vbt.size());
-		CopyBuffer(out_resource->vbTexcoord_,  vbu.data(), sizeof(float) * vbu.size());
-		CopyBuffer(out_resource->indexBuffer_, src_ib.data(), sizeof(uint32_t)* src_ib.size());
-		CopyBuffer(out_resource->meshletPackedPrimitive_, src_pb.data(), sizeof(uint32_t)* src_pb.size());
-		CopyBuffer(out_resource->meshletVertexIndex_, src_vib.data(), sizeof(float) * src_vib.size());
-
-		out_sub.vertexOffset_ = vb_offset;
-		out_sub.vertexCount_ = (uint32_t)src_vb.size();
-		out_sub.indexOffset_ = ib_offset;
-		out_sub.indexCount_ = (uint32_t)src_ib.size();
-		out_sub.meshletPrimitiveOffset_ = pb_offset;
-		out_sub.meshletPrimitiveCount_ = (uint32_t)src_pb.size();
-		out_sub.meshletVertexIndexOffset_ = vib_offset;
-		out_sub.meshletVertexIndexCount_ = (uint32_t)src_vib.size();
-		vb_offset += out_sub.vertexCount_;
-		ib_offset += out_sub.indexCount_;
-		pb_offset += out_sub.meshletPrimitiveCount_;
-		vib_offset += out_sub.meshletVertexIndexCount_;
-
-		out_sub.boundingSphere_.centerX = submesh->GetBoundingSphere().center.x;
-		out_sub.boundingSphere_.centerY = submesh->GetBoundingSphere().center.y;
-		out_sub.boundingSphere_.centerZ = submesh->GetBoundingSphere().center.z;
-		out_sub.boundingSphere_.radius = submesh->GetBoundingSphere().radius;
-		out_sub.boundingBox_.minX = submesh->GetBoundingBox().aabbMin.x;
-		out_sub.boundingBox_.minY = submesh->GetBoundingBox().aabbMin.y;
-		out_sub.boundingBox_.minZ = submesh->GetBoundingBox().aabbMin.z;
-		out_sub.boundingBox_.maxX = submesh->GetBoundingBox().aabbMax.x;
-		out_sub.boundingBox_.maxY = submesh->GetBoundingBox().aabbMax.y;
-		out_sub.boundingBox_.maxZ = submesh->GetBoundingBox().aabbMax.z;
-
-		for (auto&& meshlet : submesh->GetMeshlets())
+		if (!WriteStatsJson(process_options.statsPath, stats))
 		{
-			sl12::ResourceMeshMeshlet m;
-			m.indexOffset_ = meshlet.indexOffset;
-			m.indexCount_ = meshlet.indexCount;
-			m.primitiveOffset_ = meshlet.primitiveOffset;
-			m.primitiveCount_ = meshlet.primitiveCount;
-			m.vertexIndexOffset_ = meshlet.vertexIndexOffset;
-			m.vertexIndexCount_ = meshlet.vertexIndexCount;
-			m.boundingSphere_.centerX = meshlet.boundingSphere.center.x;
-			m.boundingSphere_.centerY = meshlet.boundingSphere.center.y;
-			m.boundingSphere_.centerZ = meshlet.boundingSphere.center.z;
-			m.boundingSphere_.radius = meshlet.boundingSphere.radius;
-			m.boundingBox_.minX = meshlet.boundingBox.aabbMin.x;
-			m.boundingBox_.minY = meshlet.boundingBox.aabbMin.y;
-			m.boundingBox_.minZ = meshlet.boundingBox.aabbMin.z;
-			m.boundingBox_.maxX = meshlet.boundingBox.aabbMax.x;
-			m.boundingBox_.maxY = meshlet.boundingBox.aabbMax.y;
-			m.boundingBox_.maxZ = meshlet.boundingBox.aabbMax.z;
-			m.cone_.apexX = meshlet.cone.apex.x;
-			m.cone_.apexY = meshlet.cone.apex.y;
-			m.cone_.apexZ = meshlet.cone.apex.z;
-			m.cone_.axisX = meshlet.cone.axis.x;
-			m.cone_.axisY = meshlet.cone.axis.y;
-			m.cone_.axisZ = meshlet.cone.axis.z;
-			m.cone_.cutoff = meshlet.cone.cutoff;
-			out_sub.meshlets_.push_back(m);
+			fprintf(stderr, "failed to write stats. (%s)\n", process_options.statsPath.c_str());
+			ret = -1;
 		}
-
-		out_resource->submeshes_.push_back(out_sub);
 	}
 
+#if defined(_WIN32)
+	if (SUCCEEDED(hr))
 	{
-		std::fstream ofs(options.outputFilePath, std::ios::out | std::ios::binary);
-		cereal::BinaryOutputArchive ar(ofs);
-		ar(cereal::make_nvp("mesh", *out_resource));
+		CoUninitialize();
 	}
-
-	fprintf(stdout, "convert succeeded!!.\n");
-
-	return 0;
+#endif
+	return ret;
 }
 
 
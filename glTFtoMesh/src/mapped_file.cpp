@@ -0,0 +1,121 @@
+﻿#include "mapped_file.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+#if defined(_WIN32)
+bool MappedFile::Open(const std::string& filePath)
+{
+	Close();
+
+	HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+	if (file_size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		isEmpty_ = true;
+		return true;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	hFile_ = file;
+	hMapping_ = mapping;
+	pData_ = static_cast<const uint8_t*>(view);
+	size_ = (size_t)file_size.QuadPart;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (pData_)
+	{
+		UnmapViewOfFile(pData_);
+		CloseHandle(hMapping_);
+		CloseHandle(hFile_);
+	}
+	pData_ = nullptr;
+	size_ = 0;
+	isEmpty_ = false;
+	hFile_ = nullptr;
+	hMapping_ = nullptr;
+}
+#else
+bool MappedFile::Open(const std::string& filePath)
+{
+	Close();
+
+	int fd = open(filePath.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		close(fd);
+		return false;
+	}
+	if (st.st_size == 0)
+	{
+		close(fd);
+		isEmpty_ = true;
+		return true;
+	}
+
+	void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (view == MAP_FAILED)
+	{
+		return false;
+	}
+	madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+	pData_ = static_cast<const uint8_t*>(view);
+	size_ = (size_t)st.st_size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (pData_)
+	{
+		munmap(const_cast<uint8_t*>(pData_), size_);
+	}
+	pData_ = nullptr;
+	size_ = 0;
+	isEmpty_ = false;
+}
+#endif
+
+
+//	EOF
@@ -0,0 +1,48 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+
+
+// read only memory mapped file.
+// the mapping is valid until Close() or destruction, and it can be read from any thread.
+class MappedFile
+{
+public:
+	MappedFile()
+	{}
+	~MappedFile()
+	{
+		Close();
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::string& filePath);
+	void Close();
+
+	const uint8_t* GetData() const
+	{
+		return pData_;
+	}
+	size_t GetSize() const
+	{
+		return size_;
+	}
+	bool IsOpen() const
+	{
+		return pData_ != nullptr || isEmpty_;
+	}
+
+private:
+	const uint8_t*	pData_ = nullptr;
+	size_t			size_ = 0;
+	bool			isEmpty_ = false;		// empty files can not be mapped.
+#if defined(_WIN32)
+	void*			hFile_ = nullptr;
+	void*			hMapping_ = nullptr;
+#endif
+};	// class MappedFile
+
+//	EOF
@@ -0,0 +1,49 @@
+﻿#include "mesh_codec.h"
+
+#include <algorithm>
+#include "meshoptimizer.h"
+
+
+void InitializeMeshCodec()
+{
+	// version 1 is supported by meshoptimizer 0.14 or later.
+	meshopt_encodeIndexVersion(1);
+}
+
+void EncodeVertexStream(std::vector<uint8_t>& buffer, size_t elementSize)
+{
+	size_t count = buffer.size() / elementSize;
+	std::vector<uint8_t> encoded(meshopt_encodeVertexBufferBound(count, elementSize));
+	encoded.resize(meshopt_encodeVertexBuffer(encoded.data(), encoded.size(), buffer.data(), count, elementSize));
+	buffer.swap(encoded);
+}
+
+namespace
+{
+	template <typename T>
+	void EncodeIndices(std::vector<uint8_t>& buffer)
+	{
+		auto indices = reinterpret_cast<const T*>(buffer.data());
+		size_t count = buffer.size() / sizeof(T);
+		size_t vertex_count = count ? (size_t)*std::max_element(indices, indices + count) + 1 : 0;
+
+		std::vector<uint8_t> encoded(meshopt_encodeIndexBufferBound(count, vertex_count));
+		encoded.resize(meshopt_encodeIndexBuffer(encoded.data(), encoded.size(), indices, count));
+		buffer.swap(encoded);
+	}
+}
+
+void EncodeIndexStream(std::vector<uint8_t>& buffer, size_t indexSize)
+{
+	if (indexSize == sizeof(uint16_t))
+	{
+		EncodeIndices<uint16_t>(buffer);
+	}
+	else
+	{
+		EncodeIndices<uint32_t>(buffer);
+	}
+}
+
+
+//	EOF
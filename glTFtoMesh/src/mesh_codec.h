@@ -0,0 +1,19 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// select the codec versions. meshoptimizer keeps them in global state,
+// so this is called once at process startup before any thread encodes.
+void InitializeMeshCodec();
+
+// replace the buffer with the compressed stream. see RMeshCompression.
+// elementSize must be a multiple of 4 and 256 or less.
+void EncodeVertexStream(std::vector<uint8_t>& buffer, size_t elementSize);
+
+// buffer is a triangle list of indexSize (2 or 4) byte indices.
+void EncodeIndexStream(std::vector<uint8_t>& buffer, size_t indexSize);
+
+//	EOF
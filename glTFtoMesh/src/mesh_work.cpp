@@ -1,8 +1,15 @@
 ﻿#include "mesh_work.h"
+#include "cluster_dag.h"
+#include "gltf_buffer.h"
+#include "tangent_space.h"
 
 #include <fstream>
 #include <sstream>
 #include <map>
+#include <set>
+#include <mutex>
+#include <algorithm>
+#include <atomic>
 
 
 using namespace Microsoft::glTF;
@@ -48,86 +55,113 @@ namespace
 		std::string		path_;
 	};
 
-	struct MikkTSpaceMesh
+	// read an accessor with the resource reader, for accessors which are not in the mapped buffers.
+	// outView refers outStorage.
+	bool ReadAccessorFallback(const GLTFResourceReader& reader, const Document& document, const Accessor& accessor, std::vector<uint8_t>& outStorage, AccessorView& outView)
 	{
-		std::vector<Vertex>&	vertices;
-		std::vector<uint32_t>&	indices;
-
-		MikkTSpaceMesh(std::vector<Vertex>& v, std::vector<uint32_t>& i)
-			: vertices(v), indices(i)
-		{}
-
-		SMikkTSpaceContext GetContext()
-		{
-			static SMikkTSpaceInterface inter = {
-				GetNumFaces,
-				GetNumVerticesOfFace,
-				GetPosition,
-				GetNormal,
-				GetTexCoord,
-				SetTSpaceBasic,
-				SetTSpace
-			};
-
-			SMikkTSpaceContext ret;
-			ret.m_pInterface = &inter;
-			ret.m_pUserData = this;
-			ret.m_bIgnoreDegenerates = false;
-			return ret;
-		}
-
-		static int GetNumFaces(const SMikkTSpaceContext * pContext)
+		auto Store = [&](const auto& data)
 		{
-			auto mesh = (const MikkTSpaceMesh*)pContext->m_pUserData;
-			return (int)(mesh->indices.size() / 3);
-		}
-
-		static int GetNumVerticesOfFace(const SMikkTSpaceContext * pContext, const int iFace)
+			outStorage.resize(sizeof(data[0]) * data.size());
+			if (!data.empty())
+			{
+				memcpy(outStorage.data(), data.data(), outStorage.size());
+			}
+		};
+		switch (accessor.componentType)
 		{
-			return 3;
+		case COMPONENT_BYTE:			Store(reader.ReadBinaryData<int8_t>(document, accessor)); break;
+		case COMPONENT_UNSIGNED_BYTE:	Store(reader.ReadBinaryData<uint8_t>(document, accessor)); break;
+		case COMPONENT_SHORT:			Store(reader.ReadBinaryData<int16_t>(document, accessor)); break;
+		case COMPONENT_UNSIGNED_SHORT:	Store(reader.ReadBinaryData<uint16_t>(document, accessor)); break;
+		case COMPONENT_UNSIGNED_INT:	Store(reader.ReadBinaryData<uint32_t>(document, accessor)); break;
+		case COMPONENT_FLOAT:			Store(reader.ReadBinaryData<float>(document, accessor)); break;
+		default:						return false;
 		}
 
-		static void GetPosition(const SMikkTSpaceContext * pContext, float fvPosOut[], const int iFace, const int iVert)
+		outView.pData = outStorage.data();
+		outView.count = accessor.count;
+		outView.componentType = accessor.componentType;
+		outView.componentCount = Accessor::GetTypeCount(accessor.type);
+		outView.stride = (size_t)Accessor::GetComponentTypeSize(accessor.componentType) * outView.componentCount;
+		outView.normalized = accessor.normalized;
+		return outStorage.size() >= outView.stride * outView.count;
+	}
+
+	// raw counters of meshoptimizer analyzers. they are summed over submeshes and converted to MeshMetrics.
+	struct MetricsCounter
+	{
+		uint64_t	triangles = 0;
+		uint64_t	vertices = 0;
+		uint64_t	transformed = 0;
+		uint64_t	pixelsCovered = 0;
+		uint64_t	pixelsShaded = 0;
+		uint64_t	bytesFetched = 0;
+		uint64_t	vertexBytes = 0;
+
+		void Add(const MetricsCounter& c)
 		{
-			auto mesh = (const MikkTSpaceMesh*)pContext->m_pUserData;
-			auto index = mesh->indices[iFace * 3 + iVert];
-			fvPosOut[0] = mesh->vertices[index].pos.x;
-			fvPosOut[1] = mesh->vertices[index].pos.y;
-			fvPosOut[2] = mesh->vertices[index].pos.z;
+			triangles += c.triangles;
+			vertices += c.vertices;
+			transformed += c.transformed;
+			pixelsCovered += c.pixelsCovered;
+			pixelsShaded += c.pixelsShaded;
+			bytesFetched += c.bytesFetched;
+			vertexBytes += c.vertexBytes;
 		}
-		static void GetNormal(const SMikkTSpaceContext * pContext, float fvNormOut[], const int iFace, const int iVert)
+
+		MeshMetrics ToMetrics() const
 		{
-			auto mesh = (const MikkTSpaceMesh*)pContext->m_pUserData;
-			auto index = mesh->indices[iFace * 3 + iVert];
-			fvNormOut[0] = mesh->vertices[index].normal.x;
-			fvNormOut[1] = mesh->vertices[index].normal.y;
-			fvNormOut[2] = mesh->vertices[index].normal.z;
+			MeshMetrics ret;
+			ret.acmr = triangles ? (double)transformed / (double)triangles : 0.0;
+			ret.atvr = vertices ? (double)transformed / (double)vertices : 0.0;
+			ret.overdraw = pixelsCovered ? (double)pixelsShaded / (double)pixelsCovered : 0.0;
+			ret.overfetch = vertexBytes ? (double)bytesFetched / (double)vertexBytes : 0.0;
+			return ret;
 		}
-		static void GetTexCoord(const SMikkTSpaceContext * pContext, float fvTexcOut[], const int iFace, const int iVert)
+	};	// struct MetricsCounter
+
+	MetricsCounter AnalyzeIndexBuffer(const std::vector<Vertex>& vertexBuffer, const std::vector<uint32_t>& indexBuffer)
+	{
+		static const unsigned int kCacheSize = 16;
+
+		MetricsCounter ret;
+		if (indexBuffer.empty())
 		{
-			auto mesh = (const MikkTSpaceMesh*)pContext->m_pUserData;
-			auto index = mesh->indices[iFace * 3 + iVert];
-			fvTexcOut[0] = mesh->vertices[index].uv.x;
-			fvTexcOut[1] = mesh->vertices[index].uv.y;
+			return ret;
 		}
+		auto vcache = meshopt_analyzeVertexCache(indexBuffer.data(), indexBuffer.size(), vertexBuffer.size(), kCacheSize, 0, 0);
+		auto overdraw = meshopt_analyzeOverdraw(indexBuffer.data(), indexBuffer.size(), &vertexBuffer[0].pos.x, vertexBuffer.size(), sizeof(Vertex));
+		auto vfetch = meshopt_analyzeVertexFetch(indexBuffer.data(), indexBuffer.size(), vertexBuffer.size(), sizeof(Vertex));
+		ret.triangles = indexBuffer.size() / 3;
+		ret.vertices = vertexBuffer.size();
+		ret.transformed = vcache.vertices_transformed;
+		ret.pixelsCovered = overdraw.pixels_covered;
+		ret.pixelsShaded = overdraw.pixels_shaded;
+		ret.bytesFetched = vfetch.bytes_fetched;
+		ret.vertexBytes = vertexBuffer.size() * sizeof(Vertex);
+		return ret;
+	}
 
-		static void SetTSpaceBasic(const SMikkTSpaceContext * pContext, const float fvTangent[], const float fSign, const int iFace, const int iVert)
+	// sum the counters of each step over submeshes. counters[submesh][0] is the input of the first pass.
+	void AppendPassMetrics(const std::vector<std::string>& passNames, const std::vector<std::vector<MetricsCounter>>& counters, std::vector<PassMetrics>& outMetrics)
+	{
+		std::vector<MetricsCounter> sums(passNames.size() + 1);
+		for (auto&& submesh : counters)
 		{
-			auto mesh = (const MikkTSpaceMesh*)pContext->m_pUserData;
-			auto index = mesh->indices[iFace * 3 + iVert];
-			auto&& vertex = mesh->vertices[index];
-			vertex.tangent.x = fvTangent[0];
-			vertex.tangent.y = fvTangent[1];
-			vertex.tangent.z = fvTangent[2];
-			vertex.tangent.w = fSign;
+			for (size_t i = 0; i < submesh.size() && i < sums.size(); i++)
+			{
+				sums[i].Add(submesh[i]);
+			}
 		}
-
-		static void SetTSpace(const SMikkTSpaceContext * pContext, const float fvTangent[], const float fvBiTangent[], const float fMagS, const float fMagT,
-			const tbool bIsOrientationPreserving, const int iFace, const int iVert)
+		for (size_t i = 0; i < passNames.size(); i++)
 		{
-			// not implemented.
+			PassMetrics metrics;
+			metrics.pass = passNames[i];
+			metrics.before = sums[i].ToMetrics();
+			metrics.after = sums[i + 1].ToMetrics();
+			outMetrics.push_back(metrics);
 		}
-	};
+	}
 
 	// from meshoptimizer
 	static void ComputeBoundingSphere(const float* points, size_t count, DirectX::XMFLOAT3& resultCenter, float& resultRadius)
@@ -200,9 +234,34 @@ namespace
 		resultRadius = radius;
 	}
 
+	void ComputeVertexBounds(const std::vector<Vertex>& vertexBuffer, BoundSphere& outSphere, BoundBox& outBox)
+	{
+		std::vector<DirectX::XMFLOAT3> points;
+		points.reserve(vertexBuffer.size());
+		DirectX::XMVECTOR aabbMin = DirectX::XMLoadFloat3(&vertexBuffer[0].pos);
+		DirectX::XMVECTOR aabbMax = DirectX::XMLoadFloat3(&vertexBuffer[0].pos);
+		for (auto&& v : vertexBuffer)
+		{
+			points.push_back(v.pos);
+
+			DirectX::XMVECTOR p = DirectX::XMLoadFloat3(&v.pos);
+			aabbMin = DirectX::XMVectorMin(aabbMin, p);
+			aabbMax = DirectX::XMVectorMax(aabbMax, p);
+		}
+		ComputeBoundingSphere(&points[0].x, points.size(), outSphere.center, outSphere.radius);
+		DirectX::XMStoreFloat3(&outBox.aabbMin, aabbMin);
+		DirectX::XMStoreFloat3(&outBox.aabbMax, aabbMax);
+	}
+
+	// all indices refer to vertices in the buffer.
+	bool IsValidIndices(const std::vector<uint32_t>& indices, size_t vertexCount)
+	{
+		return std::all_of(indices.begin(), indices.end(), [vertexCount](uint32_t index) { return index < vertexCount; });
+	}
+
 }
 
-bool MeshWork::ReadGLTFMesh(const std::string& inputPath, const std::string& inputFile)
+bool MeshWork::ReadGLTFMesh(const std::string& inputPath, const std::string& inputFile, bool instancing)
 {
 	bool is_glb = false;
 	if (GetExtent(inputFile) == ".glb")
@@ -210,28 +269,22 @@ bool MeshWork::ReadGLTFMesh(const std::string& inputPath, const std::string& inp
 		is_glb = true;
 	}
 
-	// glTF stream initialize.
-	auto stream_reader = std::make_unique<StreamReader>(inputPath);
-	auto gltf_stream = stream_reader->GetInputStream(inputFile);
-	std::unique_ptr<GLTFResourceReader> resource_reader;
+	// map the input file. accessors are read from the mapping without copies.
+	MappedFile input_file;
+	if (!input_file.Open(inputPath + inputFile))
+	{
+		return false;
+	}
 	std::string manifest;
+	const uint8_t* glb_bin = nullptr;
+	size_t glb_bin_size = 0;
 	if (!is_glb)
 	{
-		auto gltf_res_reader = std::make_unique<GLTFResourceReader>(std::move(stream_reader));
-
-		std::stringstream manifestStream;
-		manifestStream << gltf_stream->rdbuf();
-		manifest = manifestStream.str();
-
-		resource_reader = std::move(gltf_res_reader);
+		manifest.assign(reinterpret_cast<const char*>(input_file.GetData()), input_file.GetSize());
 	}
-	else
+	else if (!ParseGLB(input_file.GetData(), input_file.GetSize(), manifest, glb_bin, glb_bin_size))
 	{
-		auto glb_res_reader = std::make_unique<GLBResourceReader>(std::move(stream_reader), std::move(gltf_stream));
-
-		manifest = glb_res_reader->GetJson();
-
-		resource_reader = std::move(glb_res_reader);
+		return false;
 	}
 
 	if (manifest.empty())
@@ -239,18 +292,57 @@ bool MeshWork::ReadGLTFMesh(const std::string& inputPath, const std::string& inp
 		return false;
 	}
 
-	auto document = Deserialize(manifest);
+	// resource reader is used only for data which is not in the mapped buffers. (sparse accessors, data uris)
+	// it is not thread safe, so it is created on demand and used under reader_mutex.
+	std::mutex reader_mutex;
+	std::unique_ptr<GLTFResourceReader> resource_reader;
+	auto GetResourceReader = [&]() -> GLTFResourceReader&
+	{
+		if (!resource_reader)
+		{
+			auto stream_reader = std::make_unique<StreamReader>(inputPath);
+			if (is_glb)
+			{
+				auto gltf_stream = stream_reader->GetInputStream(inputFile);
+				resource_reader = std::make_unique<GLBResourceReader>(std::move(stream_reader), std::move(gltf_stream));
+			}
+			else
+			{
+				resource_reader = std::make_unique<GLTFResourceReader>(std::move(stream_reader));
+			}
+		}
+		return *resource_reader;
+	};
+
+	Document document;
+	{
+		ScopedStats stats(pStats_, "Deserialize");
+		document = Deserialize(manifest);
+	}
+	GLTFBufferSet buffer_set;
+	buffer_set.Setup(document, inputPath, glb_bin, glb_bin_size);
 
 	// if file is .glb, read texture images.
 	if (is_glb)
 	{
+		ScopedStats stats(pStats_, "ReadTextureImages");
 		textures_.reserve(document.images.Size());
 		for (auto&& image : document.images.Elements())
 		{
 			auto work = std::make_unique<TextureWork>();
 
-			auto data = resource_reader->ReadBinaryData(document, image);
-			work->binary_.swap(data);
+			const uint8_t* data;
+			size_t data_size;
+			if (buffer_set.GetBufferViewData(document, image.bufferViewId, data, data_size))
+			{
+				work->binary_.assign(data, data + data_size);
+			}
+			else
+			{
+				std::lock_guard<std::mutex> lock(reader_mutex);
+				auto read_data = GetResourceReader().ReadBinaryData(document, image);
+				work->binary_.swap(read_data);
+			}
 
 			textures_.push_back(std::move(work));
 		}
@@ -285,6 +377,7 @@ bool MeshWork::ReadGLTFMesh(const std::string& inputPath, const std::string& inp
 					case TextureType::BaseColor:			tex_name += ".bc.png"; break;
 					case TextureType::Normal:				tex_name += ".n.png"; break;
 					case TextureType::MetallicRoughness:	tex_name += ".orm.png"; break;
+					case TextureType::Occlusion:			tex_name += ".o.png"; break;
 					}
 					textures_[image_index]->name_ = tex_name;
 				}
@@ -294,6 +387,11 @@ bool MeshWork::ReadGLTFMesh(const std::string& inputPath, const std::string& inp
 			case TextureType::BaseColor:			work->textures_[MaterialWork::TextureKind::BaseColor] = tex_name; break;
 			case TextureType::Normal:				work->textures_[MaterialWork::TextureKind::Normal] = tex_name; break;
 			case TextureType::MetallicRoughness:	work->textures_[MaterialWork::TextureKind::ORM] = tex_name; break;
+			case TextureType::Occlusion:			work->occlusionTexture_ = tex_name; break;
+			}
+			if (is_glb && tex.second == TextureType::BaseColor && mat.alphaMode == AlphaMode::ALPHA_MASK)
+			{
+				textures_[image_index]->alphaCutoff_ = mat.alphaCutoff;
 			}
 		}
 
@@ -358,113 +456,408 @@ bool MeshWork::ReadGLTFMesh(const std::string& inputPath, const std::string& inp
 		}
 	}
 
-	// read submeshes.
-	std::vector<DirectX::XMFLOAT3> all_points;
-	for (auto&& node : nodes_)
+	// list up primitives.
+	struct PrimitiveRef
 	{
-		if (node.meshIndex < 0)
-			continue;
-
-		auto&& mesh = document.meshes[node.meshIndex];
-		DirectX::XMMATRIX transform = DirectX::XMLoadFloat4x4(&node.transformGlobal);
-		for (auto&& prim : mesh.primitives)
+		const MeshPrimitive*	pPrim;
+		DirectX::XMFLOAT4X4		transform;
+		uint32_t				meshIndex;
+	};
+	std::vector<PrimitiveRef> prim_refs;
+	if (instancing)
+	{
+		// each mesh is read once in mesh space, in order of the first reference.
+		DirectX::XMFLOAT4X4 identity;
+		DirectX::XMStoreFloat4x4(&identity, DirectX::XMMatrixIdentity());
+		std::map<int, uint32_t> mesh_map;
+		for (auto&& node : nodes_)
 		{
-			std::unique_ptr<SubmeshWork> work(new SubmeshWork());
-
-			work->materialIndex_ = std::stoi(prim.materialId);
+			if (node.meshIndex < 0)
+				continue;
 
-			// create base index buffer.
-			auto&& index_accessor = document.accessors.Get(prim.indicesAccessorId);
-			if (index_accessor.componentType == Microsoft::glTF::ComponentType::COMPONENT_UNSIGNED_BYTE)
+			auto it = mesh_map.find(node.meshIndex);
+			if (it == mesh_map.end())
 			{
-				auto indexBuffer = resource_reader->ReadBinaryData<uint8_t>(document, index_accessor);
-				work->indexBuffer_.clear();
-				work->indexBuffer_.reserve(indexBuffer.size());
-				for (auto&& index : indexBuffer)
+				uint32_t mesh_index = (uint32_t)mesh_map.size();
+				it = mesh_map.insert(std::make_pair(node.meshIndex, mesh_index)).first;
+				for (auto&& prim : document.meshes[node.meshIndex].primitives)
 				{
-					work->indexBuffer_.push_back((uint32_t)index);
+					prim_refs.push_back(PrimitiveRef{ &prim, identity, mesh_index });
 				}
 			}
-			if (index_accessor.componentType == Microsoft::glTF::ComponentType::COMPONENT_UNSIGNED_SHORT)
+			instances_.push_back(MeshInstance{ node.transformGlobal, it->second });
+		}
+		instancedMeshes_.resize(mesh_map.size());
+	}
+	else
+	{
+		for (auto&& node : nodes_)
+		{
+			if (node.meshIndex < 0)
+				continue;
+
+			auto&& mesh = document.meshes[node.meshIndex];
+			for (auto&& prim : mesh.primitives)
 			{
-				auto indexBuffer = resource_reader->ReadBinaryData<uint16_t>(document, index_accessor);
-				work->indexBuffer_.clear();
-				work->indexBuffer_.reserve(indexBuffer.size());
-				for (auto&& index : indexBuffer)
-				{
-					work->indexBuffer_.push_back((uint32_t)index);
-				}
+				prim_refs.push_back(PrimitiveRef{ &prim, node.transformGlobal, 0 });
+			}
+		}
+	}
+
+	// read submeshes.
+	std::vector<std::unique_ptr<SubmeshWork>> works(prim_refs.size());
+	std::vector<ContentHash> prim_hashes(prim_refs.size());
+	std::atomic<bool> prim_failed{ false };
+	ParallelFor(pJobSystem_, prim_refs.size(), [&](size_t prim_index)
+	{
+		auto&& prim = *prim_refs[prim_index].pPrim;
+		DirectX::XMMATRIX transform = DirectX::XMLoadFloat4x4(&prim_refs[prim_index].transform);
+		std::unique_ptr<SubmeshWork> work(new SubmeshWork());
+
+		// primitives without a material use the default material. (-1)
+		work->materialIndex_ = prim.materialId.empty() ? -1 : std::stoi(prim.materialId);
+		work->meshIndex_ = prim_refs[prim_index].meshIndex;
+
+		ScopedStats stats(pStats_, "submesh", std::to_string(prim_index), "Decode");
+
+		// views of the accessors. accessors which are not in the mapped buffers are read into the storages.
+		std::vector<uint8_t> fallback_storage[5];
+		auto GetView = [&](const std::string& accessorId, int slot, AccessorView& outView)
+		{
+			auto&& accessor = document.accessors.Get(accessorId);
+			if (buffer_set.GetAccessorView(document, accessor, outView))
+			{
+				return true;
 			}
-			if (index_accessor.componentType == Microsoft::glTF::ComponentType::COMPONENT_UNSIGNED_INT)
+			std::lock_guard<std::mutex> lock(reader_mutex);
+			return ReadAccessorFallback(GetResourceReader(), document, accessor, fallback_storage[slot], outView);
+		};
+
+		// create base vertex buffer.
+		std::string accessorId;
+		AccessorView view;
+		if (prim.TryGetAttributeAccessorId("POSITION", accessorId) && GetView(accessorId, 0, view) && view.count > 0)
+		{
+			work->vertexBuffer_.resize(view.count);
+			if (!ReadPositions(view, transform, &work->vertexBuffer_[0].pos, sizeof(Vertex)))
 			{
-				work->indexBuffer_ = resource_reader->ReadBinaryData<uint32_t>(document, index_accessor);
+				fprintf(stderr, "unsupported position format. (primitive %zu)\n", prim_index);
+				prim_failed = true;
+				return;
 			}
 
-			// create base vertex buffer.
-			std::string accessorId;
-			if (prim.TryGetAttributeAccessorId("POSITION", accessorId))
+			if (!work->vertexBuffer_.empty() && prim.TryGetAttributeAccessorId("NORMAL", accessorId) && GetView(accessorId, 1, view))
 			{
-				auto&& accessor = document.accessors.Get(accessorId);
-				auto data = resource_reader->ReadBinaryData<float>(document, accessor);
-				size_t vertex_count = data.size() / 3;
-				work->vertexBuffer_.resize(vertex_count);
-				for (size_t i = 0; i < vertex_count; ++i)
+				if (view.count != work->vertexBuffer_.size() || !ReadNormals(view, transform, &work->vertexBuffer_[0].normal, sizeof(Vertex)))
 				{
-					DirectX::XMFLOAT3 v(data[i * 3 + 0], data[i * 3 + 1], data[i * 3 + 2]);
-					DirectX::XMVECTOR V = DirectX::XMLoadFloat3(&v);
-					V = DirectX::XMVector3TransformCoord(V, transform);
-					DirectX::XMStoreFloat3(&work->vertexBuffer_[i].pos, V);
+					fprintf(stderr, "unsupported normal format. (primitive %zu)\n", prim_index);
 				}
-
-				if (prim.TryGetAttributeAccessorId("NORMAL", accessorId))
+			}
+			if (!work->vertexBuffer_.empty() && prim.TryGetAttributeAccessorId("TEXCOORD_0", accessorId) && GetView(accessorId, 2, view))
+			{
+				if (view.count != work->vertexBuffer_.size() || !ReadTexcoords(view, &work->vertexBuffer_[0].uv, sizeof(Vertex)))
 				{
-					auto&& accessor = document.accessors.Get(accessorId);
-					auto data = resource_reader->ReadBinaryData<float>(document, accessor);
-					for (size_t i = 0; i < vertex_count; ++i)
-					{
-						DirectX::XMFLOAT3 n(data[i * 3 + 0], data[i * 3 + 1], data[i * 3 + 2]);
-						DirectX::XMVECTOR N = DirectX::XMLoadFloat3(&n);
-						N = DirectX::XMVector3Normalize(DirectX::XMVector3TransformNormal(N, transform));
-						DirectX::XMStoreFloat3(&work->vertexBuffer_[i].normal, N);
-					}
+					fprintf(stderr, "unsupported texcoord format. (primitive %zu)\n", prim_index);
 				}
-				if (prim.TryGetAttributeAccessorId("TEXCOORD_0", accessorId))
+			}
+			if (!work->vertexBuffer_.empty() && prim.TryGetAttributeAccessorId("TANGENT", accessorId) && GetView(accessorId, 3, view))
+			{
+				// tangents are generated if the source tangents are not usable.
+				work->hasTangents_ = view.count == work->vertexBuffer_.size() && ReadTangents(view, transform, &work->vertexBuffer_[0].tangent, sizeof(Vertex));
+				if (!work->hasTangents_)
 				{
-					auto&& accessor = document.accessors.Get(accessorId);
-					auto data = resource_reader->ReadBinaryData<float>(document, accessor);
-					for (size_t i = 0; i < vertex_count; ++i)
-					{
-						work->vertexBuffer_[i].uv.x = data[i * 2 + 0];
-						work->vertexBuffer_[i].uv.y = data[i * 2 + 1];
-					}
+					fprintf(stderr, "unsupported tangent format. (primitive %zu)\n", prim_index);
 				}
 			}
+		}
 
-			// generate mikk t space.
-			MikkTSpaceMesh mikk_mesh(work->vertexBuffer_, work->indexBuffer_);
-			auto mikk_context = mikk_mesh.GetContext();
-			genTangSpaceDefault(&mikk_context);
+		else
+		{
+			fprintf(stderr, "primitive has no positions. (primitive %zu)\n", prim_index);
+			prim_failed = true;
+			return;
+		}
 
-			// compute bounds.
-			std::vector<DirectX::XMFLOAT3> points;
-			points.reserve(work->vertexBuffer_.size());
-			DirectX::XMVECTOR aabbMin = DirectX::XMLoadFloat3(&work->vertexBuffer_[0].pos);
-			DirectX::XMVECTOR aabbMax = DirectX::XMLoadFloat3(&work->vertexBuffer_[0].pos);
-			for (auto&& v : work->vertexBuffer_)
+		// create base index buffer. non indexed primitives are drawn in vertex order.
+		if (prim.indicesAccessorId.empty())
+		{
+			work->indexBuffer_.resize(work->vertexBuffer_.size());
+			for (uint32_t i = 0; i < (uint32_t)work->indexBuffer_.size(); i++)
 			{
-				points.push_back(v.pos);
-				all_points.push_back(v.pos);
+				work->indexBuffer_[i] = i;
+			}
+		}
+		else if (GetView(prim.indicesAccessorId, 4, view))
+		{
+			work->indexBuffer_.resize(view.count);
+			if (!ReadIndices(view, work->indexBuffer_.data()))
+			{
+				fprintf(stderr, "unsupported index format. (primitive %zu)\n", prim_index);
+				prim_failed = true;
+				return;
+			}
+		}
+		else
+		{
+			fprintf(stderr, "failed to read indices. (primitive %zu)\n", prim_index);
+			prim_failed = true;
+			return;
+		}
+		if (!IsValidIndices(work->indexBuffer_, work->vertexBuffer_.size()))
+		{
+			fprintf(stderr, "index out of vertex range. (primitive %zu)\n", prim_index);
+			prim_failed = true;
+			return;
+		}
 
-				DirectX::XMVECTOR p = DirectX::XMLoadFloat3(&v.pos);
-				aabbMin = DirectX::XMVectorMin(aabbMin, p);
-				aabbMax = DirectX::XMVectorMax(aabbMax, p);
+		// hash geometry inputs. tangents are not generated yet.
+		ContentHasher hasher;
+		hasher.UpdateValue(work->materialIndex_);
+		hasher.UpdateValue(work->meshIndex_);
+		hasher.UpdateValue(work->hasTangents_);
+		hasher.UpdateValue(NeedsTangents(*work));
+		hasher.Update(work->indexBuffer_);
+		hasher.Update(work->vertexBuffer_);
+		prim_hashes[prim_index] = hasher.Finalize();
+
+		works[prim_index] = std::move(work);
+	});
+	// later stages assume every submesh has vertices and valid indices.
+	if (prim_failed)
+	{
+		return false;
+	}
+
+	// gather submeshes in primitive order, so the result does not depend on the thread count.
+	ContentHasher geometry_hasher;
+	for (size_t i = 0; i < works.size(); i++)
+	{
+		geometry_hasher.Update(prim_hashes[i]);
+		submeshes_.push_back(std::move(works[i]));
+	}
+	// instance transforms affect the mesh bounds.
+	for (auto&& instance : instances_)
+	{
+		geometry_hasher.UpdateValue(instance.transform);
+		geometry_hasher.UpdateValue(instance.meshIndex);
+	}
+	geometryHash_ = geometry_hasher.Finalize();
+	UpdateInstancedMeshes();
+
+	return true;
+}
+
+void MeshWork::AddSubmesh(int materialIndex, std::vector<Vertex>&& vertexBuffer, std::vector<uint32_t>&& indexBuffer)
+{
+	auto work = std::make_unique<SubmeshWork>();
+	work->materialIndex_ = materialIndex;
+	work->vertexBuffer_ = std::move(vertexBuffer);
+	work->indexBuffer_ = std::move(indexBuffer);
+	submeshes_.push_back(std::move(work));
+}
+
+size_t MeshWork::DeduplicateTextures()
+{
+	ScopedStats stats(pStats_, "DeduplicateTextures");
+
+	// the kind is the second extension. (".bc.png") the same bytes as different kinds are compressed differently.
+	std::vector<ContentHash> hashes(textures_.size());
+	ParallelFor(pJobSystem_, textures_.size(), [&](size_t index)
+	{
+		auto&& name = textures_[index]->name_;
+		auto ext_pos = name.rfind('.');
+		auto kind_pos = (ext_pos != std::string::npos && ext_pos > 0) ? name.rfind('.', ext_pos - 1) : std::string::npos;
+
+		ContentHasher hasher;
+		hasher.Update(textures_[index]->binary_);
+		hasher.Update((kind_pos != std::string::npos) ? name.substr(kind_pos, ext_pos - kind_pos) : std::string());
+		hashes[index] = hasher.Finalize();
+	});
+
+	std::map<std::pair<uint64_t, uint64_t>, size_t> first_index;
+	std::map<std::string, std::string> rename;
+	std::vector<std::unique_ptr<TextureWork>> unique_textures;
+	for (size_t i = 0; i < textures_.size(); i++)
+	{
+		auto it = first_index.insert(std::make_pair(std::make_pair(hashes[i].value[0], hashes[i].value[1]), unique_textures.size()));
+		if (it.second)
+		{
+			unique_textures.push_back(std::move(textures_[i]));
+		}
+		else
+		{
+			auto&& kept = unique_textures[it.first->second];
+			if (textures_[i]->name_ != kept->name_)
+			{
+				rename[textures_[i]->name_] = kept->name_;
+			}
+			kept->alphaCutoff_ = std::max(kept->alphaCutoff_, textures_[i]->alphaCutoff_);
+		}
+	}
+	size_t removed_count = textures_.size() - unique_textures.size();
+	textures_.swap(unique_textures);
+
+	if (!rename.empty())
+	{
+		auto Remap = [&rename](std::string& name)
+		{
+			auto it = rename.find(name);
+			if (it != rename.end())
+			{
+				name = it->second;
+			}
+		};
+		for (auto&& mat : materials_)
+		{
+			for (auto&& name : mat->textures_)
+			{
+				Remap(name);
+			}
+			Remap(mat->occlusionTexture_);
+		}
+	}
+	return removed_count;
+}
+
+size_t MeshWork::PackOcclusionTextures()
+{
+	auto FindTexture = [this](const std::string& name) -> TextureWork*
+	{
+		for (auto&& tex : textures_)
+		{
+			if (tex->name_ == name)
+			{
+				return tex.get();
 			}
-			ComputeBoundingSphere(&points[0].x, points.size(), work->boundingSphere_.center, work->boundingSphere_.radius);
-			DirectX::XMStoreFloat3(&work->boundingBox_.aabbMin, aabbMin);
-			DirectX::XMStoreFloat3(&work->boundingBox_.aabbMax, aabbMax);
+		}
+		return nullptr;
+	};
+
+	std::map<TextureWork*, const TextureWork*> sources;
+	std::set<TextureWork*> conflicts;
+	for (auto&& mat : materials_)
+	{
+		auto&& orm_name = mat->textures_[MaterialWork::TextureKind::ORM];
+		auto&& occlusion_name = mat->occlusionTexture_;
+		if (orm_name.empty() || occlusion_name.empty() || orm_name == occlusion_name)
+		{
+			continue;
+		}
+		TextureWork* pOrm = FindTexture(orm_name);
+		TextureWork* pOcclusion = FindTexture(occlusion_name);
+		if (!pOrm || !pOcclusion)
+		{
+			continue;
+		}
+		auto it = sources.insert(std::make_pair(pOrm, pOcclusion));
+		if (!it.second && it.first->second != pOcclusion)
+		{
+			conflicts.insert(pOrm);
+		}
+	}
+
+	size_t count = 0;
+	for (auto&& it : sources)
+	{
+		if (conflicts.find(it.first) == conflicts.end())
+		{
+			it.first->pOcclusionSource_ = it.second;
+			count++;
+		}
+	}
+	return count;
+}
 
-			submeshes_.push_back(std::move(work));
+void MeshWork::GenerateTangentAndBounds()
+{
+	GenerateTangents();
+	ComputeBounds();
+}
+
+void MeshWork::GenerateTangents()
+{
+	ParallelFor(pJobSystem_, submeshes_.size(), [&](size_t submesh_index)
+	{
+		auto&& work = submeshes_[submesh_index];
+
+		if (work->hasTangents_)
+		{
+			return;
 		}
+		if (!NeedsTangents(*work))
+		{
+			// shaders without normal texture do not use tangents, but keep them valid.
+			for (auto&& v : work->vertexBuffer_)
+			{
+				v.tangent = DirectX::XMFLOAT4(1.0f, 0.0f, 0.0f, 1.0f);
+			}
+			return;
+		}
+
+		// generate mikk t space.
+		ScopedStats stats(pStats_, "submesh", std::to_string(submesh_index), "genTangSpaceDefault");
+		GenerateSubmeshTangents(work->vertexBuffer_, work->indexBuffer_, pJobSystem_);
+	});
+}
+
+bool MeshWork::NeedsTangents(const SubmeshWork& submesh) const
+{
+	if (submesh.materialIndex_ < 0 || submesh.materialIndex_ >= (int)materials_.size())
+	{
+		return true;
+	}
+	return !materials_[submesh.materialIndex_]->textures_[MaterialWork::TextureKind::Normal].empty();
+}
+
+void MeshWork::ComputeBounds()
+{
+	ParallelFor(pJobSystem_, submeshes_.size(), [&](size_t submesh_index)
+	{
+		auto&& work = submeshes_[submesh_index];
+
+		// compute bounds.
+		ScopedStats stats(pStats_, "submesh", std::to_string(submesh_index), "ComputeBounds");
+		ComputeVertexBounds(work->vertexBuffer_, work->boundingSphere_, work->boundingBox_);
+	});
+
+	// gather points in submesh order, so the result does not depend on the thread count.
+	ScopedStats stats(pStats_, "ComputeMeshBounds");
+	std::vector<DirectX::XMFLOAT3> all_points;
+	if (!instances_.empty())
+	{
+		// corners of the submesh boxes of all instances.
+		for (auto&& instance : instances_)
+		{
+			auto&& mesh = instancedMeshes_[instance.meshIndex];
+			DirectX::XMMATRIX transform = DirectX::XMLoadFloat4x4(&instance.transform);
+			for (uint32_t i = 0; i < mesh.submeshCount; i++)
+			{
+				auto&& box = submeshes_[mesh.submeshOffset + i]->boundingBox_;
+				for (int corner = 0; corner < 8; corner++)
+				{
+					DirectX::XMFLOAT3 p(
+						(corner & 1) ? box.aabbMax.x : box.aabbMin.x,
+						(corner & 2) ? box.aabbMax.y : box.aabbMin.y,
+						(corner & 4) ? box.aabbMax.z : box.aabbMin.z);
+					DirectX::XMStoreFloat3(&p, DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&p), transform));
+					all_points.push_back(p);
+				}
+			}
+		}
+	}
+	else
+	{
+		for (auto&& work : submeshes_)
+		{
+			for (auto&& v : work->vertexBuffer_)
+			{
+				all_points.push_back(v.pos);
+			}
+		}
+	}
+	if (all_points.empty())
+	{
+		return;
 	}
 
 	// compute mesh bounds.
@@ -481,22 +874,21 @@ bool MeshWork::ReadGLTFMesh(const std::string& inputPath, const std::string& inp
 		DirectX::XMStoreFloat3(&boundingBox_.aabbMin, aabbMin);
 		DirectX::XMStoreFloat3(&boundingBox_.aabbMax, aabbMax);
 	}
-
-	return true;
 }
 
 size_t MeshWork::MergeSubmesh()
 {
-	std::map<int, int> submesh_map;
+	std::map<std::pair<uint32_t, int>, int> submesh_map;
 
 	int submesh_count = (int)submeshes_.size();
 	for (int i = 0; i < submesh_count; i++)
 	{
-		auto it = submesh_map.find(submeshes_[i]->materialIndex_);
+		auto key = std::make_pair(submeshes_[i]->meshIndex_, submeshes_[i]->materialIndex_);
+		auto it = submesh_map.find(key);
 		if (it == submesh_map.end())
 		{
 			// first submesh.
-			submesh_map[submeshes_[i]->materialIndex_] = i;
+			submesh_map[key] = i;
 			continue;
 		}
 
@@ -513,6 +905,7 @@ size_t MeshWork::MergeSubmesh()
 		{
 			their->indexBuffer_.push_back(index + vertex_start);
 		}
+		their->hasTangents_ = their->hasTangents_ && mine->hasTangents_;
 
 		// delete mine.
 		submeshes_[i].reset(nullptr);
@@ -531,92 +924,451 @@ size_t MeshWork::MergeSubmesh()
 			++it;
 		}
 	}
+	UpdateInstancedMeshes();
 
 	return submeshes_.size();
 }
 
-void MeshWork::OptimizeSubmesh()
+size_t MeshWork::SplitSubmesh(uint32_t maxVertices)
 {
-	static const float kOverdrawThreshold = 3.0f;
+	// triangles are taken in the index buffer order, which keeps the vertex cache order of OptimizeSubmesh().
+	// vertices are appended in the order of first use, so the split vertex buffers are in vertex fetch order.
+	std::vector<std::vector<std::unique_ptr<SubmeshWork>>> splits(submeshes_.size());
+	ParallelFor(pJobSystem_, submeshes_.size(), [&](size_t submesh_index)
+	{
+		auto&& work = submeshes_[submesh_index];
+		if (work->vertexBuffer_.size() <= maxVertices)
+		{
+			return;
+		}
 
-	for (auto&& submesh : submeshes_)
+		ScopedStats stats(pStats_, "submesh", std::to_string(submesh_index), "SplitSubmesh");
+		auto&& parts = splits[submesh_index];
+		std::vector<uint32_t> remap(work->vertexBuffer_.size());
+		std::vector<uint32_t> remap_part(work->vertexBuffer_.size(), ~0u);
+		for (size_t i = 0; i + 2 < work->indexBuffer_.size(); i += 3)
+		{
+			const uint32_t* tri = &work->indexBuffer_[i];
+			uint32_t part_index = (uint32_t)parts.size() - 1;
+			uint32_t new_vertices = 0;
+			for (int j = 0; j < 3; j++)
+			{
+				new_vertices += (parts.empty() || remap_part[tri[j]] != part_index) ? 1 : 0;
+			}
+			if (parts.empty() || parts.back()->vertexBuffer_.size() + new_vertices > maxVertices)
+			{
+				std::unique_ptr<SubmeshWork> part(new SubmeshWork());
+				part->materialIndex_ = work->materialIndex_;
+				part->meshIndex_ = work->meshIndex_;
+				part->hasTangents_ = work->hasTangents_;
+				parts.push_back(std::move(part));
+				part_index = (uint32_t)parts.size() - 1;
+			}
+
+			auto&& part = parts.back();
+			for (int j = 0; j < 3; j++)
+			{
+				uint32_t index = tri[j];
+				if (remap_part[index] != part_index)
+				{
+					remap_part[index] = part_index;
+					remap[index] = (uint32_t)part->vertexBuffer_.size();
+					part->vertexBuffer_.push_back(work->vertexBuffer_[index]);
+				}
+				part->indexBuffer_.push_back(remap[index]);
+			}
+		}
+		for (auto&& part : parts)
+		{
+			ComputeVertexBounds(part->vertexBuffer_, part->boundingSphere_, part->boundingBox_);
+		}
+	});
+
+	// split submeshes replace the source in place, so submeshes of a mesh stay contiguous.
+	size_t split_count = 0;
+	std::vector<std::unique_ptr<SubmeshWork>> submeshes;
+	for (size_t i = 0; i < submeshes_.size(); i++)
 	{
-		// generate vertex remap table.
-		std::vector<uint32_t> remap;
-		remap.resize(submesh->vertexBuffer_.size());
-		auto new_vertex_count = meshopt_generateVertexRemap(remap.data(), submesh->indexBuffer_.data(), submesh->indexBuffer_.size(), submesh->vertexBuffer_.data(), submesh->vertexBuffer_.size(), sizeof(Vertex));
+		if (splits[i].empty())
+		{
+			submeshes.push_back(std::move(submeshes_[i]));
+			continue;
+		}
+		split_count++;
+		for (auto&& part : splits[i])
+		{
+			submeshes.push_back(std::move(part));
+		}
+	}
+	submeshes_.swap(submeshes);
+	UpdateInstancedMeshes();
+
+	return split_count;
+}
+
+void MeshWork::UpdateInstancedMeshes()
+{
+	if (instancedMeshes_.empty())
+	{
+		return;
+	}
+
+	for (auto&& mesh : instancedMeshes_)
+	{
+		mesh.submeshOffset = 0;
+		mesh.submeshCount = 0;
+	}
+	for (uint32_t i = 0; i < (uint32_t)submeshes_.size(); i++)
+	{
+		auto&& mesh = instancedMeshes_[submeshes_[i]->meshIndex_];
+		if (mesh.submeshCount == 0)
+		{
+			mesh.submeshOffset = i;
+		}
+		mesh.submeshCount++;
+	}
+}
+
+void MeshWork::OptimizeSubmesh(const OptimizeOptions& options)
+{
+	std::vector<std::string> pass_names;
+	if (options.passes & OptimizePass::VertexCache) pass_names.push_back("VertexCache");
+	if (options.passes & OptimizePass::Overdraw) pass_names.push_back("Overdraw");
+	if (options.passes & OptimizePass::VertexFetch) pass_names.push_back("VertexFetch");
+
+	passMetrics_.clear();
+	std::vector<std::vector<MetricsCounter>> counters(submeshes_.size());
+	ParallelFor(pJobSystem_, submeshes_.size(), [&](size_t submesh_index)
+	{
+		auto&& submesh = submeshes_[submesh_index];
+		auto target = std::to_string(submesh_index);
 
-		// remap vertex/index buffer.
 		std::vector<Vertex> new_vertex_buffer;
 		std::vector<uint32_t> new_index_buffer;
-		new_vertex_buffer.resize(new_vertex_count);
-		new_index_buffer.resize(submesh->indexBuffer_.size());
-		meshopt_remapVertexBuffer(new_vertex_buffer.data(), submesh->vertexBuffer_.data(), submesh->vertexBuffer_.size(), sizeof(Vertex), remap.data());
-		meshopt_remapIndexBuffer(new_index_buffer.data(), submesh->indexBuffer_.data(), submesh->indexBuffer_.size(), remap.data());
+		size_t new_vertex_count;
+		{
+			ScopedStats stats(pStats_, "submesh", target, "meshopt_generateVertexRemap");
+
+			// generate vertex remap table.
+			std::vector<uint32_t> remap;
+			remap.resize(submesh->vertexBuffer_.size());
+			new_vertex_count = meshopt_generateVertexRemap(remap.data(), submesh->indexBuffer_.data(), submesh->indexBuffer_.size(), submesh->vertexBuffer_.data(), submesh->vertexBuffer_.size(), sizeof(Vertex));
+
+			// remap vertex/index buffer.
+			new_vertex_buffer.resize(new_vertex_count);
+			new_index_buffer.resize(submesh->indexBuffer_.size());
+			meshopt_remapVertexBuffer(new_vertex_buffer.data(), submesh->vertexBuffer_.data(), submesh->vertexBuffer_.size(), sizeof(Vertex), remap.data());
+			meshopt_remapIndexBuffer(new_index_buffer.data(), submesh->indexBuffer_.data(), submesh->indexBuffer_.size(), remap.data());
+		}
+
+		auto Analyze = [&]()
+		{
+			if (options.analyze)
+			{
+				ScopedStats stats(pStats_, "submesh", target, "AnalyzeMetrics");
+				counters[submesh_index].push_back(AnalyzeIndexBuffer(new_vertex_buffer, new_index_buffer));
+			}
+		};
+		Analyze();
 
 		// optimization.
-		meshopt_optimizeVertexCache(new_index_buffer.data(), new_index_buffer.data(), new_index_buffer.size(), new_vertex_count);
-		//meshopt_optimizeOverdraw(new_index_buffer.data(), new_index_buffer.data(), new_index_buffer.size(), &new_vertex_buffer[0].pos.x, new_vertex_buffer.size(), sizeof(Vertex), kOverdrawThreshold);
-		meshopt_optimizeVertexFetch(new_vertex_buffer.data(), new_index_buffer.data(), new_index_buffer.size(), new_vertex_buffer.data(), new_vertex_buffer.size(), sizeof(Vertex));
+		if (options.passes & OptimizePass::VertexCache)
+		{
+			{
+				ScopedStats stats(pStats_, "submesh", target, "meshopt_optimizeVertexCache");
+				meshopt_optimizeVertexCache(new_index_buffer.data(), new_index_buffer.data(), new_index_buffer.size(), new_vertex_count);
+			}
+			Analyze();
+		}
+		if (options.passes & OptimizePass::Overdraw)
+		{
+			{
+				ScopedStats stats(pStats_, "submesh", target, "meshopt_optimizeOverdraw");
+				if (!new_vertex_buffer.empty())
+				{
+					meshopt_optimizeOverdraw(new_index_buffer.data(), new_index_buffer.data(), new_index_buffer.size(), &new_vertex_buffer[0].pos.x, new_vertex_buffer.size(), sizeof(Vertex), options.overdrawThreshold);
+				}
+			}
+			Analyze();
+		}
+		if (options.passes & OptimizePass::VertexFetch)
+		{
+			{
+				ScopedStats stats(pStats_, "submesh", target, "meshopt_optimizeVertexFetch");
+				meshopt_optimizeVertexFetch(new_vertex_buffer.data(), new_index_buffer.data(), new_index_buffer.size(), new_vertex_buffer.data(), new_vertex_buffer.size(), sizeof(Vertex));
+			}
+			Analyze();
+		}
 
 		// swap.
 		submesh->vertexBuffer_.swap(new_vertex_buffer);
 		submesh->indexBuffer_.swap(new_index_buffer);
+	});
+
+	if (options.analyze)
+	{
+		AppendPassMetrics(pass_names, counters, passMetrics_);
 	}
 }
 
-void MeshWork::BuildMeshlets()
+const float kSimplifyAttributeWeights[kSimplifyAttributeCount] = {
+	0.5f, 0.5f, 0.5f,			// normal
+	0.0f, 0.0f, 0.0f, 0.0f,		// tangent
+	1.0f, 1.0f,					// uv
+};
+static_assert(offsetof(Vertex, uv) - offsetof(Vertex, normal) == sizeof(float) * 7, "Vertex layout is changed.");
+
+void MeshWork::BuildLods(uint32_t lodCount, float lodRatio, float maxError)
 {
-	for (auto&& submesh : submeshes_)
+	ParallelFor(pJobSystem_, submeshes_.size(), [&](size_t submesh_index)
+	{
+		auto&& submesh = submeshes_[submesh_index];
+		ScopedStats stats(pStats_, "submesh", std::to_string(submesh_index), "meshopt_simplifyWithAttributes");
+
+		submesh->lods_.clear();
+		if (submesh->vertexBuffer_.empty())
+		{
+			return;
+		}
+		float error_scale = meshopt_simplifyScale(&submesh->vertexBuffer_[0].pos.x, submesh->vertexBuffer_.size(), sizeof(Vertex));
+
+		// every level is simplified from LOD 0, so that the error is not accumulated.
+		size_t prev_count = submesh->indexBuffer_.size();
+		for (uint32_t level = 1; level < lodCount; level++)
+		{
+			size_t target_count = (size_t)((float)prev_count * lodRatio) / 3 * 3;
+			if (target_count < 3)
+			{
+				break;
+			}
+
+			SubmeshLod lod;
+			lod.indexBuffer.resize(submesh->indexBuffer_.size());
+			float result_error = 0.0f;
+			size_t count = meshopt_simplifyWithAttributes(
+				lod.indexBuffer.data(),
+				submesh->indexBuffer_.data(), submesh->indexBuffer_.size(),
+				&submesh->vertexBuffer_[0].pos.x, submesh->vertexBuffer_.size(), sizeof(Vertex),
+				&submesh->vertexBuffer_[0].normal.x, sizeof(Vertex), kSimplifyAttributeWeights, kSimplifyAttributeCount,
+				nullptr,
+				target_count, maxError, 0, &result_error);
+
+			// stop if the simplifier can not reduce triangles any more within the error.
+			if (count == 0 || count >= prev_count * 19 / 20)
+			{
+				break;
+			}
+			lod.indexBuffer.resize(count);
+			lod.error = result_error * error_scale;
+			meshopt_optimizeVertexCache(lod.indexBuffer.data(), lod.indexBuffer.data(), lod.indexBuffer.size(), submesh->vertexBuffer_.size());
+
+			prev_count = count;
+			submesh->lods_.push_back(std::move(lod));
+		}
+	});
+}
+
+namespace
+{
+	// meshlets of meshoptimizer.
+	struct RawMeshlets
+	{
+		std::vector<meshopt_Meshlet>	meshlets;
+		std::vector<unsigned int>		vertices;
+		std::vector<unsigned char>		triangles;
+	};	// struct RawMeshlets
+
+	void BuildRawMeshlets(const std::vector<Vertex>& vertexBuffer, const std::vector<uint32_t>& indexBuffer, const MeshletOptions& options, RawMeshlets& outMeshlets)
+	{
+		size_t max_vertices = options.maxVertices;
+		size_t max_triangles = options.maxTriangles;
+		// flex meshlets may be split down to the half of the triangle limit.
+		size_t min_triangles = std::max<size_t>(max_triangles / 2 & ~(size_t)3, 4);
+
+		size_t max_meshlets = meshopt_buildMeshletsBound(indexBuffer.size(), max_vertices, options.mode == MeshletMode::Flex ? min_triangles : max_triangles);
+		outMeshlets.meshlets.resize(max_meshlets);
+		outMeshlets.vertices.resize(max_meshlets * max_vertices);
+		outMeshlets.triangles.resize(max_meshlets * max_triangles * 3);
+		if (indexBuffer.empty())
+		{
+			outMeshlets.meshlets.clear();
+			return;
+		}
+
+		size_t count = 0;
+		switch (options.mode)
+		{
+		case MeshletMode::Cone:
+			count = meshopt_buildMeshlets(outMeshlets.meshlets.data(), outMeshlets.vertices.data(), outMeshlets.triangles.data(),
+				indexBuffer.data(), indexBuffer.size(), &vertexBuffer[0].pos.x, vertexBuffer.size(), sizeof(Vertex),
+				max_vertices, max_triangles, options.coneWeight);
+			break;
+		case MeshletMode::Flex:
+			count = meshopt_buildMeshletsFlex(outMeshlets.meshlets.data(), outMeshlets.vertices.data(), outMeshlets.triangles.data(),
+				indexBuffer.data(), indexBuffer.size(), &vertexBuffer[0].pos.x, vertexBuffer.size(), sizeof(Vertex),
+				max_vertices, min_triangles, max_triangles, 0.0f, options.splitFactor);
+			break;
+		default:
+			count = meshopt_buildMeshletsScan(outMeshlets.meshlets.data(), outMeshlets.vertices.data(), outMeshlets.triangles.data(),
+				indexBuffer.data(), indexBuffer.size(), vertexBuffer.size(), max_vertices, max_triangles);
+			break;
+		}
+		outMeshlets.meshlets.resize(count);
+	}
+
+	// sums of the score terms. they are summed over submeshes and converted to MeshletScore.
+	struct MeshletScoreCounter
 	{
-		// build meshlets.
-		static const size_t kMaxMeshletVertex = 64;
-		static const size_t kMaxMeshletTriangle = 126;
-		std::vector<meshopt_Meshlet> meshlets;
-		meshlets.resize(meshopt_buildMeshletsBound(submesh->indexBuffer_.size(), kMaxMeshletVertex, kMaxMeshletTriangle));
-		meshopt_buildMeshlets(meshlets.data(), submesh->indexBuffer_.data(), submesh->indexBuffer_.size(), submesh->vertexBuffer_.size(), kMaxMeshletVertex, kMaxMeshletTriangle);
+		double		fill = 0.0;				// sum of meshlets.
+		double		cone = 0.0;				// sum of meshlets.
+		double		triangleArea = 0.0;
+		double		sphereArea = 0.0;		// sum of the cross sections of the bounding spheres.
+		uint64_t	meshletCount = 0;
+
+		void Add(const MeshletScoreCounter& c)
+		{
+			fill += c.fill;
+			cone += c.cone;
+			triangleArea += c.triangleArea;
+			sphereArea += c.sphereArea;
+			meshletCount += c.meshletCount;
+		}
 
-		// create work meshlets.
-		for (auto&& meshlet : meshlets)
+		MeshletScore ToScore() const
+		{
+			MeshletScore ret;
+			if (meshletCount > 0)
+			{
+				ret.fill = fill / (double)meshletCount;
+				ret.cone = cone / (double)meshletCount;
+				ret.tightness = sphereArea > 0.0 ? std::min(triangleArea / sphereArea, 1.0) : 0.0;
+				ret.total = (ret.fill + ret.tightness + ret.cone) / 3.0;
+			}
+			return ret;
+		}
+	};	// struct MeshletScoreCounter
+
+	MeshletScoreCounter ScoreMeshlets(const std::vector<Vertex>& vertexBuffer, const RawMeshlets& meshlets, const MeshletOptions& options)
+	{
+		static const double kPi = 3.14159265358979323846;
+
+		MeshletScoreCounter ret;
+		for (auto&& meshlet : meshlets.meshlets)
 		{
 			if (meshlet.triangle_count == 0)
 			{
 				continue;
 			}
 
-			std::vector<Vertex> this_vtx;
+			const unsigned int* vertices = &meshlets.vertices[meshlet.vertex_offset];
+			const unsigned char* triangles = &meshlets.triangles[meshlet.triangle_offset];
+			auto bounds = meshopt_computeMeshletBounds(vertices, triangles, meshlet.triangle_count, &vertexBuffer[0].pos.x, vertexBuffer.size(), sizeof(Vertex));
+
+			double area = 0.0;
+			for (uint32_t i = 0; i < meshlet.triangle_count; i++)
+			{
+				DirectX::XMVECTOR p0 = DirectX::XMLoadFloat3(&vertexBuffer[vertices[triangles[i * 3 + 0]]].pos);
+				DirectX::XMVECTOR p1 = DirectX::XMLoadFloat3(&vertexBuffer[vertices[triangles[i * 3 + 1]]].pos);
+				DirectX::XMVECTOR p2 = DirectX::XMLoadFloat3(&vertexBuffer[vertices[triangles[i * 3 + 2]]].pos);
+				DirectX::XMVECTOR c = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(p1, p0), DirectX::XMVectorSubtract(p2, p0));
+				area += 0.5 * (double)DirectX::XMVectorGetX(DirectX::XMVector3Length(c));
+			}
+
+			ret.fill += 0.5 * ((double)meshlet.vertex_count / (double)options.maxVertices + (double)meshlet.triangle_count / (double)options.maxTriangles);
+			ret.cone += 1.0 - std::min(std::max((double)bounds.cone_cutoff, 0.0), 1.0);
+			ret.triangleArea += area;
+			ret.sphereArea += kPi * (double)bounds.radius * (double)bounds.radius;
+			ret.meshletCount++;
+		}
+		return ret;
+	}
+
+	// candidates of auto tuning.
+	std::vector<MeshletOptions> GetTuningCandidates(const MeshletOptions& base)
+	{
+		static const uint32_t kLimits[][2] = {
+			{ 64, 64 },
+			{ 64, 124 },
+			{ 128, 128 },
+			{ 128, 256 },
+		};
+		static const uint32_t kModes[] = {
+			MeshletMode::Scan,
+			MeshletMode::Cone,
+			MeshletMode::Flex,
+		};
+
+		std::vector<MeshletOptions> ret;
+		for (auto&& limits : kLimits)
+		{
+			for (auto mode : kModes)
+			{
+				MeshletOptions options = base;
+				options.maxVertices = limits[0];
+				options.maxTriangles = limits[1];
+				options.mode = mode;
+				options.autoTune = false;
+				ret.push_back(options);
+			}
+		}
+		return ret;
+	}
+
+	// build meshlets of the index buffer.
+	// the index buffer is replaced with the triangles of the meshlets in order.
+	// it is not changed only in MeshletMode::Scan without optimizeOrder.
+	void BuildMeshletsFromIndices(
+		const std::vector<Vertex>& vertexBuffer,
+		const MeshletOptions& options,
+		bool optimizeOrder,
+		std::vector<uint32_t>& indexBuffer,
+		std::vector<Meshlet>& outMeshlets,
+		std::vector<uint8_t>& outPrimitives,
+		std::vector<uint32_t>& outVertexIndexBuffer)
+	{
+		RawMeshlets raw;
+		BuildRawMeshlets(vertexBuffer, indexBuffer, options, raw);
+
+		// raw meshlets have all triangles, so the index buffer can be rewritten in place.
+		size_t index_count = indexBuffer.size();
+		indexBuffer.clear();
+		outMeshlets.clear();
+		outPrimitives.clear();
+		outVertexIndexBuffer.clear();
+		outPrimitives.reserve(index_count);
+		for (auto&& meshlet : raw.meshlets)
+		{
+			if (meshlet.triangle_count == 0)
+			{
+				continue;
+			}
 
+			if (optimizeOrder)
+			{
+				meshopt_optimizeMeshlet(&raw.vertices[meshlet.vertex_offset], &raw.triangles[meshlet.triangle_offset], meshlet.triangle_count, meshlet.vertex_count);
+			}
+			const unsigned int* vertices = &raw.vertices[meshlet.vertex_offset];
+			const unsigned char* triangles = &raw.triangles[meshlet.triangle_offset];
 			// copy indices.
 			Meshlet work;
-			work.indexOffset = (uint32_t)submesh->meshletIndexBuffer_.size();
+			work.indexOffset = (uint32_t)indexBuffer.size();
 			work.indexCount = meshlet.triangle_count * 3;
-			work.primitiveOffset = (uint32_t)submesh->meshletPackedPrimitive_.size();
+			work.primitiveOffset = (uint32_t)outPrimitives.size() / 3;
 			work.primitiveCount = meshlet.triangle_count;
-			work.vertexIndexOffset = (uint32_t)submesh->meshletVertexIndexBuffer_.size();
+			work.vertexIndexOffset = (uint32_t)outVertexIndexBuffer.size();
 			work.vertexIndexCount = meshlet.vertex_count;
-			for (uint8_t i = 0; i < meshlet.triangle_count; i++)
+			for (uint32_t i = 0; i < meshlet.triangle_count * 3; i++)
 			{
-				uint32_t i0 = meshlet.indices[i][0];
-				uint32_t i1 = meshlet.indices[i][1];
-				uint32_t i2 = meshlet.indices[i][2];
-
-				submesh->meshletIndexBuffer_.push_back(meshlet.vertices[i0]);
-				submesh->meshletIndexBuffer_.push_back(meshlet.vertices[i1]);
-				submesh->meshletIndexBuffer_.push_back(meshlet.vertices[i2]);
-
-				submesh->meshletPackedPrimitive_.push_back((i2 << 20) | (i1 << 10) | i0);
-
-				this_vtx.push_back(submesh->vertexBuffer_[meshlet.vertices[meshlet.indices[i][0]]]);
-				this_vtx.push_back(submesh->vertexBuffer_[meshlet.vertices[meshlet.indices[i][1]]]);
-				this_vtx.push_back(submesh->vertexBuffer_[meshlet.vertices[meshlet.indices[i][2]]]);
+				indexBuffer.push_back(vertices[triangles[i]]);
 			}
-			for (uint8_t i = 0; i < meshlet.vertex_count; i++)
+			outPrimitives.insert(outPrimitives.end(), triangles, triangles + meshlet.triangle_count * 3);
+			for (uint32_t i = 0; i < meshlet.vertex_count; i++)
 			{
-				submesh->meshletVertexIndexBuffer_.push_back(meshlet.vertices[i]);
+				outVertexIndexBuffer.push_back(vertices[i]);
 			}
 
 			// compute bounds.
-			auto bounds = meshopt_computeMeshletBounds(&meshlet, &submesh->vertexBuffer_[0].pos.x, submesh->vertexBuffer_.size(), sizeof(Vertex));
+			auto bounds = meshopt_computeMeshletBounds(vertices, triangles, meshlet.triangle_count, &vertexBuffer[0].pos.x, vertexBuffer.size(), sizeof(Vertex));
 			work.boundingSphere.center.x = bounds.center[0];
 			work.boundingSphere.center.y = bounds.center[1];
 			work.boundingSphere.center.z = bounds.center[2];
@@ -629,31 +1381,280 @@ void MeshWork::BuildMeshlets()
 			work.cone.axis.z = bounds.cone_axis[2];
 			work.cone.cutoff = bounds.cone_cutoff;
 
-			DirectX::XMVECTOR aabbMin = DirectX::XMLoadFloat3(&this_vtx[0].pos);
-			DirectX::XMVECTOR aabbMax = DirectX::XMLoadFloat3(&this_vtx[0].pos);
-			for (auto&& v : this_vtx)
+			DirectX::XMVECTOR aabbMin = DirectX::XMLoadFloat3(&vertexBuffer[vertices[0]].pos);
+			DirectX::XMVECTOR aabbMax = aabbMin;
+			for (uint32_t i = 1; i < meshlet.vertex_count; i++)
 			{
-				DirectX::XMVECTOR p = DirectX::XMLoadFloat3(&v.pos);
+				DirectX::XMVECTOR p = DirectX::XMLoadFloat3(&vertexBuffer[vertices[i]].pos);
 				aabbMin = DirectX::XMVectorMin(aabbMin, p);
 				aabbMax = DirectX::XMVectorMax(aabbMax, p);
 			}
 			DirectX::XMStoreFloat3(&work.boundingBox.aabbMin, aabbMin);
 			DirectX::XMStoreFloat3(&work.boundingBox.aabbMax, aabbMax);
 
-			submesh->meshlets_.push_back(work);
+			outMeshlets.push_back(work);
 		}
+		if (indexBuffer.size() != index_count)
+		{
+			fprintf(stderr, "There is a difference between index buffer and meshlet triangles.\n");
+		}
+	}
+}
 
-		// check.
-		size_t count = submesh->indexBuffer_.size();
-		for (size_t i = 0; i < count; i++)
+void MeshWork::BuildMeshlets(const MeshletOptions& meshletOptions, const OptimizeOptions& optimizeOptions)
+{
+	meshletOptions_ = meshletOptions;
+	meshletCandidates_.clear();
+	if (meshletOptions.autoTune)
+	{
+		// score LOD 0 of all submeshes with each candidate.
+		ScopedStats stats(pStats_, "TuneMeshlets");
+		auto candidates = GetTuningCandidates(meshletOptions);
+		std::vector<MeshletScoreCounter> counters(candidates.size() * submeshes_.size());
+		ParallelFor(pJobSystem_, counters.size(), [&](size_t index)
+		{
+			auto&& options = candidates[index / submeshes_.size()];
+			auto&& submesh = submeshes_[index % submeshes_.size()];
+			RawMeshlets raw;
+			BuildRawMeshlets(submesh->vertexBuffer_, submesh->indexBuffer_, options, raw);
+			counters[index] = ScoreMeshlets(submesh->vertexBuffer_, raw, options);
+		});
+
+		// submeshes are summed in order, and the first of the same scores is used, so the result does not depend on the thread count.
+		size_t best_index = 0;
+		for (size_t i = 0; i < candidates.size(); i++)
 		{
-			if (submesh->indexBuffer_[i] != submesh->meshletIndexBuffer_[i])
+			MeshletScoreCounter sum;
+			for (size_t j = 0; j < submeshes_.size(); j++)
 			{
-				fprintf(stderr, "There is a difference between index buffer and meshlet index buffer.\n");
+				sum.Add(counters[i * submeshes_.size() + j]);
 			}
+			MeshletCandidate candidate;
+			candidate.options = candidates[i];
+			candidate.score = sum.ToScore();
+			meshletCandidates_.push_back(candidate);
+			if (candidate.score.total > meshletCandidates_[best_index].score.total)
+			{
+				best_index = i;
+			}
+		}
+		meshletOptions_ = meshletCandidates_[best_index].options;
+	}
+
+	bool optimize_order = (optimizeOptions.passes & OptimizePass::MeshletOrder) != 0;
+	std::vector<std::vector<MetricsCounter>> counters(submeshes_.size());
+	ParallelFor(pJobSystem_, submeshes_.size(), [&](size_t submesh_index)
+	{
+		auto&& submesh = submeshes_[submesh_index];
+		ScopedStats stats(pStats_, "submesh", std::to_string(submesh_index), "meshopt_buildMeshlets");
+
+		if (optimize_order && optimizeOptions.analyze)
+		{
+			counters[submesh_index].push_back(AnalyzeIndexBuffer(submesh->vertexBuffer_, submesh->indexBuffer_));
+		}
+
+		// meshlets refer the index buffer, so the index buffer follows the triangle order of the meshlets.
+		BuildMeshletsFromIndices(submesh->vertexBuffer_, meshletOptions_, optimize_order,
+			submesh->indexBuffer_, submesh->meshlets_, submesh->meshletPrimitives_, submesh->meshletVertexIndexBuffer_);
+		for (auto&& lod : submesh->lods_)
+		{
+			BuildMeshletsFromIndices(submesh->vertexBuffer_, meshletOptions_, optimize_order,
+				lod.indexBuffer, lod.meshlets, lod.meshletPrimitives, lod.meshletVertexIndexBuffer);
+		}
+
+		if (optimize_order && optimizeOptions.analyze)
+		{
+			counters[submesh_index].push_back(AnalyzeIndexBuffer(submesh->vertexBuffer_, submesh->indexBuffer_));
 		}
+	});
+
+	if (optimize_order && optimizeOptions.analyze)
+	{
+		AppendPassMetrics({ "MeshletOrder" }, counters, passMetrics_);
 	}
 }
 
+void MeshWork::BuildClusterDag(const MeshletOptions& meshletOptions)
+{
+	meshletOptions_.maxVertices = meshletOptions.maxVertices;
+	meshletOptions_.maxTriangles = meshletOptions.maxTriangles;
+	ParallelFor(pJobSystem_, submeshes_.size(), [&](size_t submesh_index)
+	{
+		auto&& submesh = submeshes_[submesh_index];
+		ScopedStats stats(pStats_, "submesh", std::to_string(submesh_index), "BuildClusterDag");
+
+		BuildSubmeshClusterDag(submesh->vertexBuffer_, submesh->indexBuffer_, meshletOptions.maxVertices, meshletOptions.maxTriangles, pJobSystem_, submesh->dag_);
+	});
+}
+
+void MeshWork::ReleaseSubmeshGeometry(size_t index)
+{
+	auto&& submesh = submeshes_[index];
+	std::vector<Vertex>().swap(submesh->vertexBuffer_);
+	std::vector<uint32_t>().swap(submesh->indexBuffer_);
+	std::vector<Meshlet>().swap(submesh->meshlets_);
+	std::vector<uint8_t>().swap(submesh->meshletPrimitives_);
+	std::vector<uint32_t>().swap(submesh->meshletVertexIndexBuffer_);
+	std::vector<SubmeshLod>().swap(submesh->lods_);
+	submesh->dag_ = SubmeshDag();
+}
+
+bool MeshWork::SaveGeometry(std::ostream& stream) const
+{
+	auto WriteValue = [&](const auto& value)
+	{
+		stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+	};
+	auto WriteVector = [&](const auto& vec)
+	{
+		uint64_t count = vec.size();
+		WriteValue(count);
+		stream.write(reinterpret_cast<const char*>(vec.data()), sizeof(vec[0]) * count);
+	};
+
+	WriteValue(kGeometryVersion);
+	WriteValue(boundingSphere_);
+	WriteValue(boundingBox_);
+	WriteValue(meshletOptions_);
+	WriteValue((uint64_t)submeshes_.size());
+	for (auto&& submesh : submeshes_)
+	{
+		WriteValue(submesh->materialIndex_);
+		WriteValue(submesh->meshIndex_);
+		WriteVector(submesh->vertexBuffer_);
+		WriteVector(submesh->indexBuffer_);
+		WriteValue(submesh->boundingSphere_);
+		WriteValue(submesh->boundingBox_);
+		WriteVector(submesh->meshlets_);
+		WriteVector(submesh->meshletPrimitives_);
+		WriteVector(submesh->meshletVertexIndexBuffer_);
+		WriteValue((uint64_t)submesh->lods_.size());
+		for (auto&& lod : submesh->lods_)
+		{
+			WriteVector(lod.indexBuffer);
+			WriteValue(lod.error);
+			WriteVector(lod.meshlets);
+			WriteVector(lod.meshletPrimitives);
+			WriteVector(lod.meshletVertexIndexBuffer);
+		}
+		WriteVector(submesh->dag_.clusters);
+		WriteVector(submesh->dag_.indexBuffer);
+		WriteVector(submesh->dag_.primitives);
+		WriteVector(submesh->dag_.vertexIndexBuffer);
+		WriteValue(submesh->dag_.levelCount);
+	}
+	return stream.good();
+}
+
+bool MeshWork::LoadGeometry(std::istream& stream)
+{
+	// a truncated or corrupted object must be a cache miss.
+	// counts are checked against the remaining size, so that they do not cause huge allocations.
+	auto start_pos = stream.tellg();
+	stream.seekg(0, std::ios::end);
+	auto end_pos = stream.tellg();
+	stream.seekg(start_pos);
+	if (start_pos < 0 || end_pos < start_pos || !stream.good())
+	{
+		return false;
+	}
+	uint64_t remaining_size = (uint64_t)(end_pos - start_pos);
+
+	auto ReadValue = [&](auto& value)
+	{
+		if (remaining_size < sizeof(value))
+		{
+			return false;
+		}
+		stream.read(reinterpret_cast<char*>(&value), sizeof(value));
+		remaining_size -= sizeof(value);
+		return stream.good();
+	};
+	auto ReadVector = [&](auto& vec)
+	{
+		uint64_t count;
+		if (!ReadValue(count) || count > remaining_size / sizeof(vec[0]))
+		{
+			return false;
+		}
+		vec.resize((size_t)count);
+		stream.read(reinterpret_cast<char*>(vec.data()), sizeof(vec[0]) * count);
+		remaining_size -= sizeof(vec[0]) * count;
+		return stream.good();
+	};
+
+	uint32_t version;
+	if (!ReadValue(version) || version != kGeometryVersion)
+	{
+		return false;
+	}
+
+	BoundSphere sphere;
+	BoundBox box;
+	MeshletOptions meshlet_options;
+	uint64_t submesh_count;
+	if (!ReadValue(sphere) || !ReadValue(box) || !ReadValue(meshlet_options) || !ReadValue(submesh_count))
+	{
+		return false;
+	}
+	std::vector<std::unique_ptr<SubmeshWork>> submeshes;
+	for (uint64_t i = 0; i < submesh_count; i++)
+	{
+		std::unique_ptr<SubmeshWork> work(new SubmeshWork());
+		bool result = ReadValue(work->materialIndex_)
+			&& ReadValue(work->meshIndex_)
+			&& ReadVector(work->vertexBuffer_)
+			&& ReadVector(work->indexBuffer_)
+			&& ReadValue(work->boundingSphere_)
+			&& ReadValue(work->boundingBox_)
+			&& ReadVector(work->meshlets_)
+			&& ReadVector(work->meshletPrimitives_)
+			&& ReadVector(work->meshletVertexIndexBuffer_);
+		uint64_t lod_count = 0;
+		if (!result || !ReadValue(lod_count) || lod_count > remaining_size)
+		{
+			return false;
+		}
+		if (!IsValidIndices(work->indexBuffer_, work->vertexBuffer_.size()))
+		{
+			return false;
+		}
+		work->lods_.resize((size_t)lod_count);
+		for (auto&& lod : work->lods_)
+		{
+			result = ReadVector(lod.indexBuffer)
+				&& ReadValue(lod.error)
+				&& ReadVector(lod.meshlets)
+				&& ReadVector(lod.meshletPrimitives)
+				&& ReadVector(lod.meshletVertexIndexBuffer);
+			if (!result || !IsValidIndices(lod.indexBuffer, work->vertexBuffer_.size()))
+			{
+				return false;
+			}
+		}
+		result = ReadVector(work->dag_.clusters)
+			&& ReadVector(work->dag_.indexBuffer)
+			&& ReadVector(work->dag_.primitives)
+			&& ReadVector(work->dag_.vertexIndexBuffer)
+			&& ReadValue(work->dag_.levelCount);
+		if (!result)
+		{
+			return false;
+		}
+		if (!instancedMeshes_.empty() && work->meshIndex_ >= instancedMeshes_.size())
+		{
+			return false;
+		}
+		submeshes.push_back(std::move(work));
+	}
+
+	boundingSphere_ = sphere;
+	boundingBox_ = box;
+	meshletOptions_ = meshlet_options;
+	submeshes_.swap(submeshes);
+	UpdateInstancedMeshes();
+	return true;
+}
+
 
 //	EOF
@@ -1,6 +1,8 @@
 ﻿#pragma once
 
 #include <algorithm>
+#include <istream>
+#include <ostream>
 #include "GLTFSDK/GLTF.h"
 #include "GLTFSDK/GLBResourceReader.h"
 #include "GLTFSDK/Deserialize.h"
@@ -8,6 +10,13 @@
 #include "mikktspace.h"
 #include <DirectXMath.h>
 
+// meshopt_buildMeshletsFlex and meshopt_computeSphereBounds are added in 0.23, and vertex_lock of meshopt_simplifyWithAttributes in 0.22.
+static_assert(MESHOPTIMIZER_VERSION >= 230, "meshoptimizer 0.23 or later is required.");
+
+#include "job_system.h"
+#include "content_hash.h"
+#include "stats.h"
+
 
 struct Vertex
 {
@@ -36,6 +45,8 @@ struct Cone
 	float				cutoff;
 };
 
+// triangles of a meshlet are 3 local vertex indices (uint8) each, and primitiveOffset is a triangle offset.
+// the index buffer holds the same triangles in the same order, so indexOffset is always primitiveOffset * 3.
 struct Meshlet
 {
 	uint32_t				indexOffset;
@@ -49,6 +60,136 @@ struct Meshlet
 	Cone					cone;
 };	// struct Meshlet
 
+// a simplified level of a submesh. it shares the vertex buffer of the submesh.
+// offsets of the meshlets are relative to the buffers of this level.
+struct SubmeshLod
+{
+	std::vector<uint32_t>	indexBuffer;
+	float					error;				// geometric error in mesh space.
+
+	std::vector<Meshlet>	meshlets;
+	std::vector<uint8_t>	meshletPrimitives;
+	std::vector<uint32_t>	meshletVertexIndexBuffer;
+};	// struct SubmeshLod
+
+// cluster of the hierarchical LOD DAG.
+// the runtime draws a cluster if its error is acceptable and the error of its parents is not.
+// errors and bounds are monotonic from children to parents, so one cut of the DAG is drawn without cracks.
+struct DagCluster
+{
+	Meshlet					meshlet;			// offsets are relative to the buffers of SubmeshDag.
+	uint32_t				level;				// 0 is the original geometry.
+	BoundSphere				lodBounds;			// bounds of the group which generated this cluster.
+	float					error;				// geometric error in mesh space. 0 at level 0.
+	BoundSphere				parentLodBounds;
+	float					parentError;		// FLT_MAX if this cluster is a root.
+};	// struct DagCluster
+
+// hierarchical cluster DAG of a submesh. it shares the vertex buffer of the submesh.
+struct SubmeshDag
+{
+	std::vector<DagCluster>	clusters;			// sorted by level.
+	std::vector<uint32_t>	indexBuffer;
+	std::vector<uint8_t>	primitives;
+	std::vector<uint32_t>	vertexIndexBuffer;
+	uint32_t				levelCount = 0;
+};	// struct SubmeshDag
+
+// attribute weights for meshopt_simplifyWithAttributes.
+// attributes are normal, tangent and uv, which are contiguous from Vertex::normal.
+static const size_t kSimplifyAttributeCount = 9;
+extern const float kSimplifyAttributeWeights[kSimplifyAttributeCount];
+
+// unique mesh in instancing mode. submeshes of a mesh are contiguous.
+struct InstancedMesh
+{
+	uint32_t				submeshOffset;
+	uint32_t				submeshCount;
+};	// struct InstancedMesh
+
+// a node which refers a mesh in instancing mode.
+struct MeshInstance
+{
+	DirectX::XMFLOAT4X4		transform;			// mesh space to world space. (row vector)
+	uint32_t				meshIndex;			// index of InstancedMesh.
+};	// struct MeshInstance
+
+// build modes of meshlets.
+struct MeshletMode
+{
+	enum Type : uint32_t
+	{
+		Scan,			// meshopt_buildMeshletsScan. keeps the order of the index buffer, which is the best for vertex cache.
+		Cone,			// meshopt_buildMeshlets with cone weight. narrower normal cones for backface culling.
+		Flex,			// meshopt_buildMeshletsFlex. splits meshlets with large bounds for frustum and occlusion culling.
+
+		Max
+	};
+};	// struct MeshletMode
+
+struct MeshletOptions
+{
+	uint32_t	maxVertices = 64;				// up to 256.
+	uint32_t	maxTriangles = 124;				// up to 256. a multiple of 4.
+	uint32_t	mode = MeshletMode::Scan;		// MeshletMode::Type
+	float		coneWeight = 0.25f;				// Cone only. 0 is spatial, 1 is normal cone.
+	float		splitFactor = 2.0f;				// Flex only. meshlets larger than this times the average radius are split.
+	bool		autoTune = false;				// try the built-in limits and modes, and build with the best score.
+};	// struct MeshletOptions
+
+// quality of meshlets. each term is in [0, 1] and larger is better.
+struct MeshletScore
+{
+	double		fill = 0.0;			// used vertices and triangles per the limits.
+	double		tightness = 0.0;	// triangle area per the cross section of the bounding sphere.
+	double		cone = 0.0;			// 1 - cone cutoff. (the ratio of view directions which can cull the meshlet)
+	double		total = 0.0;		// average of the terms.
+};	// struct MeshletScore
+
+struct MeshletCandidate
+{
+	MeshletOptions	options;
+	MeshletScore	score;
+};	// struct MeshletCandidate
+
+// optimization passes of OptimizeSubmesh() and BuildMeshlets().
+struct OptimizePass
+{
+	enum Type : uint32_t
+	{
+		VertexCache		= 0x1 << 0,		// meshopt_optimizeVertexCache.
+		Overdraw		= 0x1 << 1,		// meshopt_optimizeOverdraw. runs after VertexCache.
+		VertexFetch		= 0x1 << 2,		// meshopt_optimizeVertexFetch.
+		MeshletOrder	= 0x1 << 3,		// meshopt_optimizeMeshlet. runs in BuildMeshlets().
+
+		Default			= VertexCache | VertexFetch,
+	};
+};	// struct OptimizePass
+
+struct OptimizeOptions
+{
+	uint32_t	passes = OptimizePass::Default;		// combination of OptimizePass.
+	float		overdrawThreshold = 1.05f;			// ACMR increase allowed for the overdraw pass.
+	bool		analyze = false;					// record PassMetrics of each pass.
+};	// struct OptimizeOptions
+
+// efficiency of the index and vertex buffers by meshoptimizer analyzers.
+struct MeshMetrics
+{
+	double		acmr = 0.0;			// transformed vertices per triangle. (16 entries FIFO cache)
+	double		atvr = 0.0;			// transformed vertices per vertex.
+	double		overdraw = 0.0;		// shaded pixels per covered pixel.
+	double		overfetch = 0.0;	// fetched bytes per vertex buffer bytes. (sizeof(Vertex) and 64 bytes cache line)
+};	// struct MeshMetrics
+
+// metrics of all submeshes before and after a pass. LODs are not included.
+struct PassMetrics
+{
+	std::string		pass;
+	MeshMetrics		before;
+	MeshMetrics		after;
+};	// struct PassMetrics
+
 struct NodeWork
 {
 	DirectX::XMFLOAT4X4		transformLocal;
@@ -71,6 +212,11 @@ public:
 	{
 		return materialIndex_;
 	}
+	// index of InstancedMesh. always 0 if instancing is disabled.
+	uint32_t GetMeshIndex() const
+	{
+		return meshIndex_;
+	}
 	const std::vector<Vertex>& GetVertexBuffer() const
 	{
 		return vertexBuffer_;
@@ -79,9 +225,10 @@ public:
 	{
 		return indexBuffer_;
 	}
-	const std::vector<uint32_t>& GetPackedPrimitive() const
+	// 3 local vertex indices per triangle of the meshlets.
+	const std::vector<uint8_t>& GetMeshletPrimitives() const
 	{
-		return meshletPackedPrimitive_;
+		return meshletPrimitives_;
 	}
 	const std::vector<uint32_t>& GetVertexIndexBuffer() const
 	{
@@ -99,18 +246,31 @@ public:
 	{
 		return meshlets_;
 	}
+	// LOD 1 or later. LOD 0 is the submesh itself.
+	const std::vector<SubmeshLod>& GetLods() const
+	{
+		return lods_;
+	}
+	const SubmeshDag& GetDag() const
+	{
+		return dag_;
+	}
 
 private:
 	int						materialIndex_;
+	uint32_t				meshIndex_ = 0;
 	std::vector<Vertex>		vertexBuffer_;
 	std::vector<uint32_t>	indexBuffer_;
+	bool					hasTangents_ = false;		// tangents are read from the source.
 	BoundSphere				boundingSphere_;
 	BoundBox				boundingBox_;
 
 	std::vector<Meshlet>	meshlets_;
-	std::vector<uint32_t>	meshletIndexBuffer_;
-	std::vector<uint32_t>	meshletPackedPrimitive_;
+	std::vector<uint8_t>	meshletPrimitives_;
 	std::vector<uint32_t>	meshletVertexIndexBuffer_;
+
+	std::vector<SubmeshLod>	lods_;
+	SubmeshDag				dag_;
 };	// class SubmeshWork
 
 class MaterialWork
@@ -143,6 +303,11 @@ public:
 	{
 		return textures_;
 	}
+	// glTF occlusion texture. it is not a texture of the rmesh material, but it can be packed into the ORM texture.
+	const std::string& GetOcclusionTexture() const
+	{
+		return occlusionTexture_;
+	}
 	bool IsOpaque() const
 	{
 		return isOpaque_;
@@ -151,6 +316,7 @@ public:
 private:
 	std::string		name_;
 	std::string		textures_[TextureKind::Max];
+	std::string		occlusionTexture_;
 	bool			isOpaque_;
 };	// class MaterialWork
 
@@ -172,27 +338,90 @@ public:
 	{
 		return binary_;
 	}
+	// if not null, the red channel of this texture is replaced by the red channel of the source. (see MeshWork::PackOcclusionTextures())
+	const TextureWork* GetOcclusionSource() const
+	{
+		return pOcclusionSource_;
+	}
+	// alpha cutoff if this is the base color texture of an alpha mask material, otherwise negative.
+	float GetAlphaCutoff() const
+	{
+		return alphaCutoff_;
+	}
 
 private:
 	std::string				name_;
 	std::vector<uint8_t>	binary_;
+	const TextureWork*		pOcclusionSource_ = nullptr;
+	float					alphaCutoff_ = -1.0f;
 };	// class TextureWork
 
 class MeshWork
 {
 public:
-	MeshWork()
+	// if pJobSystem is null, all stages run serially.
+	// if pStats is not null, timings of each stage are recorded.
+	MeshWork(JobSystem* pJobSystem = nullptr, ConvertStats* pStats = nullptr)
+		: pJobSystem_(pJobSystem), pStats_(pStats)
 	{}
 	~MeshWork()
 	{}
 
-	bool ReadGLTFMesh(const std::string& inputPath, const std::string& inputFile);
+	// if instancing is true, each mesh of the glTF is read once in mesh space, and nodes are read as instances.
+	// otherwise node transforms are baked into the vertices.
+	bool ReadGLTFMesh(const std::string& inputPath, const std::string& inputFile, bool instancing = false);
+
+	// add a submesh without glTF source. (synthetic meshes for benchmarks)
+	void AddSubmesh(int materialIndex, std::vector<Vertex>&& vertexBuffer, std::vector<uint32_t>&& indexBuffer);
+
+	// remove textures which have the same image bytes and kind as a previous texture.
+	// material texture names are remapped to the kept texture. returns the number of removed textures.
+	size_t DeduplicateTextures();
+
+	// pack the occlusion texture of each material into the red channel of its metallic roughness texture,
+	// so the ORM texture has occlusion, roughness and metallic as the glTF convention.
+	// a metallic roughness texture which is used with different occlusion textures is not packed.
+	// returns the number of packed textures.
+	size_t PackOcclusionTextures();
 
+	// GenerateTangents() + ComputeBounds()
+	void GenerateTangentAndBounds();
+
+	// tangents of submeshes which have source tangents or whose material has no normal texture are not generated.
+	// submeshes without material (synthetic meshes) always generate tangents.
+	void GenerateTangents();
+
+	void ComputeBounds();
+
+	// merge submeshes which have the same material. in instancing mode, only submeshes of the same mesh are merged.
 	size_t MergeSubmesh();
 
-	void OptimizeSubmesh();
+	void OptimizeSubmesh(const OptimizeOptions& options = OptimizeOptions());
+
+	// split submeshes which have more than maxVertices vertices, so that they can use uint16 indices.
+	// vertices on the borders are duplicated. returns the number of submeshes which are split.
+	size_t SplitSubmesh(uint32_t maxVertices = 0x10000);
+
+	// build LOD 1 to lodCount-1 of each submesh. each level has about lodRatio triangles of the previous level.
+	// a level whose relative error exceeds maxError is not generated.
+	void BuildLods(uint32_t lodCount, float lodRatio, float maxError);
+
+	// build meshlets of all LODs.
+	// if options has OptimizePass::MeshletOrder, triangles and vertices in each meshlet are reordered, and index buffers follow the meshlet order.
+	// if meshletOptions.autoTune is true, all candidates are scored with LOD 0, and the best one is used.
+	void BuildMeshlets(const MeshletOptions& meshletOptions = MeshletOptions(), const OptimizeOptions& optimizeOptions = OptimizeOptions());
+
+	// build the hierarchical cluster DAG of each submesh for continuous LOD.
+	// clusters have the same limits as meshlets. the mode and autoTune are not used.
+	void BuildClusterDag(const MeshletOptions& meshletOptions = MeshletOptions());
+
+	// free vertex/index/meshlet buffers of the submesh. bounds and material index are kept.
+	void ReleaseSubmeshGeometry(size_t index);
 
-	void BuildMeshlets();
+	// processed geometry for build cache.
+	// bump kGeometryVersion if the layout of SubmeshWork is changed.
+	bool SaveGeometry(std::ostream& stream) const;
+	bool LoadGeometry(std::istream& stream);
 
 	const std::vector<std::unique_ptr<MaterialWork>>& GetMaterials() const
 	{
@@ -206,6 +435,15 @@ public:
 	{
 		return textures_;
 	}
+	// empty if instancing is disabled.
+	const std::vector<InstancedMesh>& GetInstancedMeshes() const
+	{
+		return instancedMeshes_;
+	}
+	const std::vector<MeshInstance>& GetInstances() const
+	{
+		return instances_;
+	}
 	const BoundSphere& GetBoundingSphere() const
 	{
 		return boundingSphere_;
@@ -214,16 +452,54 @@ public:
 	{
 		return boundingBox_;
 	}
+	// options of the meshlets and clusters which are built. autoTune is resolved.
+	const MeshletOptions& GetMeshletOptions() const
+	{
+		return meshletOptions_;
+	}
+	// scored candidates if MeshletOptions::autoTune is true. empty if the geometry is restored by LoadGeometry().
+	const std::vector<MeshletCandidate>& GetMeshletCandidates() const
+	{
+		return meshletCandidates_;
+	}
+	// recorded if OptimizeOptions::analyze is true. empty if the geometry is restored by LoadGeometry().
+	const std::vector<PassMetrics>& GetPassMetrics() const
+	{
+		return passMetrics_;
+	}
+	// hash of the geometry inputs read by ReadGLTFMesh.
+	// materials and textures are not included, except whether the material of each submesh needs tangents.
+	const ContentHash& GetGeometryHash() const
+	{
+		return geometryHash_;
+	}
 
 private:
+	// true if the material of the submesh has a normal texture, or the submesh has no material.
+	bool NeedsTangents(const SubmeshWork& submesh) const;
+
+	// rebuild submesh ranges of instancedMeshes_ from the mesh indices of the submeshes.
+	void UpdateInstancedMeshes();
+
+private:
+	static const uint32_t	kGeometryVersion = 6;
+
+	JobSystem*									pJobSystem_;
+	ConvertStats*								pStats_;
 	std::string									sourceFilePath_;
 	std::vector<NodeWork>						nodes_;
 	std::vector<std::unique_ptr<MaterialWork>>	materials_;
 	std::vector<std::unique_ptr<SubmeshWork>>	submeshes_;
 	std::vector<std::unique_ptr<TextureWork>>	textures_;
+	std::vector<InstancedMesh>					instancedMeshes_;
+	std::vector<MeshInstance>					instances_;
+	std::vector<PassMetrics>					passMetrics_;
+	MeshletOptions								meshletOptions_;
+	std::vector<MeshletCandidate>				meshletCandidates_;
 
 	BoundSphere				boundingSphere_;
 	BoundBox				boundingBox_;
+	ContentHash				geometryHash_;
 };	// class MeshWork
 
 //	EOF
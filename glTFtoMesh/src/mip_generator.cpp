@@ -0,0 +1,380 @@
+﻿#include "mip_generator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_GENERATOR_SSE2
+#include <emmintrin.h>
+#endif
+
+
+namespace
+{
+	// one RGBA pixel in float.
+#if defined(MIP_GENERATOR_SSE2)
+	typedef __m128 Vec4;
+
+	inline Vec4 LoadVec4(const float* p)
+	{
+		return _mm_loadu_ps(p);
+	}
+	inline void StoreVec4(float* p, Vec4 v)
+	{
+		_mm_storeu_ps(p, v);
+	}
+	inline Vec4 ZeroVec4()
+	{
+		return _mm_setzero_ps();
+	}
+	// a * weight + c
+	inline Vec4 MulAddVec4(Vec4 a, float weight, Vec4 c)
+	{
+		return _mm_add_ps(_mm_mul_ps(a, _mm_set1_ps(weight)), c);
+	}
+	inline Vec4 SaturateVec4(Vec4 v)
+	{
+		return _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	}
+#else
+	struct Vec4
+	{
+		float	v[4];
+	};	// struct Vec4
+
+	inline Vec4 LoadVec4(const float* p)
+	{
+		return Vec4{ { p[0], p[1], p[2], p[3] } };
+	}
+	inline void StoreVec4(float* p, Vec4 v)
+	{
+		p[0] = v.v[0]; p[1] = v.v[1]; p[2] = v.v[2]; p[3] = v.v[3];
+	}
+	inline Vec4 ZeroVec4()
+	{
+		return Vec4{ { 0.0f, 0.0f, 0.0f, 0.0f } };
+	}
+	inline Vec4 MulAddVec4(Vec4 a, float weight, Vec4 c)
+	{
+		return Vec4{ { a.v[0] * weight + c.v[0], a.v[1] * weight + c.v[1], a.v[2] * weight + c.v[2], a.v[3] * weight + c.v[3] } };
+	}
+	inline Vec4 SaturateVec4(Vec4 v)
+	{
+		for (auto&& c : v.v)
+		{
+			c = std::min(std::max(c, 0.0f), 1.0f);
+		}
+		return v;
+	}
+#endif
+
+	static const uint32_t kTileSize = 64;
+	static const uint32_t kLinearToSrgbTableSize = 4096;
+
+	// conversion tables between 8 bit values and floats.
+	struct ColorTables
+	{
+		float		toFloat[256];
+		uint8_t		toByte[kLinearToSrgbTableSize + 1];		// indexed by value * kLinearToSrgbTableSize.
+	};	// struct ColorTables
+
+	float SrgbToLinear(float v)
+	{
+		return (v <= 0.04045f) ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float LinearToSrgb(float v)
+	{
+		return (v <= 0.0031308f) ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+	}
+
+	ColorTables BuildColorTables(bool isLinearized)
+	{
+		ColorTables tables;
+		for (int i = 0; i < 256; i++)
+		{
+			tables.toFloat[i] = (isLinearized) ? SrgbToLinear(i / 255.0f) : i / 255.0f;
+		}
+		for (uint32_t i = 0; i <= kLinearToSrgbTableSize; i++)
+		{
+			float v = (float)i / (float)kLinearToSrgbTableSize;
+			tables.toByte[i] = (uint8_t)(((isLinearized) ? LinearToSrgb(v) : v) * 255.0f + 0.5f);
+		}
+		return tables;
+	}
+
+	const ColorTables& GetColorTables(bool isLinearized)
+	{
+		static const ColorTables kTables[2] = { BuildColorTables(false), BuildColorTables(true) };
+		return kTables[isLinearized ? 1 : 0];
+	}
+
+	// taps of a 1D resampling filter. the source range is clamped to the image.
+	struct FilterTap
+	{
+		uint32_t	start;
+		uint32_t	count;
+		uint32_t	weightOffset;
+	};	// struct FilterTap
+
+	struct Filter1D
+	{
+		std::vector<FilterTap>	taps;		// for each destination pixel.
+		std::vector<float>		weights;
+	};	// struct Filter1D
+
+	double BesselI0(double x)
+	{
+		double sum = 1.0, term = 1.0;
+		for (int k = 1; k < 32; k++)
+		{
+			term *= (x * 0.5 / k) * (x * 0.5 / k);
+			sum += term;
+			if (term < sum * 1e-12)
+			{
+				break;
+			}
+		}
+		return sum;
+	}
+
+	// t is in destination pixels.
+	double KaiserSinc(double t)
+	{
+		static const double kRadius = 3.0;
+		static const double kAlpha = 4.0;
+		if (std::fabs(t) >= kRadius)
+		{
+			return 0.0;
+		}
+		double sinc = (std::fabs(t) < 1e-6) ? 1.0 : std::sin(3.14159265358979 * t) / (3.14159265358979 * t);
+		double r = t / kRadius;
+		return sinc * BesselI0(kAlpha * std::sqrt(1.0 - r * r)) / BesselI0(kAlpha);
+	}
+
+	void BuildFilter(uint32_t srcSize, uint32_t dstSize, uint32_t filter, Filter1D& outFilter)
+	{
+		double scale = (double)srcSize / (double)dstSize;
+		double support = (filter == MipFilter::Kaiser) ? 3.0 * scale : 0.5 * scale;
+		std::vector<double> weights;
+		outFilter.taps.resize(dstSize);
+		outFilter.weights.clear();
+		for (uint32_t x = 0; x < dstSize; x++)
+		{
+			double center = (x + 0.5) * scale;
+			int lo = (int)std::floor(center - support);
+			int hi = (int)std::ceil(center + support);
+			int start = std::max(lo, 0);
+			int end = std::min(hi, (int)srcSize - 1);
+			weights.assign(end - start + 1, 0.0);
+			double sum = 0.0;
+			for (int i = lo; i <= hi; i++)
+			{
+				double w;
+				if (filter == MipFilter::Kaiser)
+				{
+					w = KaiserSinc((i + 0.5 - center) / scale);
+				}
+				else
+				{
+					// coverage of [i, i + 1] by the destination pixel.
+					w = std::max(std::min((double)i + 1.0, center + support) - std::max((double)i, center - support), 0.0);
+				}
+				weights[std::min(std::max(i, start), end) - start] += w;
+				sum += w;
+			}
+
+			FilterTap tap;
+			tap.start = (uint32_t)start;
+			tap.count = (uint32_t)(end - start + 1);
+			tap.weightOffset = (uint32_t)outFilter.weights.size();
+			for (auto w : weights)
+			{
+				outFilter.weights.push_back((float)(w / sum));
+			}
+			outFilter.taps[x] = tap;
+		}
+	}
+
+	// filter the tile of dst from src with separable filters.
+	void FilterTile(const RGBAImageView& src, RGBAImage& dst, const Filter1D& filterX, const Filter1D& filterY, const ColorTables& tables, bool isLinearized,
+		uint32_t tileX, uint32_t tileY, std::vector<float>& srcRows, std::vector<float>& rows)
+	{
+		uint32_t x0 = tileX * kTileSize, x1 = std::min(x0 + kTileSize, dst.width);
+		uint32_t y0 = tileY * kTileSize, y1 = std::min(y0 + kTileSize, dst.height);
+		uint32_t src_x0 = filterX.taps[x0].start;
+		uint32_t src_x1 = filterX.taps[x1 - 1].start + filterX.taps[x1 - 1].count;
+		uint32_t src_y0 = filterY.taps[y0].start;
+		uint32_t src_y1 = filterY.taps[y1 - 1].start + filterY.taps[y1 - 1].count;
+		uint32_t src_width = src_x1 - src_x0;
+		uint32_t tile_width = x1 - x0;
+
+		// source pixels to float. color channels are linearized by the table.
+		srcRows.resize((size_t)src_width * 4);
+		rows.resize((size_t)(src_y1 - src_y0) * tile_width * 4);
+		for (uint32_t sy = src_y0; sy < src_y1; sy++)
+		{
+			const uint8_t* pSrc = src.pPixels + ((size_t)sy * src.width + src_x0) * 4;
+			for (uint32_t i = 0; i < src_width * 4; i += 4)
+			{
+				srcRows[i + 0] = tables.toFloat[pSrc[i + 0]];
+				srcRows[i + 1] = tables.toFloat[pSrc[i + 1]];
+				srcRows[i + 2] = tables.toFloat[pSrc[i + 2]];
+				srcRows[i + 3] = pSrc[i + 3] * (1.0f / 255.0f);
+			}
+
+			// horizontal pass.
+			float* pRow = &rows[(size_t)(sy - src_y0) * tile_width * 4];
+			for (uint32_t x = x0; x < x1; x++)
+			{
+				auto&& tap = filterX.taps[x];
+				const float* pWeights = &filterX.weights[tap.weightOffset];
+				const float* pPixel = &srcRows[(size_t)(tap.start - src_x0) * 4];
+				Vec4 sum = ZeroVec4();
+				for (uint32_t i = 0; i < tap.count; i++)
+				{
+					sum = MulAddVec4(LoadVec4(pPixel + i * 4), pWeights[i], sum);
+				}
+				StoreVec4(pRow + (x - x0) * 4, sum);
+			}
+		}
+
+		// vertical pass.
+		for (uint32_t y = y0; y < y1; y++)
+		{
+			auto&& tap = filterY.taps[y];
+			const float* pWeights = &filterY.weights[tap.weightOffset];
+			uint8_t* pDst = &dst.pixels[((size_t)y * dst.width + x0) * 4];
+			for (uint32_t x = 0; x < tile_width; x++)
+			{
+				const float* pPixel = &rows[((size_t)(tap.start - src_y0) * tile_width + x) * 4];
+				Vec4 sum = ZeroVec4();
+				for (uint32_t i = 0; i < tap.count; i++)
+				{
+					sum = MulAddVec4(LoadVec4(pPixel + (size_t)i * tile_width * 4), pWeights[i], sum);
+				}
+				float value[4];
+				StoreVec4(value, SaturateVec4(sum));
+				for (int c = 0; c < 3; c++)
+				{
+					pDst[x * 4 + c] = (isLinearized)
+						? tables.toByte[(uint32_t)(value[c] * kLinearToSrgbTableSize + 0.5f)]
+						: (uint8_t)(value[c] * 255.0f + 0.5f);
+				}
+				pDst[x * 4 + 3] = (uint8_t)(value[3] * 255.0f + 0.5f);
+			}
+		}
+	}
+
+	void BuildAlphaHistogram(const RGBAImageView& image, uint32_t* pHistogram)
+	{
+		std::fill(pHistogram, pHistogram + 256, 0);
+		size_t count = (size_t)image.width * image.height;
+		for (size_t i = 0; i < count; i++)
+		{
+			pHistogram[image.pPixels[i * 4 + 3]]++;
+		}
+	}
+
+	// ratio of the pixels which pass the alpha test after alpha is scaled.
+	float ComputeAlphaCoverage(const uint32_t* pHistogram, float alphaCutoff, float scale)
+	{
+		uint64_t total = 0, passed = 0;
+		for (int a = 0; a < 256; a++)
+		{
+			total += pHistogram[a];
+			if (std::min(a * scale, 255.0f) >= alphaCutoff * 255.0f)
+			{
+				passed += pHistogram[a];
+			}
+		}
+		return (total > 0) ? (float)passed / (float)total : 0.0f;
+	}
+
+	// scale alpha of the mip, so that its coverage is close to the target.
+	void PreserveAlphaCoverage(RGBAImage& mip, float alphaCutoff, float targetCoverage)
+	{
+		uint32_t histogram[256];
+		BuildAlphaHistogram(mip.GetView(), histogram);
+
+		// coverage is monotonic in the scale.
+		float lo = 0.0f, hi = 4.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			float mid = (lo + hi) * 0.5f;
+			if (ComputeAlphaCoverage(histogram, alphaCutoff, mid) < targetCoverage)
+			{
+				lo = mid;
+			}
+			else
+			{
+				hi = mid;
+			}
+		}
+		float scale = hi;
+
+		uint8_t table[256];
+		for (int a = 0; a < 256; a++)
+		{
+			table[a] = (uint8_t)std::min(a * scale + 0.5f, 255.0f);
+		}
+		size_t count = (size_t)mip.width * mip.height;
+		for (size_t i = 0; i < count; i++)
+		{
+			mip.pixels[i * 4 + 3] = table[mip.pixels[i * 4 + 3]];
+		}
+	}
+}
+
+void GenerateMips(const RGBAImageView& top, bool isSrgb, const MipOptions& options, JobSystem* pJobSystem, std::vector<RGBAImage>& outMips)
+{
+	outMips.clear();
+	if (top.width == 0 || top.height == 0)
+	{
+		return;
+	}
+
+	bool is_linearized = isSrgb && options.gammaCorrect;
+	const ColorTables& tables = GetColorTables(is_linearized);
+
+	bool preserve_coverage = options.alphaCutoff >= 0.0f;
+	float target_coverage = 0.0f;
+	if (preserve_coverage)
+	{
+		uint32_t histogram[256];
+		BuildAlphaHistogram(top, histogram);
+		target_coverage = ComputeAlphaCoverage(histogram, options.alphaCutoff, 1.0f);
+	}
+
+	RGBAImageView src = top;
+	while (src.width > 1 || src.height > 1)
+	{
+		RGBAImage dst;
+		dst.width = std::max(src.width / 2, 1u);
+		dst.height = std::max(src.height / 2, 1u);
+		dst.pixels.resize((size_t)dst.width * dst.height * 4);
+
+		Filter1D filter_x, filter_y;
+		BuildFilter(src.width, dst.width, options.filter, filter_x);
+		BuildFilter(src.height, dst.height, options.filter, filter_y);
+
+		uint32_t tiles_x = (dst.width + kTileSize - 1) / kTileSize;
+		uint32_t tiles_y = (dst.height + kTileSize - 1) / kTileSize;
+		ParallelFor(pJobSystem, (size_t)tiles_x * tiles_y, [&](size_t index)
+		{
+			std::vector<float> src_rows, rows;
+			FilterTile(src, dst, filter_x, filter_y, tables, is_linearized, (uint32_t)(index % tiles_x), (uint32_t)(index / tiles_x), src_rows, rows);
+		});
+
+		if (preserve_coverage)
+		{
+			PreserveAlphaCoverage(dst, options.alphaCutoff, target_coverage);
+		}
+
+		outMips.push_back(std::move(dst));
+		src = outMips.back().GetView();
+	}
+}
+
+
+//	EOF
@@ -0,0 +1,32 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "job_system.h"
+#include "rgba_image.h"
+
+
+struct MipFilter
+{
+	enum Type : uint32_t
+	{
+		Box,		// average of the covered source pixels.
+		Kaiser,		// Kaiser windowed sinc. sharper than box, with less aliasing.
+
+		Max
+	};
+};	// struct MipFilter
+
+struct MipOptions
+{
+	uint32_t	filter = MipFilter::Kaiser;		// MipFilter::Type
+	bool		gammaCorrect = true;			// filter sRGB images in linear space.
+	float		alphaCutoff = -1.0f;			// if 0 or more, alpha of each mip is scaled to keep the alpha test coverage of the top mip.
+};	// struct MipOptions
+
+// generate mips 1 to the 1x1 mip of the top image. outMips[0] is mip 1.
+// each mip is filtered from the previous mip in tiles, and the tiles are processed in parallel.
+void GenerateMips(const RGBAImageView& top, bool isSrgb, const MipOptions& options, JobSystem* pJobSystem, std::vector<RGBAImage>& outMips);
+
+//	EOF
@@ -0,0 +1,33 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+
+// RGBA8 pixels which are owned by someone else. (stb_image output, or RGBAImage)
+// rows are tightly packed.
+struct RGBAImageView
+{
+	const uint8_t*	pPixels = nullptr;
+	uint32_t		width = 0;
+	uint32_t		height = 0;
+};	// struct RGBAImageView
+
+// RGBA8 image. rows are tightly packed.
+struct RGBAImage
+{
+	uint32_t				width = 0;
+	uint32_t				height = 0;
+	std::vector<uint8_t>	pixels;
+
+	RGBAImageView GetView() const
+	{
+		RGBAImageView view;
+		view.pPixels = pixels.data();
+		view.width = width;
+		view.height = height;
+		return view;
+	}
+};	// struct RGBAImage
+
+//	EOF
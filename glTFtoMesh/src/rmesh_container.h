@@ -0,0 +1,199 @@
+﻿#pragma once
+
+#include <cstdint>
+
+
+// memory mappable rmesh container.
+// the runtime can map the file and use the sections directly, without parsing or allocation.
+//
+// layout:
+//   RMeshContainerHeader
+//   RMeshContainerSection[sectionCount]		(at sectionTableOffset)
+//   sections									(each offset is aligned to kSectionAlignment)
+//
+// all values are little endian. vertex streams, index buffer and meshlet buffers are the same
+// as the buffers of sl12::ResourceMesh, and they are encoded with the formats in the header.
+struct RMeshContainerSectionType
+{
+	enum Type : uint32_t
+	{
+		Strings,				// null terminated strings. referred by byte offsets.
+		Materials,				// RMeshContainerMaterial[]
+		Submeshes,				// RMeshContainerSubmesh[]
+		Meshlets,				// RMeshContainerMeshlet[]. all submeshes, and then all LODs.
+		VertexPosition,
+		VertexNormal,
+		VertexTangent,
+		VertexTexcoord,
+		IndexBuffer,			// uint16 or uint32 indices. local to the submesh vertices. see RMeshFormat::indexSizes.
+		MeshletPrimitive,		// packed primitives. see RMeshMeshletEncoding.
+		MeshletVertexIndex,		// vertex indices. see RMeshMeshletEncoding.
+		Lods,					// RMeshContainerLod[]. LOD 1 or later of all submeshes.
+		Dags,					// RMeshContainerDag[]. one per submesh.
+		DagClusters,			// RMeshContainerDagCluster[]. all submeshes.
+		InstancedMeshes,		// RMeshContainerInstancedMesh[]. empty if node transforms are baked.
+		Instances,				// RMeshContainerInstance[].
+
+		Max
+	};
+};	// struct RMeshContainerSectionType
+
+struct RMeshContainerHeader
+{
+	static const uint32_t	kMagic = 0x48534d52;		// "RMSH"
+	static const uint32_t	kVersion = 7;
+	static const uint32_t	kSectionAlignment = 256;
+
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	headerSize;				// sizeof(RMeshContainerHeader)
+	uint32_t	sectionCount;
+	uint64_t	sectionTableOffset;
+	uint64_t	fileSize;
+
+	uint32_t	positionFormat;			// RMeshVertexFormat::Type
+	uint32_t	normalFormat;
+	uint32_t	tangentFormat;
+	uint32_t	texcoordFormat;
+	uint32_t	compression;			// RMeshCompression::Type. if not None, section sizes are compressed sizes.
+	uint32_t	materialCount;
+	uint32_t	submeshCount;
+	uint32_t	meshletCount;
+
+	float		boundingSphere[4];		// center xyz, radius
+	float		boundingBox[6];			// min xyz, max xyz
+	uint32_t	lodCount;				// element count of the LODs section.
+	uint16_t	meshletMaxVertices;		// limits of the meshlets and DAG clusters. 0 if they are not built.
+	uint16_t	meshletMaxTriangles;
+	uint32_t	meshletEncoding;		// RMeshMeshletEncoding::Type
+	uint32_t	reserved;
+};	// struct RMeshContainerHeader
+
+struct RMeshContainerSection
+{
+	uint32_t	type;					// RMeshContainerSectionType::Type
+	uint32_t	elementSize;			// uncompressed byte size of one element.
+	uint64_t	offset;					// byte offset from the beginning of the file.
+	uint64_t	size;					// byte size in the file.
+	uint64_t	elementCount;
+};	// struct RMeshContainerSection
+
+struct RMeshContainerMaterial
+{
+	uint32_t	nameOffset;				// offsets in the strings section.
+	uint32_t	textureNameOffsets[3];	// base color, normal, ORM
+	uint32_t	isOpaque;
+};	// struct RMeshContainerMaterial
+
+struct RMeshContainerSubmesh
+{
+	int32_t		materialIndex;
+	uint32_t	vertexOffset;
+	uint32_t	vertexCount;
+	uint32_t	indexOffset;
+	uint32_t	indexCount;
+	uint32_t	meshletOffset;
+	uint32_t	meshletCount;
+	uint32_t	meshletPrimitiveOffset;
+	uint32_t	meshletPrimitiveCount;
+	uint32_t	meshletVertexIndexOffset;
+	uint32_t	meshletVertexIndexCount;
+	uint32_t	lodOffset;				// offset in the LODs section.
+	float		boundingSphere[4];
+	float		boundingBox[6];
+	float		posOffset[3];			// dequantization constants. see RMeshSubmeshFormat.
+	float		posScale[3];
+	float		uvOffset[2];
+	float		uvScale[2];
+	uint32_t	lodCount;				// LOD count except LOD 0.
+	uint32_t	meshletVertexIndexSize;	// byte size of a meshlet vertex index. 2 or 4.
+	uint32_t	indexSize;				// byte size of an index. 2 or 4. index offsets are in this size.
+	uint32_t	reserved;
+};	// struct RMeshContainerSubmesh
+
+struct RMeshContainerMeshlet
+{
+	uint32_t	indexOffset;
+	uint32_t	indexCount;
+	uint32_t	primitiveOffset;
+	uint32_t	primitiveCount;
+	uint32_t	vertexIndexOffset;
+	uint32_t	vertexIndexCount;
+	float		boundingSphere[4];
+	float		boundingBox[6];
+	float		coneApex[3];
+	float		coneAxis[3];
+	float		coneCutoff;
+	uint32_t	reserved;
+};	// struct RMeshContainerMeshlet
+
+// LOD 1 or later of a submesh. see RMeshLod.
+// buffers follow the LOD 0 buffers of the submesh, and meshlet offsets are local to the LOD buffers.
+struct RMeshContainerLod
+{
+	uint32_t	level;
+	uint32_t	indexOffset;
+	uint32_t	indexCount;
+	uint32_t	meshletOffset;			// offset in the meshlets section.
+	uint32_t	meshletCount;
+	uint32_t	meshletPrimitiveOffset;
+	uint32_t	meshletPrimitiveCount;
+	uint32_t	meshletVertexIndexOffset;
+	uint32_t	meshletVertexIndexCount;
+	float		error;					// simplification error in object space.
+};	// struct RMeshContainerLod
+
+// hierarchical cluster DAG of a submesh. see RMeshDag.
+struct RMeshContainerDag
+{
+	uint32_t	clusterOffset;			// offset in the DAG clusters section.
+	uint32_t	clusterCount;
+	uint32_t	indexOffset;
+	uint32_t	indexCount;
+	uint32_t	meshletPrimitiveOffset;
+	uint32_t	meshletPrimitiveCount;
+	uint32_t	meshletVertexIndexOffset;
+	uint32_t	meshletVertexIndexCount;
+	uint32_t	levelCount;
+	uint32_t	reserved[3];
+};	// struct RMeshContainerDag
+
+// cluster of the DAG. see RMeshDagCluster.
+struct RMeshContainerDagCluster
+{
+	RMeshContainerMeshlet	meshlet;	// offsets are local to the DAG buffers.
+	uint32_t				level;
+	float					error;
+	float					parentError;
+	uint32_t				reserved;
+	float					lodBounds[4];
+	float					parentLodBounds[4];
+};	// struct RMeshContainerDagCluster
+
+// see RMeshInstancedMesh.
+struct RMeshContainerInstancedMesh
+{
+	uint32_t	submeshOffset;
+	uint32_t	submeshCount;
+};	// struct RMeshContainerInstancedMesh
+
+// see RMeshInstance.
+struct RMeshContainerInstance
+{
+	float		transform[16];			// row major, row vector.
+	uint32_t	meshIndex;
+	uint32_t	reserved[3];
+};	// struct RMeshContainerInstance
+
+static_assert(sizeof(RMeshContainerHeader) == 120, "RMeshContainerHeader size is changed.");
+static_assert(sizeof(RMeshContainerSection) == 32, "RMeshContainerSection size is changed.");
+static_assert(sizeof(RMeshContainerMaterial) == 20, "RMeshContainerMaterial size is changed.");
+static_assert(sizeof(RMeshContainerSubmesh) == 144, "RMeshContainerSubmesh size is changed.");
+static_assert(sizeof(RMeshContainerMeshlet) == 96, "RMeshContainerMeshlet size is changed.");
+static_assert(sizeof(RMeshContainerLod) == 40, "RMeshContainerLod size is changed.");
+static_assert(sizeof(RMeshContainerDag) == 48, "RMeshContainerDag size is changed.");
+static_assert(sizeof(RMeshContainerDagCluster) == 144, "RMeshContainerDagCluster size is changed.");
+static_assert(sizeof(RMeshContainerInstancedMesh) == 8, "RMeshContainerInstancedMesh size is changed.");
+static_assert(sizeof(RMeshContainerInstance) == 80, "RMeshContainerInstance size is changed.");
+
+//	EOF
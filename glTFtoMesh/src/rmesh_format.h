@@ -0,0 +1,286 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <cereal/cereal.hpp>
+#include <cereal/types/vector.hpp>
+
+
+// format information written after sl12::ResourceMesh in the rmesh file.
+// sl12::ResourceMesh has no room for encodings, so the runtime reads this block after the mesh.
+// loaders which read only the mesh ignore this block, but they can not decode non float streams.
+struct RMeshVertexFormat
+{
+	enum Type : uint32_t
+	{
+		Float2,				// float x2.
+		Float3,				// float x3.
+		Float4,				// float x4.
+		Unorm16x4,			// position. xyz = unorm16 in the submesh range, w = 0.
+		Oct16x2,			// normal. octahedral encoded snorm16 x2.
+		Oct16x2Sign,		// tangent. octahedral encoded snorm16 x2. the lowest bit of y is 1 if the bitangent sign is negative.
+		Half2,				// texcoord. half float x2.
+		Unorm16x2,			// texcoord. unorm16 x2 in the submesh range.
+	};
+};	// struct RMeshVertexFormat
+
+// compression of the buffers in sl12::ResourceMesh.
+struct RMeshCompression
+{
+	enum Type : uint32_t
+	{
+		None,
+		// vertex streams, meshletPackedPrimitive_ and meshletVertexIndex_ are meshopt_encodeVertexBuffer streams.
+		// (element size is the vertex format size for vertex streams, and 4 for meshlet buffers.)
+		// indexBuffer_ is a meshopt_encodeIndexBuffer stream of RMeshFormat::indexUnitSize byte indices.
+		// (all submeshes have the same index size if compressed.)
+		Meshopt,
+	};
+};	// struct RMeshCompression
+
+// encoding of meshletPackedPrimitive_ and meshletVertexIndex_.
+struct RMeshMeshletEncoding
+{
+	enum Type : uint32_t
+	{
+		// a triangle is uint32 (i2 << 20) | (i1 << 10) | i0, and vertex indices are uint32.
+		// offsets and counts are element counts.
+		Packed10,
+		// a triangle is uint8 x3, and the triangles of each meshlet start at a 4 byte boundary.
+		// vertex indices are uint16 if the submesh has 65536 vertices or less, otherwise uint32. (RMeshFormat::meshletVertexIndexSizes)
+		// buffer offsets and counts of submeshes, LODs and DAGs, and meshlet primitiveOffset are in bytes.
+		// meshlet primitiveCount, vertexIndexOffset and vertexIndexCount are element counts.
+		// every part (LOD or DAG) of a submesh starts at a 4 byte boundary.
+		Compact,
+	};
+};	// struct RMeshMeshletEncoding
+
+// dequantization constants of one submesh.
+//   position = posOffset + posScale * unorm16
+//   texcoord = uvOffset + uvScale * unorm16
+struct RMeshSubmeshFormat
+{
+	float	posOffsetX = 0.0f, posOffsetY = 0.0f, posOffsetZ = 0.0f;
+	float	posScaleX = 1.0f, posScaleY = 1.0f, posScaleZ = 1.0f;
+	float	uvOffsetX = 0.0f, uvOffsetY = 0.0f;
+	float	uvScaleX = 1.0f, uvScaleY = 1.0f;
+
+	template <class Archive>
+	void serialize(Archive& ar)
+	{
+		ar(CEREAL_NVP(posOffsetX), CEREAL_NVP(posOffsetY), CEREAL_NVP(posOffsetZ));
+		ar(CEREAL_NVP(posScaleX), CEREAL_NVP(posScaleY), CEREAL_NVP(posScaleZ));
+		ar(CEREAL_NVP(uvOffsetX), CEREAL_NVP(uvOffsetY));
+		ar(CEREAL_NVP(uvScaleX), CEREAL_NVP(uvScaleY));
+	}
+};	// struct RMeshSubmeshFormat
+
+// LOD level of one submesh. LOD 0 is sl12::ResourceMeshSubmesh itself.
+// all LODs share the vertices of the submesh, and their buffers follow the LOD 0 buffers of the submesh.
+// offsets are element offsets in the whole buffers.
+struct RMeshLod
+{
+	uint32_t	submeshIndex = 0;
+	uint32_t	level = 0;
+	uint32_t	indexOffset = 0;
+	uint32_t	indexCount = 0;
+	uint32_t	meshletOffset = 0;				// offset in RMeshFormat::lodMeshlets.
+	uint32_t	meshletCount = 0;
+	uint32_t	meshletPrimitiveOffset = 0;
+	uint32_t	meshletPrimitiveCount = 0;
+	uint32_t	meshletVertexIndexOffset = 0;
+	uint32_t	meshletVertexIndexCount = 0;
+	float		error = 0.0f;					// simplification error in object space.
+
+	template <class Archive>
+	void serialize(Archive& ar)
+	{
+		ar(CEREAL_NVP(submeshIndex), CEREAL_NVP(level));
+		ar(CEREAL_NVP(indexOffset), CEREAL_NVP(indexCount));
+		ar(CEREAL_NVP(meshletOffset), CEREAL_NVP(meshletCount));
+		ar(CEREAL_NVP(meshletPrimitiveOffset), CEREAL_NVP(meshletPrimitiveCount));
+		ar(CEREAL_NVP(meshletVertexIndexOffset), CEREAL_NVP(meshletVertexIndexCount));
+		ar(CEREAL_NVP(error));
+	}
+};	// struct RMeshLod
+
+// meshlet of a LOD. same as sl12::ResourceMeshMeshlet, and offsets are local to the LOD buffers.
+struct RMeshMeshlet
+{
+	uint32_t	indexOffset = 0;
+	uint32_t	indexCount = 0;
+	uint32_t	primitiveOffset = 0;
+	uint32_t	primitiveCount = 0;
+	uint32_t	vertexIndexOffset = 0;
+	uint32_t	vertexIndexCount = 0;
+	float		boundingSphere[4] = {};			// center xyz, radius
+	float		boundingBox[6] = {};			// min xyz, max xyz
+	float		coneApex[3] = {};
+	float		coneAxis[3] = {};
+	float		coneCutoff = 0.0f;
+
+	template <class Archive>
+	void serialize(Archive& ar)
+	{
+		ar(CEREAL_NVP(indexOffset), CEREAL_NVP(indexCount));
+		ar(CEREAL_NVP(primitiveOffset), CEREAL_NVP(primitiveCount));
+		ar(CEREAL_NVP(vertexIndexOffset), CEREAL_NVP(vertexIndexCount));
+		ar(CEREAL_NVP(boundingSphere), CEREAL_NVP(boundingBox));
+		ar(CEREAL_NVP(coneApex), CEREAL_NVP(coneAxis), CEREAL_NVP(coneCutoff));
+	}
+};	// struct RMeshMeshlet
+
+// hierarchical cluster DAG of one submesh. its buffers follow the LOD buffers of the submesh.
+// offsets are element offsets in the whole buffers.
+struct RMeshDag
+{
+	uint32_t	clusterOffset = 0;				// offset in RMeshFormat::dagClusters.
+	uint32_t	clusterCount = 0;
+	uint32_t	indexOffset = 0;
+	uint32_t	indexCount = 0;
+	uint32_t	meshletPrimitiveOffset = 0;
+	uint32_t	meshletPrimitiveCount = 0;
+	uint32_t	meshletVertexIndexOffset = 0;
+	uint32_t	meshletVertexIndexCount = 0;
+	uint32_t	levelCount = 0;
+
+	template <class Archive>
+	void serialize(Archive& ar)
+	{
+		ar(CEREAL_NVP(clusterOffset), CEREAL_NVP(clusterCount));
+		ar(CEREAL_NVP(indexOffset), CEREAL_NVP(indexCount));
+		ar(CEREAL_NVP(meshletPrimitiveOffset), CEREAL_NVP(meshletPrimitiveCount));
+		ar(CEREAL_NVP(meshletVertexIndexOffset), CEREAL_NVP(meshletVertexIndexCount));
+		ar(CEREAL_NVP(levelCount));
+	}
+};	// struct RMeshDag
+
+// cluster of the DAG. meshlet offsets are local to the DAG buffers.
+// a cluster is drawn if error is acceptable and parentError is not. (parentError is FLT_MAX at roots.)
+struct RMeshDagCluster
+{
+	RMeshMeshlet	meshlet;
+	uint32_t		level = 0;
+	float			lodBounds[4] = {};			// center xyz, radius
+	float			error = 0.0f;
+	float			parentLodBounds[4] = {};
+	float			parentError = 0.0f;
+
+	template <class Archive>
+	void serialize(Archive& ar)
+	{
+		ar(CEREAL_NVP(meshlet), CEREAL_NVP(level));
+		ar(CEREAL_NVP(lodBounds), CEREAL_NVP(error));
+		ar(CEREAL_NVP(parentLodBounds), CEREAL_NVP(parentError));
+	}
+};	// struct RMeshDagCluster
+
+// unique mesh in instancing mode. a range of sl12::ResourceMesh::submeshes_.
+struct RMeshInstancedMesh
+{
+	uint32_t	submeshOffset = 0;
+	uint32_t	submeshCount = 0;
+
+	template <class Archive>
+	void serialize(Archive& ar)
+	{
+		ar(CEREAL_NVP(submeshOffset), CEREAL_NVP(submeshCount));
+	}
+};	// struct RMeshInstancedMesh
+
+// instance of a mesh. submeshes are in mesh space, and transform is mesh space to world space.
+struct RMeshInstance
+{
+	float		transform[16] = {};				// row major, row vector. (DirectX::XMFLOAT4X4)
+	uint32_t	meshIndex = 0;					// index of RMeshFormat::instancedMeshes.
+
+	template <class Archive>
+	void serialize(Archive& ar)
+	{
+		ar(CEREAL_NVP(transform), CEREAL_NVP(meshIndex));
+	}
+};	// struct RMeshInstance
+
+struct RMeshFormat
+{
+	static const uint32_t kVersion = 8;
+
+	uint32_t						version = kVersion;
+	uint32_t						positionFormat = RMeshVertexFormat::Float3;
+	uint32_t						normalFormat = RMeshVertexFormat::Float3;
+	uint32_t						tangentFormat = RMeshVertexFormat::Float4;
+	uint32_t						texcoordFormat = RMeshVertexFormat::Float2;
+	std::vector<RMeshSubmeshFormat>	submeshes;		// same order as sl12::ResourceMesh::submeshes_.
+
+	// version 2.
+	uint32_t						compression = RMeshCompression::None;
+	uint32_t						vertexCount = 0;				// element counts of the uncompressed buffers.
+	uint32_t						indexCount = 0;
+	uint32_t						meshletPrimitiveCount = 0;
+	uint32_t						meshletVertexIndexCount = 0;
+
+	// version 3.
+	std::vector<RMeshLod>			lods;			// LOD 1 or later of all submeshes. sorted by submesh and level.
+	std::vector<RMeshMeshlet>		lodMeshlets;
+
+	// version 4.
+	std::vector<RMeshDag>			dags;			// same order as sl12::ResourceMesh::submeshes_.
+	std::vector<RMeshDagCluster>	dagClusters;
+
+	// version 5. empty if node transforms are baked into the submeshes.
+	std::vector<RMeshInstancedMesh>	instancedMeshes;
+	std::vector<RMeshInstance>		instances;
+
+	// version 6. limits of the meshlets and DAG clusters. 0 if they are not built.
+	uint32_t						meshletMaxVertices = 0;
+	uint32_t						meshletMaxTriangles = 0;
+
+	// version 7. meshlet buffer encoding. if version is 6 or older, Packed10.
+	uint32_t						meshletEncoding = RMeshMeshletEncoding::Packed10;
+	std::vector<uint32_t>			meshletVertexIndexSizes;		// byte size of a meshlet vertex index of each submesh.
+
+	// version 8. index buffer format. if version is 7 or older, all indices are uint32.
+	// index offsets of submeshes, LODs and DAGs are in indices of the submesh. (byte offset = offset * indexSizes[submesh])
+	// each submesh starts at a 4 byte boundary. a uint16 submesh with an odd index count is followed by a degenerate triangle.
+	uint32_t						indexUnitSize = 4;				// indexCount is the byte size of the index buffer divided by this.
+	std::vector<uint32_t>			indexSizes;						// byte size of an index of each submesh. 2 or 4.
+
+	template <class Archive>
+	void serialize(Archive& ar)
+	{
+		ar(CEREAL_NVP(version));
+		ar(CEREAL_NVP(positionFormat), CEREAL_NVP(normalFormat), CEREAL_NVP(tangentFormat), CEREAL_NVP(texcoordFormat));
+		ar(CEREAL_NVP(submeshes));
+		if (version >= 2)
+		{
+			ar(CEREAL_NVP(compression));
+			ar(CEREAL_NVP(vertexCount), CEREAL_NVP(indexCount), CEREAL_NVP(meshletPrimitiveCount), CEREAL_NVP(meshletVertexIndexCount));
+		}
+		if (version >= 3)
+		{
+			ar(CEREAL_NVP(lods), CEREAL_NVP(lodMeshlets));
+		}
+		if (version >= 4)
+		{
+			ar(CEREAL_NVP(dags), CEREAL_NVP(dagClusters));
+		}
+		if (version >= 5)
+		{
+			ar(CEREAL_NVP(instancedMeshes), CEREAL_NVP(instances));
+		}
+		if (version >= 6)
+		{
+			ar(CEREAL_NVP(meshletMaxVertices), CEREAL_NVP(meshletMaxTriangles));
+		}
+		if (version >= 7)
+		{
+			ar(CEREAL_NVP(meshletEncoding), CEREAL_NVP(meshletVertexIndexSizes));
+		}
+		if (version >= 8)
+		{
+			ar(CEREAL_NVP(indexUnitSize), CEREAL_NVP(indexSizes));
+		}
+	}
+};	// struct RMeshFormat
+
+//	EOF
@@ -0,0 +1,1005 @@
+﻿#include "rmesh_writer.h"
+
+#include <fstream>
+#include <cstring>
+
+#include <cereal/cereal.hpp>
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/vector.hpp>
+#include <cereal/types/string.hpp>
+
+#include "rmesh_format.h"
+#include "rmesh_container.h"
+#include "vertex_format.h"
+#include "mesh_codec.h"
+
+#define private public
+#include "sl12/resource_mesh.h"
+#undef private
+
+
+namespace
+{
+	std::string PNGtoDDS(const std::string& filename)
+	{
+		std::string ret = filename;
+		auto pos = ret.rfind(".png");
+		if (pos != std::string::npos)
+		{
+			ret.erase(pos);
+			ret += ".dds";
+		}
+		return ret;
+	}
+
+	// streams of the rmesh. each stream is the concatenation of all submeshes.
+	struct StreamKind
+	{
+		enum Type
+		{
+			Position,
+			Normal,
+			Tangent,
+			Texcoord,
+			Index,
+			MeshletPrimitive,
+			MeshletVertexIndex,
+
+			Max
+		};
+	};	// struct StreamKind
+
+	size_t GetStreamElementSize(const RMeshFormat& format, int kind)
+	{
+		switch (kind)
+		{
+		case StreamKind::Position:	return GetVertexFormatSize(format.positionFormat);
+		case StreamKind::Normal:	return GetVertexFormatSize(format.normalFormat);
+		case StreamKind::Tangent:	return GetVertexFormatSize(format.tangentFormat);
+		case StreamKind::Texcoord:	return GetVertexFormatSize(format.texcoordFormat);
+		case StreamKind::Index:		return format.indexUnitSize;
+		default:					return format.meshletEncoding == RMeshMeshletEncoding::Compact ? 1 : sizeof(uint32_t);
+		}
+	}
+
+	// element size for meshopt_encodeVertexBuffer. meshlet streams are encoded as uint32 in all encodings.
+	size_t GetStreamCodecElementSize(const RMeshFormat& format, int kind)
+	{
+		return kind < StreamKind::Index ? GetStreamElementSize(format, kind) : sizeof(uint32_t);
+	}
+
+	bool IsIndexStream(int kind)
+	{
+		return kind == StreamKind::Index || kind == StreamKind::MeshletPrimitive || kind == StreamKind::MeshletVertexIndex;
+	}
+
+	size_t AlignTo4(size_t size)
+	{
+		return (size + 3) & ~(size_t)3;
+	}
+
+	// index streams of a submesh are LOD 0, LOD 1 or later, and the cluster DAG.
+	size_t GetIndexStreamPartCount(const SubmeshWork& submesh)
+	{
+		return submesh.GetLods().size() + 2;
+	}
+
+	// buffers of one part. part 0 is the submesh itself.
+	struct IndexStreamPart
+	{
+		const std::vector<uint32_t>*	pIndexBuffer;
+		const std::vector<uint8_t>*		pPrimitives;
+		const std::vector<uint32_t>*	pVertexIndexBuffer;
+	};	// struct IndexStreamPart
+
+	IndexStreamPart GetIndexStreamPart(const SubmeshWork& submesh, size_t part)
+	{
+		if (part == submesh.GetLods().size() + 1)
+		{
+			auto&& dag = submesh.GetDag();
+			return { &dag.indexBuffer, &dag.primitives, &dag.vertexIndexBuffer };
+		}
+		if (part == 0)
+		{
+			return { &submesh.GetIndexBuffer(), &submesh.GetMeshletPrimitives(), &submesh.GetVertexIndexBuffer() };
+		}
+		auto&& lod = submesh.GetLods()[part - 1];
+		return { &lod.indexBuffer, &lod.meshletPrimitives, &lod.meshletVertexIndexBuffer };
+	}
+
+	// call func with the meshlets of one part in order.
+	template <typename Func>
+	void ForEachPartMeshlet(const SubmeshWork& submesh, size_t part, Func func)
+	{
+		if (part == submesh.GetLods().size() + 1)
+		{
+			for (auto&& cluster : submesh.GetDag().clusters)
+			{
+				func(cluster.meshlet);
+			}
+			return;
+		}
+		for (auto&& meshlet : (part == 0) ? submesh.GetMeshlets() : submesh.GetLods()[part - 1].meshlets)
+		{
+			func(meshlet);
+		}
+	}
+
+	// byte size of a meshlet vertex index of the submesh.
+	size_t GetMeshletVertexIndexSize(uint32_t encoding, const SubmeshWork& submesh)
+	{
+		if (encoding == RMeshMeshletEncoding::Compact && submesh.GetVertexBuffer().size() <= 0x10000)
+		{
+			return sizeof(uint16_t);
+		}
+		return sizeof(uint32_t);
+	}
+
+	// a uint16 submesh with an odd index count is followed by a degenerate triangle, so that the next submesh is 4 byte aligned.
+	// it is added to the last part, and it keeps the index buffer a triangle list for the index codec.
+	size_t GetIndexPaddingSize(const RMeshFormat& format, size_t submeshIndex, const SubmeshWork& submesh)
+	{
+		if (format.indexSizes[submeshIndex] != sizeof(uint16_t))
+		{
+			return 0;
+		}
+		size_t count = 0;
+		for (size_t part = 0; part < GetIndexStreamPartCount(submesh); part++)
+		{
+			count += GetIndexStreamPart(submesh, part).pIndexBuffer->size();
+		}
+		return (count & 1) ? sizeof(uint16_t) * 3 : 0;
+	}
+
+	// byte size of one part in the output encoding.
+	size_t GetIndexStreamPartSize(const RMeshFormat& format, size_t submeshIndex, const SubmeshWork& submesh, int kind, size_t part)
+	{
+		auto buffers = GetIndexStreamPart(submesh, part);
+		switch (kind)
+		{
+		case StreamKind::Index:
+			if (part == GetIndexStreamPartCount(submesh) - 1)
+			{
+				return format.indexSizes[submeshIndex] * buffers.pIndexBuffer->size() + GetIndexPaddingSize(format, submeshIndex, submesh);
+			}
+			return format.indexSizes[submeshIndex] * buffers.pIndexBuffer->size();
+		case StreamKind::MeshletPrimitive:
+			if (format.meshletEncoding == RMeshMeshletEncoding::Compact)
+			{
+				size_t size = 0;
+				ForEachPartMeshlet(submesh, part, [&](const Meshlet& meshlet)
+				{
+					size += AlignTo4(meshlet.primitiveCount * 3);
+				});
+				return size;
+			}
+			return sizeof(uint32_t) * (buffers.pPrimitives->size() / 3);
+		default:
+			return AlignTo4(format.meshletVertexIndexSizes[submeshIndex] * buffers.pVertexIndexBuffer->size());
+		}
+	}
+
+	// write one part in the output encoding.
+	void EncodeIndexStreamPart(const RMeshFormat& format, size_t submeshIndex, const SubmeshWork& submesh, int kind, size_t part, uint8_t* pDst)
+	{
+		auto buffers = GetIndexStreamPart(submesh, part);
+		if (kind == StreamKind::Index)
+		{
+			auto&& indices = *buffers.pIndexBuffer;
+			if (format.indexSizes[submeshIndex] == sizeof(uint16_t))
+			{
+				for (auto index : indices)
+				{
+					uint16_t narrow = (uint16_t)index;
+					memcpy(pDst, &narrow, sizeof(narrow));
+					pDst += sizeof(narrow);
+				}
+				if (part == GetIndexStreamPartCount(submesh) - 1)
+				{
+					memset(pDst, 0, GetIndexPaddingSize(format, submeshIndex, submesh));
+				}
+			}
+			else
+			{
+				memcpy(pDst, indices.data(), sizeof(uint32_t) * indices.size());
+			}
+		}
+		else if (kind == StreamKind::MeshletPrimitive)
+		{
+			auto&& primitives = *buffers.pPrimitives;
+			if (format.meshletEncoding == RMeshMeshletEncoding::Compact)
+			{
+				ForEachPartMeshlet(submesh, part, [&](const Meshlet& meshlet)
+				{
+					size_t size = meshlet.primitiveCount * 3;
+					size_t aligned = AlignTo4(size);
+					memcpy(pDst, primitives.data() + meshlet.primitiveOffset * 3, size);
+					memset(pDst + size, 0, aligned - size);
+					pDst += aligned;
+				});
+			}
+			else
+			{
+				for (size_t i = 0; i < primitives.size(); i += 3)
+				{
+					uint32_t packed = (primitives[i + 2] << 20) | (primitives[i + 1] << 10) | primitives[i + 0];
+					memcpy(pDst, &packed, sizeof(packed));
+					pDst += sizeof(packed);
+				}
+			}
+		}
+		else
+		{
+			auto&& indices = *buffers.pVertexIndexBuffer;
+			if (format.meshletVertexIndexSizes[submeshIndex] == sizeof(uint16_t))
+			{
+				for (auto index : indices)
+				{
+					uint16_t narrow = (uint16_t)index;
+					memcpy(pDst, &narrow, sizeof(narrow));
+					pDst += sizeof(narrow);
+				}
+				if (indices.size() & 1)
+				{
+					memset(pDst, 0, sizeof(uint16_t));
+				}
+			}
+			else
+			{
+				memcpy(pDst, indices.data(), sizeof(uint32_t) * indices.size());
+			}
+		}
+	}
+
+	// element count of the submesh in the stream.
+	size_t GetStreamElementCount(const RMeshFormat& format, size_t submeshIndex, const SubmeshWork& submesh, int kind)
+	{
+		if (!IsIndexStream(kind))
+		{
+			return submesh.GetVertexBuffer().size();
+		}
+		size_t size = 0;
+		for (size_t part = 0; part < GetIndexStreamPartCount(submesh); part++)
+		{
+			size += GetIndexStreamPartSize(format, submeshIndex, submesh, kind, part);
+		}
+		return size / GetStreamElementSize(format, kind);
+	}
+
+	// element count of one part in the stream.
+	uint32_t GetPartElementCount(const RMeshFormat& format, size_t submeshIndex, const SubmeshWork& submesh, int kind, size_t part)
+	{
+		return (uint32_t)(GetIndexStreamPartSize(format, submeshIndex, submesh, kind, part) / GetStreamElementSize(format, kind));
+	}
+
+	// write all parts of the index stream of the submesh.
+	void CopyIndexStream(const RMeshFormat& format, size_t submeshIndex, const SubmeshWork& submesh, int kind, uint8_t* pDst)
+	{
+		for (size_t part = 0; part < GetIndexStreamPartCount(submesh); part++)
+		{
+			EncodeIndexStreamPart(format, submeshIndex, submesh, kind, part, pDst);
+			pDst += GetIndexStreamPartSize(format, submeshIndex, submesh, kind, part);
+		}
+	}
+
+	// index offset in the stream units to the indices of the submesh.
+	uint32_t ToSubmeshIndexOffset(const RMeshFormat& format, size_t submeshIndex, uint32_t offset)
+	{
+		return offset * format.indexUnitSize / format.indexSizes[submeshIndex];
+	}
+
+	// primitive offsets of the meshlets in the output encoding.
+	// meshlets of one part must be visited in order, and a new counter is used for each part.
+	class PrimitiveOffsetCounter
+	{
+	public:
+		explicit PrimitiveOffsetCounter(uint32_t encoding)
+			: encoding_(encoding)
+		{}
+
+		uint32_t Next(const Meshlet& meshlet)
+		{
+			if (encoding_ != RMeshMeshletEncoding::Compact)
+			{
+				return meshlet.primitiveOffset;
+			}
+			uint32_t ret = offset_;
+			offset_ += (uint32_t)AlignTo4(meshlet.primitiveCount * 3);
+			return ret;
+		}
+
+	private:
+		uint32_t	encoding_;
+		uint32_t	offset_ = 0;
+	};	// class PrimitiveOffsetCounter
+
+	void ConvertMeshlet(const Meshlet& src, uint32_t primitiveOffset, RMeshMeshlet& dst)
+	{
+		dst.indexOffset = src.indexOffset;
+		dst.indexCount = src.indexCount;
+		dst.primitiveOffset = primitiveOffset;
+		dst.primitiveCount = src.primitiveCount;
+		dst.vertexIndexOffset = src.vertexIndexOffset;
+		dst.vertexIndexCount = src.vertexIndexCount;
+		memcpy(dst.boundingSphere, &src.boundingSphere, sizeof(dst.boundingSphere));
+		memcpy(dst.boundingBox, &src.boundingBox, sizeof(dst.boundingBox));
+		memcpy(dst.coneApex, &src.cone.apex, sizeof(dst.coneApex));
+		memcpy(dst.coneAxis, &src.cone.axis, sizeof(dst.coneAxis));
+		dst.coneCutoff = src.cone.cutoff;
+	}
+
+	// write one stream chunk by chunk, so that the whole stream is not needed in memory.
+	template <typename Sink>
+	void ProduceStream(const MeshWork& mesh, const RMeshFormat& format, int kind, Sink sink)
+	{
+		static const size_t kChunkElements = 64 * 1024;
+
+		size_t element_size = GetStreamElementSize(format, kind);
+		std::vector<uint8_t> chunk;
+		for (size_t submesh_index = 0; submesh_index < mesh.GetSubmeshes().size(); submesh_index++)
+		{
+			auto&& submesh = *mesh.GetSubmeshes()[submesh_index];
+			size_t count = GetStreamElementCount(format, submesh_index, submesh, kind);
+			if (IsIndexStream(kind))
+			{
+				for (size_t part = 0; part < GetIndexStreamPartCount(submesh); part++)
+				{
+					chunk.resize(GetIndexStreamPartSize(format, submesh_index, submesh, kind, part));
+					EncodeIndexStreamPart(format, submesh_index, submesh, kind, part, chunk.data());
+					sink(chunk.data(), chunk.size());
+				}
+				continue;
+			}
+
+			auto&& sub_format = format.submeshes[submesh_index];
+			for (size_t start = 0; start < count; start += kChunkElements)
+			{
+				size_t n = std::min(kChunkElements, count - start);
+				chunk.resize(n * element_size);
+				uint8_t* pDst[StreamKind::Texcoord + 1] = {};
+				pDst[kind] = chunk.data();
+				EncodeVertexStreams(submesh.GetVertexBuffer().data() + start, n, format, sub_format, pDst[0], pDst[1], pDst[2], pDst[3]);
+				sink(chunk.data(), chunk.size());
+			}
+		}
+	}
+
+	void SetupFormat(const MeshWork& mesh, const ToolOptions& options, RMeshFormat& outFormat)
+	{
+		SetupVertexFormat(options.quantizeVertex, options.texcoordUnorm16, outFormat);
+		if (options.meshletFlag || options.clusterDag)
+		{
+			outFormat.meshletMaxVertices = mesh.GetMeshletOptions().maxVertices;
+			outFormat.meshletMaxTriangles = mesh.GetMeshletOptions().maxTriangles;
+		}
+		outFormat.meshletEncoding = options.meshletCompact ? RMeshMeshletEncoding::Compact : RMeshMeshletEncoding::Packed10;
+
+		// uint16 indices for submeshes which have 65536 vertices or less.
+		// the index codec needs one index size for the whole stream, so compressed buffers are uint16 only if all submeshes are.
+		bool index16 = options.index16;
+		if (index16 && options.compressMesh)
+		{
+			for (auto&& submesh : mesh.GetSubmeshes())
+			{
+				index16 = index16 && submesh->GetVertexBuffer().size() <= 0x10000;
+			}
+		}
+		outFormat.indexUnitSize = sizeof(uint32_t);
+		for (auto&& submesh : mesh.GetSubmeshes())
+		{
+			uint32_t size = (index16 && submesh->GetVertexBuffer().size() <= 0x10000) ? sizeof(uint16_t) : sizeof(uint32_t);
+			outFormat.indexSizes.push_back(size);
+			outFormat.indexUnitSize = std::min(outFormat.indexUnitSize, size);
+		}
+		for (auto&& instanced_mesh : mesh.GetInstancedMeshes())
+		{
+			RMeshInstancedMesh m;
+			m.submeshOffset = instanced_mesh.submeshOffset;
+			m.submeshCount = instanced_mesh.submeshCount;
+			outFormat.instancedMeshes.push_back(m);
+		}
+		for (auto&& instance : mesh.GetInstances())
+		{
+			RMeshInstance inst;
+			memcpy(inst.transform, &instance.transform, sizeof(inst.transform));
+			inst.meshIndex = instance.meshIndex;
+			outFormat.instances.push_back(inst);
+		}
+		outFormat.submeshes.resize(mesh.GetSubmeshes().size());
+		for (size_t i = 0; i < mesh.GetSubmeshes().size(); i++)
+		{
+			auto&& submesh = *mesh.GetSubmeshes()[i];
+			ComputeSubmeshFormat(submesh.GetVertexBuffer(), outFormat.submeshes[i]);
+			outFormat.meshletVertexIndexSizes.push_back((uint32_t)GetMeshletVertexIndexSize(outFormat.meshletEncoding, submesh));
+
+			// LOD buffers follow the LOD 0 buffers of the submesh.
+			uint32_t ib_offset = outFormat.indexCount + GetPartElementCount(outFormat, i, submesh, StreamKind::Index, 0);
+			uint32_t pb_offset = outFormat.meshletPrimitiveCount + GetPartElementCount(outFormat, i, submesh, StreamKind::MeshletPrimitive, 0);
+			uint32_t vib_offset = outFormat.meshletVertexIndexCount + GetPartElementCount(outFormat, i, submesh, StreamKind::MeshletVertexIndex, 0);
+			for (size_t level = 1; level <= submesh.GetLods().size(); level++)
+			{
+				auto&& lod = submesh.GetLods()[level - 1];
+				RMeshLod out_lod;
+				out_lod.submeshIndex = (uint32_t)i;
+				out_lod.level = (uint32_t)level;
+				out_lod.indexOffset = ToSubmeshIndexOffset(outFormat, i, ib_offset);
+				out_lod.indexCount = (uint32_t)lod.indexBuffer.size();
+				out_lod.meshletOffset = (uint32_t)outFormat.lodMeshlets.size();
+				out_lod.meshletCount = (uint32_t)lod.meshlets.size();
+				out_lod.meshletPrimitiveOffset = pb_offset;
+				out_lod.meshletPrimitiveCount = GetPartElementCount(outFormat, i, submesh, StreamKind::MeshletPrimitive, level);
+				out_lod.meshletVertexIndexOffset = vib_offset;
+				out_lod.meshletVertexIndexCount = GetPartElementCount(outFormat, i, submesh, StreamKind::MeshletVertexIndex, level);
+				out_lod.error = lod.error;
+				ib_offset += GetPartElementCount(outFormat, i, submesh, StreamKind::Index, level);
+				pb_offset += out_lod.meshletPrimitiveCount;
+				vib_offset += out_lod.meshletVertexIndexCount;
+				outFormat.lods.push_back(out_lod);
+
+				PrimitiveOffsetCounter primitive_offsets(outFormat.meshletEncoding);
+				for (auto&& meshlet : lod.meshlets)
+				{
+					RMeshMeshlet m;
+					ConvertMeshlet(meshlet, primitive_offsets.Next(meshlet), m);
+					outFormat.lodMeshlets.push_back(m);
+				}
+			}
+
+			// cluster DAG follows the LODs.
+			auto&& dag = submesh.GetDag();
+			RMeshDag out_dag;
+			out_dag.clusterOffset = (uint32_t)outFormat.dagClusters.size();
+			out_dag.clusterCount = (uint32_t)dag.clusters.size();
+			out_dag.indexOffset = ToSubmeshIndexOffset(outFormat, i, ib_offset);
+			out_dag.indexCount = (uint32_t)dag.indexBuffer.size();
+			out_dag.meshletPrimitiveOffset = pb_offset;
+			out_dag.meshletPrimitiveCount = GetPartElementCount(outFormat, i, submesh, StreamKind::MeshletPrimitive, submesh.GetLods().size() + 1);
+			out_dag.meshletVertexIndexOffset = vib_offset;
+			out_dag.meshletVertexIndexCount = GetPartElementCount(outFormat, i, submesh, StreamKind::MeshletVertexIndex, submesh.GetLods().size() + 1);
+			out_dag.levelCount = dag.levelCount;
+			outFormat.dags.push_back(out_dag);
+			PrimitiveOffsetCounter primitive_offsets(outFormat.meshletEncoding);
+			for (auto&& cluster : dag.clusters)
+			{
+				RMeshDagCluster c;
+				ConvertMeshlet(cluster.meshlet, primitive_offsets.Next(cluster.meshlet), c.meshlet);
+				c.level = cluster.level;
+				memcpy(c.lodBounds, &cluster.lodBounds, sizeof(c.lodBounds));
+				c.error = cluster.error;
+				memcpy(c.parentLodBounds, &cluster.parentLodBounds, sizeof(c.parentLodBounds));
+				c.parentError = cluster.parentError;
+				outFormat.dagClusters.push_back(c);
+			}
+
+			outFormat.vertexCount += (uint32_t)GetStreamElementCount(outFormat, i, submesh, StreamKind::Position);
+			outFormat.indexCount += (uint32_t)GetStreamElementCount(outFormat, i, submesh, StreamKind::Index);
+			outFormat.meshletPrimitiveCount += (uint32_t)GetStreamElementCount(outFormat, i, submesh, StreamKind::MeshletPrimitive);
+			outFormat.meshletVertexIndexCount += (uint32_t)GetStreamElementCount(outFormat, i, submesh, StreamKind::MeshletVertexIndex);
+		}
+	}
+
+	bool WriteRMeshCereal(MeshWork& mesh, const ToolOptions& options, JobSystem* pJobSystem, bool releaseGeometry, size_t* pOutSize)
+	{
+		auto out_resource = std::make_unique<sl12::ResourceMesh>();
+		out_resource->boundingSphere_.centerX = mesh.GetBoundingSphere().center.x;
+		out_resource->boundingSphere_.centerY = mesh.GetBoundingSphere().center.y;
+		out_resource->boundingSphere_.centerZ = mesh.GetBoundingSphere().center.z;
+		out_resource->boundingSphere_.radius = mesh.GetBoundingSphere().radius;
+		out_resource->boundingBox_.minX = mesh.GetBoundingBox().aabbMin.x;
+		out_resource->boundingBox_.minY = mesh.GetBoundingBox().aabbMin.y;
+		out_resource->boundingBox_.minZ = mesh.GetBoundingBox().aabbMin.z;
+		out_resource->boundingBox_.maxX = mesh.GetBoundingBox().aabbMax.x;
+		out_resource->boundingBox_.maxY = mesh.GetBoundingBox().aabbMax.y;
+		out_resource->boundingBox_.maxZ = mesh.GetBoundingBox().aabbMax.z;
+		for (auto&& mat : mesh.GetMaterials())
+		{
+			auto bcName = mat->GetTextrues()[MaterialWork::TextureKind::BaseColor];
+			auto nName = mat->GetTextrues()[MaterialWork::TextureKind::Normal];
+			auto ormName = mat->GetTextrues()[MaterialWork::TextureKind::ORM];
+			if (options.textureDDS)
+			{
+				bcName = PNGtoDDS(bcName);
+				nName = PNGtoDDS(nName);
+				ormName = PNGtoDDS(ormName);
+			}
+
+			sl12::ResourceMeshMaterial out_mat;
+			out_mat.name_ = mat->GetName();
+			out_mat.textureNames_.push_back(bcName);
+			out_mat.textureNames_.push_back(nName);
+			out_mat.textureNames_.push_back(ormName);
+			out_mat.isOpaque_ = mat->IsOpaque();
+			out_resource->materials_.push_back(out_mat);
+		}
+		RMeshFormat out_format;
+		SetupFormat(mesh, options, out_format);
+		size_t pos_size = GetVertexFormatSize(out_format.positionFormat);
+		size_t normal_size = GetVertexFormatSize(out_format.normalFormat);
+		size_t tangent_size = GetVertexFormatSize(out_format.tangentFormat);
+		size_t uv_size = GetVertexFormatSize(out_format.texcoordFormat);
+		size_t ib_size = GetStreamElementSize(out_format, StreamKind::Index);
+		size_t pb_size = GetStreamElementSize(out_format, StreamKind::MeshletPrimitive);
+		size_t vib_size = GetStreamElementSize(out_format, StreamKind::MeshletVertexIndex);
+
+		// output buffers are allocated once, and submeshes are encoded into them directly.
+		out_resource->vbPosition_.resize(pos_size * out_format.vertexCount);
+		out_resource->vbNormal_.resize(normal_size * out_format.vertexCount);
+		out_resource->vbTangent_.resize(tangent_size * out_format.vertexCount);
+		out_resource->vbTexcoord_.resize(uv_size * out_format.vertexCount);
+		out_resource->indexBuffer_.resize(ib_size * out_format.indexCount);
+		out_resource->meshletPackedPrimitive_.resize(pb_size * out_format.meshletPrimitiveCount);
+		out_resource->meshletVertexIndex_.resize(vib_size * out_format.meshletVertexIndexCount);
+		out_resource->submeshes_.reserve(mesh.GetSubmeshes().size());
+
+		uint32_t vb_offset = 0;
+		uint32_t ib_offset = 0;
+		uint32_t pb_offset = 0;
+		uint32_t vib_offset = 0;
+		for (size_t submesh_index = 0; submesh_index < mesh.GetSubmeshes().size(); submesh_index++)
+		{
+			auto&& submesh = mesh.GetSubmeshes()[submesh_index];
+			sl12::ResourceMeshSubmesh out_sub;
+			out_sub.materialIndex_ = submesh->GetMaterialIndex();
+
+			auto&& src_vb = submesh->GetVertexBuffer();
+			auto&& src_ib = submesh->GetIndexBuffer();
+			EncodeVertexStreams(src_vb.data(), src_vb.size(), out_format, out_format.submeshes[submesh_index],
+				out_resource->vbPosition_.data() + pos_size * vb_offset,
+				out_resource->vbNormal_.data() + normal_size * vb_offset,
+				out_resource->vbTangent_.data() + tangent_size * vb_offset,
+				out_resource->vbTexcoord_.data() + uv_size * vb_offset);
+			CopyIndexStream(out_format, submesh_index, *submesh, StreamKind::Index, out_resource->indexBuffer_.data() + ib_size * ib_offset);
+			CopyIndexStream(out_format, submesh_index, *submesh, StreamKind::MeshletPrimitive, out_resource->meshletPackedPrimitive_.data() + pb_size * pb_offset);
+			CopyIndexStream(out_format, submesh_index, *submesh, StreamKind::MeshletVertexIndex, out_resource->meshletVertexIndex_.data() + vib_size * vib_offset);
+
+			out_sub.vertexOffset_ = vb_offset;
+			out_sub.vertexCount_ = (uint32_t)src_vb.size();
+			out_sub.indexOffset_ = ToSubmeshIndexOffset(out_format, submesh_index, ib_offset);
+			out_sub.indexCount_ = (uint32_t)src_ib.size();
+			out_sub.meshletPrimitiveOffset_ = pb_offset;
+			out_sub.meshletPrimitiveCount_ = GetPartElementCount(out_format, submesh_index, *submesh, StreamKind::MeshletPrimitive, 0);
+			out_sub.meshletVertexIndexOffset_ = vib_offset;
+			out_sub.meshletVertexIndexCount_ = GetPartElementCount(out_format, submesh_index, *submesh, StreamKind::MeshletVertexIndex, 0);
+			vb_offset += out_sub.vertexCount_;
+			ib_offset += (uint32_t)GetStreamElementCount(out_format, submesh_index, *submesh, StreamKind::Index);
+			pb_offset += (uint32_t)GetStreamElementCount(out_format, submesh_index, *submesh, StreamKind::MeshletPrimitive);
+			vib_offset += (uint32_t)GetStreamElementCount(out_format, submesh_index, *submesh, StreamKind::MeshletVertexIndex);
+
+			out_sub.boundingSphere_.centerX = submesh->GetBoundingSphere().center.x;
+			out_sub.boundingSphere_.centerY = submesh->GetBoundingSphere().center.y;
+			out_sub.boundingSphere_.centerZ = submesh->GetBoundingSphere().center.z;
+			out_sub.boundingSphere_.radius = submesh->GetBoundingSphere().radius;
+			out_sub.boundingBox_.minX = submesh->GetBoundingBox().aabbMin.x;
+			out_sub.boundingBox_.minY = submesh->GetBoundingBox().aabbMin.y;
+			out_sub.boundingBox_.minZ = submesh->GetBoundingBox().aabbMin.z;
+			out_sub.boundingBox_.maxX = submesh->GetBoundingBox().aabbMax.x;
+			out_sub.boundingBox_.maxY = submesh->GetBoundingBox().aabbMax.y;
+			out_sub.boundingBox_.maxZ = submesh->GetBoundingBox().aabbMax.z;
+
+			PrimitiveOffsetCounter primitive_offsets(out_format.meshletEncoding);
+			for (auto&& meshlet : submesh->GetMeshlets())
+			{
+				sl12::ResourceMeshMeshlet m;
+				m.indexOffset_ = meshlet.indexOffset;
+				m.indexCount_ = meshlet.indexCount;
+				m.primitiveOffset_ = primitive_offsets.Next(meshlet);
+				m.primitiveCount_ = meshlet.primitiveCount;
+				m.vertexIndexOffset_ = meshlet.vertexIndexOffset;
+				m.vertexIndexCount_ = meshlet.vertexIndexCount;
+				m.boundingSphere_.centerX = meshlet.boundingSphere.center.x;
+				m.boundingSphere_.centerY = meshlet.boundingSphere.center.y;
+				m.boundingSphere_.centerZ = meshlet.boundingSphere.center.z;
+				m.boundingSphere_.radius = meshlet.boundingSphere.radius;
+				m.boundingBox_.minX = meshlet.boundingBox.aabbMin.x;
+				m.boundingBox_.minY = meshlet.boundingBox.aabbMin.y;
+				m.boundingBox_.minZ = meshlet.boundingBox.aabbMin.z;
+				m.boundingBox_.maxX = meshlet.boundingBox.aabbMax.x;
+				m.boundingBox_.maxY = meshlet.boundingBox.aabbMax.y;
+				m.boundingBox_.maxZ = meshlet.boundingBox.aabbMax.z;
+				m.cone_.apexX = meshlet.cone.apex.x;
+				m.cone_.apexY = meshlet.cone.apex.y;
+				m.cone_.apexZ = meshlet.cone.apex.z;
+				m.cone_.axisX = meshlet.cone.axis.x;
+				m.cone_.axisY = meshlet.cone.axis.y;
+				m.cone_.axisZ = meshlet.cone.axis.z;
+				m.cone_.cutoff = meshlet.cone.cutoff;
+				out_sub.meshlets_.push_back(m);
+			}
+
+			out_resource->submeshes_.push_back(std::move(out_sub));
+
+			// the working set of this submesh is not needed any more.
+			if (releaseGeometry)
+			{
+				mesh.ReleaseSubmeshGeometry(submesh_index);
+			}
+		}
+
+		// compress buffers.
+		if (options.compressMesh)
+		{
+			struct CompressTarget
+			{
+				std::vector<sl12::u8>*	pBuffer;
+				size_t					elementSize;	// 0 means index buffer.
+			};
+			CompressTarget targets[] = {
+				{ &out_resource->vbPosition_, pos_size },
+				{ &out_resource->vbNormal_, normal_size },
+				{ &out_resource->vbTangent_, tangent_size },
+				{ &out_resource->vbTexcoord_, uv_size },
+				{ &out_resource->indexBuffer_, 0 },
+				{ &out_resource->meshletPackedPrimitive_, GetStreamCodecElementSize(out_format, StreamKind::MeshletPrimitive) },
+				{ &out_resource->meshletVertexIndex_, GetStreamCodecElementSize(out_format, StreamKind::MeshletVertexIndex) },
+			};
+			static const size_t kTargetCount = sizeof(targets) / sizeof(targets[0]);
+
+			size_t raw_size = 0;
+			for (auto&& t : targets)
+			{
+				raw_size += t.pBuffer->size();
+			}
+			ParallelFor(pJobSystem, kTargetCount, [&](size_t index)
+			{
+				auto&& t = targets[index];
+				if (t.elementSize == 0)
+				{
+					EncodeIndexStream(*t.pBuffer, out_format.indexUnitSize);
+				}
+				else
+				{
+					EncodeVertexStream(*t.pBuffer, t.elementSize);
+				}
+			});
+			size_t compressed_size = 0;
+			for (auto&& t : targets)
+			{
+				compressed_size += t.pBuffer->size();
+			}
+
+			out_format.compression = RMeshCompression::Meshopt;
+			fprintf(stdout, "compressed mesh buffers: %zu -> %zu bytes. (ratio: %.2f)\n",
+				raw_size, compressed_size, compressed_size ? (double)raw_size / (double)compressed_size : 0.0);
+		}
+
+		{
+			std::fstream ofs(options.outputFilePath, std::ios::out | std::ios::binary);
+			if (!ofs)
+			{
+				return false;
+			}
+			{
+				cereal::BinaryOutputArchive ar(ofs);
+				ar(cereal::make_nvp("mesh", *out_resource));
+				ar(cereal::make_nvp("format", out_format));
+			}
+			*pOutSize = (size_t)ofs.tellp();
+			if (!ofs)
+			{
+				return false;
+			}
+		}
+		fprintf(stdout, "vertex streams: %zu bytes per vertex, %u vertices.\n", pos_size + normal_size + tangent_size + uv_size, vb_offset);
+		return true;
+	}
+
+	bool WriteRMeshContainer(const MeshWork& mesh, const ToolOptions& options, size_t* pOutSize)
+	{
+		RMeshFormat format;
+		SetupFormat(mesh, options, format);
+
+		// small sections.
+		std::vector<char> strings;
+		auto AddString = [&](const std::string& str)
+		{
+			uint32_t offset = (uint32_t)strings.size();
+			strings.insert(strings.end(), str.begin(), str.end());
+			strings.push_back('\0');
+			return offset;
+		};
+
+		std::vector<RMeshContainerMaterial> materials;
+		for (auto&& mat : mesh.GetMaterials())
+		{
+			RMeshContainerMaterial m = {};
+			m.nameOffset = AddString(mat->GetName());
+			for (int i = 0; i < MaterialWork::TextureKind::Max; i++)
+			{
+				auto name = mat->GetTextrues()[i];
+				m.textureNameOffsets[i] = AddString(options.textureDDS ? PNGtoDDS(name) : name);
+			}
+			m.isOpaque = mat->IsOpaque() ? 1 : 0;
+			materials.push_back(m);
+		}
+
+		std::vector<RMeshContainerSubmesh> submeshes;
+		std::vector<RMeshContainerMeshlet> meshlets;
+		auto ToContainerMeshlet = [](const RMeshMeshlet& src)
+		{
+			RMeshContainerMeshlet m = {};
+			m.indexOffset = src.indexOffset;
+			m.indexCount = src.indexCount;
+			m.primitiveOffset = src.primitiveOffset;
+			m.primitiveCount = src.primitiveCount;
+			m.vertexIndexOffset = src.vertexIndexOffset;
+			m.vertexIndexCount = src.vertexIndexCount;
+			memcpy(m.boundingSphere, src.boundingSphere, sizeof(m.boundingSphere));
+			memcpy(m.boundingBox, src.boundingBox, sizeof(m.boundingBox));
+			memcpy(m.coneApex, src.coneApex, sizeof(m.coneApex));
+			memcpy(m.coneAxis, src.coneAxis, sizeof(m.coneAxis));
+			m.coneCutoff = src.coneCutoff;
+			return m;
+		};
+
+		uint32_t vb_offset = 0, ib_offset = 0, pb_offset = 0, vib_offset = 0, lod_offset = 0;
+		for (size_t submesh_index = 0; submesh_index < mesh.GetSubmeshes().size(); submesh_index++)
+		{
+			auto&& submesh = *mesh.GetSubmeshes()[submesh_index];
+			auto&& sub_format = format.submeshes[submesh_index];
+
+			RMeshContainerSubmesh s = {};
+			s.materialIndex = submesh.GetMaterialIndex();
+			s.vertexOffset = vb_offset;
+			s.vertexCount = (uint32_t)submesh.GetVertexBuffer().size();
+			s.indexOffset = ToSubmeshIndexOffset(format, submesh_index, ib_offset);
+			s.indexCount = (uint32_t)submesh.GetIndexBuffer().size();
+			s.meshletOffset = (uint32_t)meshlets.size();
+			s.meshletCount = (uint32_t)submesh.GetMeshlets().size();
+			s.meshletPrimitiveOffset = pb_offset;
+			s.meshletPrimitiveCount = GetPartElementCount(format, submesh_index, submesh, StreamKind::MeshletPrimitive, 0);
+			s.meshletVertexIndexOffset = vib_offset;
+			s.meshletVertexIndexCount = GetPartElementCount(format, submesh_index, submesh, StreamKind::MeshletVertexIndex, 0);
+			s.meshletVertexIndexSize = format.meshletVertexIndexSizes[submesh_index];
+			s.indexSize = format.indexSizes[submesh_index];
+			vb_offset += s.vertexCount;
+			ib_offset += (uint32_t)GetStreamElementCount(format, submesh_index, submesh, StreamKind::Index);
+			pb_offset += (uint32_t)GetStreamElementCount(format, submesh_index, submesh, StreamKind::MeshletPrimitive);
+			vib_offset += (uint32_t)GetStreamElementCount(format, submesh_index, submesh, StreamKind::MeshletVertexIndex);
+
+			memcpy(s.boundingSphere, &submesh.GetBoundingSphere(), sizeof(s.boundingSphere));
+			memcpy(s.boundingBox, &submesh.GetBoundingBox(), sizeof(s.boundingBox));
+			s.posOffset[0] = sub_format.posOffsetX; s.posOffset[1] = sub_format.posOffsetY; s.posOffset[2] = sub_format.posOffsetZ;
+			s.posScale[0] = sub_format.posScaleX; s.posScale[1] = sub_format.posScaleY; s.posScale[2] = sub_format.posScaleZ;
+			s.uvOffset[0] = sub_format.uvOffsetX; s.uvOffset[1] = sub_format.uvOffsetY;
+			s.uvScale[0] = sub_format.uvScaleX; s.uvScale[1] = sub_format.uvScaleY;
+			s.lodOffset = lod_offset;
+			s.lodCount = (uint32_t)submesh.GetLods().size();
+			lod_offset += s.lodCount;
+			submeshes.push_back(s);
+
+			PrimitiveOffsetCounter primitive_offsets(format.meshletEncoding);
+			for (auto&& meshlet : submesh.GetMeshlets())
+			{
+				RMeshMeshlet m;
+				ConvertMeshlet(meshlet, primitive_offsets.Next(meshlet), m);
+				meshlets.push_back(ToContainerMeshlet(m));
+			}
+		}
+
+		// LOD meshlets follow the meshlets of all submeshes.
+		std::vector<RMeshContainerLod> lods;
+		uint32_t lod_meshlet_base = (uint32_t)meshlets.size();
+		for (auto&& lod : format.lods)
+		{
+			RMeshContainerLod l = {};
+			l.level = lod.level;
+			l.indexOffset = lod.indexOffset;
+			l.indexCount = lod.indexCount;
+			l.meshletOffset = lod_meshlet_base + lod.meshletOffset;
+			l.meshletCount = lod.meshletCount;
+			l.meshletPrimitiveOffset = lod.meshletPrimitiveOffset;
+			l.meshletPrimitiveCount = lod.meshletPrimitiveCount;
+			l.meshletVertexIndexOffset = lod.meshletVertexIndexOffset;
+			l.meshletVertexIndexCount = lod.meshletVertexIndexCount;
+			l.error = lod.error;
+			lods.push_back(l);
+		}
+		for (auto&& meshlet : format.lodMeshlets)
+		{
+			meshlets.push_back(ToContainerMeshlet(meshlet));
+		}
+
+		std::vector<RMeshContainerDag> dags;
+		for (auto&& dag : format.dags)
+		{
+			RMeshContainerDag d = {};
+			d.clusterOffset = dag.clusterOffset;
+			d.clusterCount = dag.clusterCount;
+			d.indexOffset = dag.indexOffset;
+			d.indexCount = dag.indexCount;
+			d.meshletPrimitiveOffset = dag.meshletPrimitiveOffset;
+			d.meshletPrimitiveCount = dag.meshletPrimitiveCount;
+			d.meshletVertexIndexOffset = dag.meshletVertexIndexOffset;
+			d.meshletVertexIndexCount = dag.meshletVertexIndexCount;
+			d.levelCount = dag.levelCount;
+			dags.push_back(d);
+		}
+		std::vector<RMeshContainerDagCluster> dag_clusters;
+		for (auto&& cluster : format.dagClusters)
+		{
+			RMeshContainerDagCluster c = {};
+			c.meshlet = ToContainerMeshlet(cluster.meshlet);
+			c.level = cluster.level;
+			c.error = cluster.error;
+			c.parentError = cluster.parentError;
+			memcpy(c.lodBounds, cluster.lodBounds, sizeof(c.lodBounds));
+			memcpy(c.parentLodBounds, cluster.parentLodBounds, sizeof(c.parentLodBounds));
+			dag_clusters.push_back(c);
+		}
+
+		std::vector<RMeshContainerInstancedMesh> instanced_meshes;
+		for (auto&& instanced_mesh : format.instancedMeshes)
+		{
+			RMeshContainerInstancedMesh m = {};
+			m.submeshOffset = instanced_mesh.submeshOffset;
+			m.submeshCount = instanced_mesh.submeshCount;
+			instanced_meshes.push_back(m);
+		}
+		std::vector<RMeshContainerInstance> instances;
+		for (auto&& instance : format.instances)
+		{
+			RMeshContainerInstance inst = {};
+			memcpy(inst.transform, instance.transform, sizeof(inst.transform));
+			inst.meshIndex = instance.meshIndex;
+			instances.push_back(inst);
+		}
+
+		RMeshContainerHeader header = {};
+		header.magic = RMeshContainerHeader::kMagic;
+		header.version = RMeshContainerHeader::kVersion;
+		header.headerSize = sizeof(RMeshContainerHeader);
+		header.sectionCount = RMeshContainerSectionType::Max;
+		header.sectionTableOffset = sizeof(RMeshContainerHeader);
+		header.positionFormat = format.positionFormat;
+		header.normalFormat = format.normalFormat;
+		header.tangentFormat = format.tangentFormat;
+		header.texcoordFormat = format.texcoordFormat;
+		header.compression = options.compressMesh ? RMeshCompression::Meshopt : RMeshCompression::None;
+		header.materialCount = (uint32_t)materials.size();
+		header.submeshCount = (uint32_t)submeshes.size();
+		header.meshletCount = (uint32_t)meshlets.size();
+		header.lodCount = (uint32_t)lods.size();
+		header.meshletMaxVertices = (uint16_t)format.meshletMaxVertices;
+		header.meshletMaxTriangles = (uint16_t)format.meshletMaxTriangles;
+		header.meshletEncoding = format.meshletEncoding;
+		memcpy(header.boundingSphere, &mesh.GetBoundingSphere(), sizeof(header.boundingSphere));
+		memcpy(header.boundingBox, &mesh.GetBoundingBox(), sizeof(header.boundingBox));
+
+		std::fstream ofs(options.outputFilePath, std::ios::out | std::ios::binary);
+		if (!ofs)
+		{
+			return false;
+		}
+
+		// header and section table are written again at the end.
+		RMeshContainerSection sections[RMeshContainerSectionType::Max] = {};
+		ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		ofs.write(reinterpret_cast<const char*>(sections), sizeof(sections));
+
+		auto BeginSection = [&](uint32_t type, size_t elementSize, size_t elementCount)
+		{
+			static const char kZero[RMeshContainerHeader::kSectionAlignment] = {};
+			uint64_t pos = (uint64_t)ofs.tellp();
+			uint64_t aligned = (pos + RMeshContainerHeader::kSectionAlignment - 1) / RMeshContainerHeader::kSectionAlignment * RMeshContainerHeader::kSectionAlignment;
+			ofs.write(kZero, (std::streamsize)(aligned - pos));
+
+			auto&& section = sections[type];
+			section.type = type;
+			section.elementSize = (uint32_t)elementSize;
+			section.offset = aligned;
+			section.elementCount = elementCount;
+		};
+		auto EndSection = [&](uint32_t type)
+		{
+			sections[type].size = (uint64_t)ofs.tellp() - sections[type].offset;
+		};
+		auto WriteSection = [&](uint32_t type, const void* pData, size_t elementSize, size_t elementCount)
+		{
+			BeginSection(type, elementSize, elementCount);
+			ofs.write(static_cast<const char*>(pData), (std::streamsize)(elementSize * elementCount));
+			EndSection(type);
+		};
+
+		WriteSection(RMeshContainerSectionType::Strings, strings.data(), 1, strings.size());
+		WriteSection(RMeshContainerSectionType::Materials, materials.data(), sizeof(RMeshContainerMaterial), materials.size());
+		WriteSection(RMeshContainerSectionType::Submeshes, submeshes.data(), sizeof(RMeshContainerSubmesh), submeshes.size());
+		WriteSection(RMeshContainerSectionType::Meshlets, meshlets.data(), sizeof(RMeshContainerMeshlet), meshlets.size());
+		WriteSection(RMeshContainerSectionType::Lods, lods.data(), sizeof(RMeshContainerLod), lods.size());
+		WriteSection(RMeshContainerSectionType::Dags, dags.data(), sizeof(RMeshContainerDag), dags.size());
+		WriteSection(RMeshContainerSectionType::DagClusters, dag_clusters.data(), sizeof(RMeshContainerDagCluster), dag_clusters.size());
+		WriteSection(RMeshContainerSectionType::InstancedMeshes, instanced_meshes.data(), sizeof(RMeshContainerInstancedMesh), instanced_meshes.size());
+		WriteSection(RMeshContainerSectionType::Instances, instances.data(), sizeof(RMeshContainerInstance), instances.size());
+
+		// large streams.
+		static const uint32_t kStreamSections[StreamKind::Max] = {
+			RMeshContainerSectionType::VertexPosition,
+			RMeshContainerSectionType::VertexNormal,
+			RMeshContainerSectionType::VertexTangent,
+			RMeshContainerSectionType::VertexTexcoord,
+			RMeshContainerSectionType::IndexBuffer,
+			RMeshContainerSectionType::MeshletPrimitive,
+			RMeshContainerSectionType::MeshletVertexIndex,
+		};
+		const uint32_t* stream_counts[StreamKind::Max] = {
+			&format.vertexCount, &format.vertexCount, &format.vertexCount, &format.vertexCount,
+			&format.indexCount, &format.meshletPrimitiveCount, &format.meshletVertexIndexCount,
+		};
+		size_t raw_size = 0, compressed_size = 0;
+		for (int kind = 0; kind < StreamKind::Max; kind++)
+		{
+			size_t element_size = GetStreamElementSize(format, kind);
+			size_t element_count = *stream_counts[kind];
+			BeginSection(kStreamSections[kind], element_size, element_count);
+			if (options.compressMesh)
+			{
+				// codecs need the whole stream. only one stream is in memory at a time.
+				std::vector<uint8_t> stream;
+				stream.reserve(element_size * element_count);
+				ProduceStream(mesh, format, kind, [&](const void* pData, size_t size)
+				{
+					stream.insert(stream.end(), static_cast<const uint8_t*>(pData), static_cast<const uint8_t*>(pData) + size);
+				});
+				raw_size += stream.size();
+				if (kind == StreamKind::Index)
+				{
+					EncodeIndexStream(stream, format.indexUnitSize);
+				}
+				else
+				{
+					EncodeVertexStream(stream, GetStreamCodecElementSize(format, kind));
+				}
+				compressed_size += stream.size();
+				ofs.write(reinterpret_cast<const char*>(stream.data()), (std::streamsize)stream.size());
+			}
+			else
+			{
+				ProduceStream(mesh, format, kind, [&](const void* pData, size_t size)
+				{
+					ofs.write(static_cast<const char*>(pData), (std::streamsize)size);
+				});
+			}
+			EndSection(kStreamSections[kind]);
+		}
+
+		header.fileSize = (uint64_t)ofs.tellp();
+		ofs.seekp(0);
+		ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		ofs.write(reinterpret_cast<const char*>(sections), sizeof(sections));
+		if (!ofs)
+		{
+			return false;
+		}
+		*pOutSize = (size_t)header.fileSize;
+
+		if (options.compressMesh)
+		{
+			fprintf(stdout, "compressed mesh buffers: %zu -> %zu bytes. (ratio: %.2f)\n",
+				raw_size, compressed_size, compressed_size ? (double)raw_size / (double)compressed_size : 0.0);
+		}
+		size_t vertex_size = 0;
+		for (int kind = StreamKind::Position; kind <= StreamKind::Texcoord; kind++)
+		{
+			vertex_size += GetStreamElementSize(format, kind);
+		}
+		fprintf(stdout, "vertex streams: %zu bytes per vertex, %u vertices.\n", vertex_size, format.vertexCount);
+		return true;
+	}
+}
+
+bool WriteRMesh(MeshWork& mesh, const ToolOptions& options, JobSystem* pJobSystem, bool releaseGeometry, size_t* pOutSize)
+{
+	size_t dummy_size;
+	if (!pOutSize)
+	{
+		pOutSize = &dummy_size;
+	}
+
+	if (options.containerFormat)
+	{
+		return WriteRMeshContainer(mesh, options, pOutSize);
+	}
+	return WriteRMeshCereal(mesh, options, pJobSystem, releaseGeometry, pOutSize);
+}
+
+
+//	EOF
@@ -0,0 +1,16 @@
+﻿#pragma once
+
+#include <string>
+
+#include "converter.h"
+#include "mesh_work.h"
+
+
+// write the mesh to options.outputFilePath.
+// if options.containerFormat is true, the memory mappable container is written. (see rmesh_container.h)
+// otherwise, sl12::ResourceMesh and RMeshFormat are written with cereal binary archive.
+// if releaseGeometry is true, submesh buffers are released as soon as they are copied to the output,
+// so that the peak memory is about the size of the mesh working set.
+bool WriteRMesh(MeshWork& mesh, const ToolOptions& options, JobSystem* pJobSystem, bool releaseGeometry, size_t* pOutSize);
+
+//	EOF
@@ -0,0 +1,311 @@
+﻿#include "server.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <list>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <iostream>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+
+namespace
+{
+	// convert a request line. empty string means no response (empty or comment lines).
+	std::string ProcessRequest(const std::string& line, const ToolOptions& baseOptions, ConvertContext& context)
+	{
+		auto args = SplitArguments(line);
+		if (args.empty() || args[0][0] == '#')
+		{
+			return "";
+		}
+
+		ToolOptions options = baseOptions;
+		bool is_valid = false;
+		try
+		{
+			// numeric options throw on invalid values. a bad request must not stop the server.
+			is_valid = ParseToolOptions(args, options, nullptr) && FinalizeToolOptions(options);
+		}
+		catch (const std::exception&)
+		{
+			is_valid = false;
+		}
+		if (!is_valid)
+		{
+			return "error invalid request\n";
+		}
+
+		ConvertResult result;
+		bool succeeded = false;
+		try
+		{
+			// a malformed glTF throws from the parser. it fails only the request.
+			succeeded = ConvertFile(options, context, &result);
+		}
+		catch (const std::exception& e)
+		{
+			fprintf(stderr, "failed to read glTF. (%s)\n", e.what());
+		}
+		if (!succeeded)
+		{
+			return "error failed to convert " + options.inputFileName + "\n";
+		}
+
+		char buf[256];
+		snprintf(buf, sizeof(buf), "ok %.4f %zu %zu %zu %s\n",
+			result.elapsedSeconds,
+			result.submeshCount,
+			result.textureCount,
+			result.outputSize,
+			result.isCacheHit ? "cached" : "converted");
+		return buf;
+	}
+
+	bool IsQuitRequest(const std::string& line)
+	{
+		auto args = SplitArguments(line);
+		return args.size() == 1 && args[0] == "quit";
+	}
+
+	int RunStdinServer(const ToolOptions& baseOptions, ConvertContext& context)
+	{
+		// stdout is used for responses only. logs of conversions go to stderr.
+#if defined(_WIN32)
+		int response_fd = _dup(_fileno(stdout));
+		FILE* pResponse = (response_fd >= 0) ? _fdopen(response_fd, "w") : nullptr;
+		fflush(stdout);
+		_dup2(_fileno(stderr), _fileno(stdout));
+#else
+		int response_fd = dup(fileno(stdout));
+		FILE* pResponse = (response_fd >= 0) ? fdopen(response_fd, "w") : nullptr;
+		fflush(stdout);
+		dup2(fileno(stderr), fileno(stdout));
+#endif
+		if (!pResponse)
+		{
+			fprintf(stderr, "failed to open response stream.\n");
+			return -1;
+		}
+
+		std::string line;
+		while (std::getline(std::cin, line))
+		{
+			if (IsQuitRequest(line))
+			{
+				break;
+			}
+			auto response = ProcessRequest(line, baseOptions, context);
+			if (!response.empty())
+			{
+				fputs(response.c_str(), pResponse);
+				fflush(pResponse);
+			}
+		}
+		fclose(pResponse);
+		return 0;
+	}
+
+#if defined(_WIN32)
+	int RunSocketServer(const std::string& path, const ToolOptions& baseOptions, ConvertContext& context)
+	{
+		fprintf(stderr, "socket server is not supported on this platform. use -serve stdin. (%s)\n", path.c_str());
+		return -1;
+	}
+#else
+	class SocketServer
+	{
+	public:
+		SocketServer(const ToolOptions& baseOptions, ConvertContext& context)
+			: baseOptions_(baseOptions), context_(context)
+		{}
+		~SocketServer()
+		{}
+
+		int Run(const std::string& path)
+		{
+			sockaddr_un addr = {};
+			addr.sun_family = AF_UNIX;
+			if (path.size() >= sizeof(addr.sun_path))
+			{
+				fprintf(stderr, "socket path is too long. (%s)\n", path.c_str());
+				return -1;
+			}
+			memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+			listenFd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+			if (listenFd_ < 0)
+			{
+				fprintf(stderr, "failed to create socket. (%s)\n", path.c_str());
+				return -1;
+			}
+			unlink(path.c_str());
+			if (bind(listenFd_, (const sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd_, 16) != 0)
+			{
+				fprintf(stderr, "failed to listen socket. (%s)\n", path.c_str());
+				close(listenFd_);
+				return -1;
+			}
+			fprintf(stdout, "listening. (%s)\n", path.c_str());
+			fflush(stdout);
+
+			std::list<Client> clients;
+			while (!isQuit_)
+			{
+				int fd = accept(listenFd_, nullptr, nullptr);
+
+				// join the threads of closed connections, so that a long running server does not keep them.
+				for (auto it = clients.begin(); it != clients.end(); )
+				{
+					if (it->isDone)
+					{
+						it->thread.join();
+						it = clients.erase(it);
+					}
+					else
+					{
+						++it;
+					}
+				}
+
+				if (fd < 0)
+				{
+					// listen socket is shut down by a quit request.
+					if (isQuit_)
+					{
+						break;
+					}
+					continue;
+				}
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					clientFds_.push_back(fd);
+				}
+				clients.emplace_back();
+				Client* pClient = &clients.back();
+				pClient->thread = std::thread([this, fd, pClient]
+				{
+					ServeClient(fd);
+
+					std::lock_guard<std::mutex> lock(mutex_);
+					clientFds_.erase(std::find(clientFds_.begin(), clientFds_.end(), fd));
+					close(fd);
+					pClient->isDone = true;
+				});
+			}
+
+			for (auto&& client : clients)
+			{
+				client.thread.join();
+			}
+			close(listenFd_);
+			unlink(path.c_str());
+			return 0;
+		}
+
+	private:
+		void ServeClient(int fd)
+		{
+			std::string pending;
+			char buf[4096];
+			while (!isQuit_)
+			{
+				ssize_t size = recv(fd, buf, sizeof(buf), 0);
+				if (size <= 0)
+				{
+					break;
+				}
+				pending.append(buf, (size_t)size);
+
+				size_t line_start = 0, line_end;
+				while ((line_end = pending.find('\n', line_start)) != std::string::npos)
+				{
+					std::string line = pending.substr(line_start, line_end - line_start);
+					line_start = line_end + 1;
+					if (IsQuitRequest(line))
+					{
+						Quit();
+						return;
+					}
+					auto response = ProcessRequest(line, baseOptions_, context_);
+					if (!response.empty() && !SendAll(fd, response))
+					{
+						return;
+					}
+				}
+				pending.erase(0, line_start);
+			}
+		}
+
+		bool SendAll(int fd, const std::string& data)
+		{
+			size_t offset = 0;
+			while (offset < data.size())
+			{
+				ssize_t size = send(fd, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+				if (size <= 0)
+				{
+					return false;
+				}
+				offset += (size_t)size;
+			}
+			return true;
+		}
+
+		void Quit()
+		{
+			// wake up accept() and recv() of the other clients.
+			isQuit_ = true;
+			shutdown(listenFd_, SHUT_RDWR);
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (auto fd : clientFds_)
+			{
+				shutdown(fd, SHUT_RDWR);
+			}
+		}
+
+	private:
+		struct Client
+		{
+			std::thread			thread;
+			std::atomic<bool>	isDone{ false };
+		};	// struct Client
+
+	private:
+		const ToolOptions&	baseOptions_;
+		ConvertContext&		context_;
+		int					listenFd_ = -1;
+		std::atomic<bool>	isQuit_{ false };
+		std::mutex			mutex_;
+		std::vector<int>	clientFds_;
+	};	// class SocketServer
+
+	int RunSocketServer(const std::string& path, const ToolOptions& baseOptions, ConvertContext& context)
+	{
+		SocketServer server(baseOptions, context);
+		return server.Run(path);
+	}
+#endif
+}
+
+int RunServer(const std::string& path, const ToolOptions& baseOptions, ConvertContext& context)
+{
+	if (path == "stdin")
+	{
+		return RunStdinServer(baseOptions, context);
+	}
+	return RunSocketServer(path, baseOptions, context);
+}
+
+
+//	EOF
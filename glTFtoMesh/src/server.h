@@ -0,0 +1,16 @@
+﻿#pragma once
+
+#include <string>
+
+#include "converter.h"
+
+
+// run as a conversion server until "quit" is requested.
+// path is "stdin", or a unix socket path. each request is one line of options in the manifest format,
+// and baseOptions are used as defaults of each request. responses are one line for each request:
+//   ok <seconds> <submesh count> <texture count> <output bytes> <cached|converted>
+//   error <message>
+// in stdin mode, responses are written to stdout and logs of conversions are redirected to stderr.
+int RunServer(const std::string& path, const ToolOptions& baseOptions, ConvertContext& context);
+
+//	EOF
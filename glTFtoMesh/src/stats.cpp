@@ -0,0 +1,293 @@
+﻿#include "stats.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <map>
+#include <algorithm>
+
+
+namespace
+{
+	std::atomic<bool>		g_IsTracking{ false };
+	std::atomic<size_t>		g_CurrentBytes{ 0 };
+	std::atomic<size_t>		g_PeakBytes{ 0 };			// peak since the last FoldPeak().
+	std::atomic<uint64_t>	g_TotalBytes{ 0 };
+	thread_local uint64_t	t_AllocatedBytes = 0;
+
+	// peaks of the running windows. they are updated only when a window begins or ends.
+	std::mutex					g_WindowMutex;
+	std::map<uint64_t, size_t>	g_WindowPeaks;
+	uint64_t					g_NextWindowId = 0;
+	size_t						g_ProcessPeakBytes = 0;
+
+	// the header keeps the allocation size, whether it is tracked, and the alignment of malloc.
+	static const size_t		kHeaderSize = 16;
+
+	void* TrackedAlloc(size_t size)
+	{
+		auto p = static_cast<uint8_t*>(malloc(size + kHeaderSize));
+		if (!p)
+		{
+			return nullptr;
+		}
+		bool is_tracking = g_IsTracking.load(std::memory_order_relaxed);
+		reinterpret_cast<size_t*>(p)[0] = size;
+		reinterpret_cast<size_t*>(p)[1] = is_tracking ? 1 : 0;
+		if (!is_tracking)
+		{
+			return p + kHeaderSize;
+		}
+
+		size_t current = g_CurrentBytes.fetch_add(size, std::memory_order_relaxed) + size;
+		size_t peak = g_PeakBytes.load(std::memory_order_relaxed);
+		while (current > peak && !g_PeakBytes.compare_exchange_weak(peak, current, std::memory_order_relaxed))
+		{}
+		g_TotalBytes.fetch_add(size, std::memory_order_relaxed);
+		t_AllocatedBytes += size;
+
+		return p + kHeaderSize;
+	}
+
+	void TrackedFree(void* ptr)
+	{
+		if (!ptr)
+		{
+			return;
+		}
+		auto p = static_cast<uint8_t*>(ptr) - kHeaderSize;
+		// memory allocated before tracking was enabled is not in the counters.
+		if (reinterpret_cast<size_t*>(p)[1])
+		{
+			g_CurrentBytes.fetch_sub(reinterpret_cast<size_t*>(p)[0], std::memory_order_relaxed);
+		}
+		free(p);
+	}
+
+	// the peak since the last fold belongs to all running windows. restart it from the current bytes.
+	// g_WindowMutex must be locked.
+	void FoldPeak()
+	{
+		size_t peak = g_PeakBytes.exchange(g_CurrentBytes.load(std::memory_order_relaxed));
+		for (auto&& window : g_WindowPeaks)
+		{
+			window.second = std::max(window.second, peak);
+		}
+		g_ProcessPeakBytes = std::max(g_ProcessPeakBytes, peak);
+	}
+
+	std::string EscapeJson(const std::string& str)
+	{
+		std::string ret;
+		ret.reserve(str.length() + 2);
+		for (auto&& c : str)
+		{
+			switch (c)
+			{
+			case '"':	ret += "\\\""; break;
+			case '\\':	ret += "\\\\"; break;
+			case '\n':	ret += "\\n"; break;
+			case '\t':	ret += "\\t"; break;
+			default:
+				if ((unsigned char)c < 0x20)
+				{
+					char buf[8];
+					snprintf(buf, sizeof(buf), "\\u%04x", c);
+					ret += buf;
+				}
+				else
+				{
+					ret += c;
+				}
+				break;
+			}
+		}
+		return ret;
+	}
+}
+
+// the replacement is linked into every build. without EnableAllocationTracking() it only costs the header
+// per allocation and a relaxed load.
+void* operator new(size_t size)
+{
+	// call the new handler until the allocation succeeds, as the default operator new does.
+	for (;;)
+	{
+		void* p = TrackedAlloc(size);
+		if (p)
+		{
+			return p;
+		}
+		auto handler = std::get_new_handler();
+		if (!handler)
+		{
+			throw std::bad_alloc();
+		}
+		handler();
+	}
+}
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	// the new handler may throw std::bad_alloc.
+	try
+	{
+		return operator new(size);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+void operator delete(void* ptr) noexcept
+{
+	TrackedFree(ptr);
+}
+void operator delete[](void* ptr) noexcept
+{
+	TrackedFree(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept
+{
+	TrackedFree(ptr);
+}
+void operator delete[](void* ptr, size_t) noexcept
+{
+	TrackedFree(ptr);
+}
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+	TrackedFree(ptr);
+}
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+	TrackedFree(ptr);
+}
+
+void EnableAllocationTracking()
+{
+	g_IsTracking = true;
+}
+
+size_t GetCurrentAllocatedBytes()
+{
+	return g_CurrentBytes.load();
+}
+
+size_t GetPeakAllocatedBytes()
+{
+	std::lock_guard<std::mutex> lock(g_WindowMutex);
+	return std::max(g_ProcessPeakBytes, g_PeakBytes.load());
+}
+
+void ResetPeakAllocatedBytes()
+{
+	std::lock_guard<std::mutex> lock(g_WindowMutex);
+	g_ProcessPeakBytes = 0;
+	g_PeakBytes.store(g_CurrentBytes.load());
+}
+
+uint64_t BeginAllocationPeak()
+{
+	std::lock_guard<std::mutex> lock(g_WindowMutex);
+	FoldPeak();
+	uint64_t id = g_NextWindowId++;
+	g_WindowPeaks[id] = g_PeakBytes.load();
+	return id;
+}
+
+size_t EndAllocationPeak(uint64_t id)
+{
+	std::lock_guard<std::mutex> lock(g_WindowMutex);
+	FoldPeak();
+	auto it = g_WindowPeaks.find(id);
+	if (it == g_WindowPeaks.end())
+	{
+		return 0;
+	}
+	size_t peak = it->second;
+	g_WindowPeaks.erase(it);
+	return peak;
+}
+
+uint64_t GetTotalAllocatedBytes()
+{
+	return g_TotalBytes.load(std::memory_order_relaxed);
+}
+
+uint64_t GetThreadAllocatedBytes()
+{
+	return t_AllocatedBytes;
+}
+
+void ConvertStats::WriteJson(FILE* fp, const char* indent) const
+{
+	fprintf(fp, "%s{\n", indent);
+	fprintf(fp, "%s  \"input\": \"%s\",\n", indent, EscapeJson(inputFile_).c_str());
+	fprintf(fp, "%s  \"totalSeconds\": %.6f,\n", indent, totalSeconds_);
+	fprintf(fp, "%s  \"peakAllocatedBytes\": %zu,\n", indent, peakBytes_);
+
+	static const char* kCategories[] = { "stage", "submesh", "texture" };
+	static const char* kArrayNames[] = { "stages", "submeshes", "textures" };
+	for (int c = 0; c < 3; c++)
+	{
+		fprintf(fp, "%s  \"%s\": [", indent, kArrayNames[c]);
+		bool is_first = true;
+		for (auto&& r : records_)
+		{
+			if (r.category != kCategories[c])
+			{
+				continue;
+			}
+			fprintf(fp, "%s\n%s    { ", is_first ? "" : ",", indent);
+			if (c == 1)
+			{
+				fprintf(fp, "\"submesh\": %s, ", r.target.c_str());
+			}
+			else if (c == 2)
+			{
+				fprintf(fp, "\"texture\": \"%s\", ", EscapeJson(r.target).c_str());
+			}
+			fprintf(fp, "\"name\": \"%s\", \"seconds\": %.6f, \"allocatedBytes\": %llu }",
+				EscapeJson(r.name).c_str(), r.seconds, (unsigned long long)r.allocatedBytes);
+			is_first = false;
+		}
+		fprintf(fp, "%s]%s\n", is_first ? "" : ("\n" + std::string(indent) + "  ").c_str(), (c < 2) ? "," : "");
+	}
+	fprintf(fp, "%s}", indent);
+}
+
+bool WriteStatsJson(const std::string& filePath, const std::vector<const ConvertStats*>& stats)
+{
+	FILE* fp = fopen(filePath.c_str(), "w");
+	if (!fp)
+	{
+		return false;
+	}
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"version\": 1,\n");
+	fprintf(fp, "  \"peakAllocatedBytes\": %zu,\n", GetPeakAllocatedBytes());
+	fprintf(fp, "  \"files\": [\n");
+	for (size_t i = 0; i < stats.size(); i++)
+	{
+		stats[i]->WriteJson(fp, "    ");
+		fprintf(fp, "%s\n", (i + 1 < stats.size()) ? "," : "");
+	}
+	fprintf(fp, "  ]\n");
+	fprintf(fp, "}\n");
+
+	fclose(fp);
+	return true;
+}
+
+
+//	EOF
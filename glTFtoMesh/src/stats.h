@@ -0,0 +1,146 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+
+
+// C++ heap allocation counters. (operator new/delete are replaced in stats.cpp)
+// allocations by C libraries (malloc) are not tracked.
+// counters are updated only after EnableAllocationTracking(), so that allocations do not pay for them without stats.
+// the replacement itself is always linked, and every allocation has a 16 bytes header even without stats.
+void EnableAllocationTracking();
+size_t GetCurrentAllocatedBytes();
+size_t GetPeakAllocatedBytes();
+// restart the peak from the current allocated bytes.
+void ResetPeakAllocatedBytes();
+// peak of the allocated bytes between BeginAllocationPeak() and EndAllocationPeak().
+// the counters are process wide, so the peak includes allocations of other jobs running at the same time. (batch mode)
+uint64_t BeginAllocationPeak();
+size_t EndAllocationPeak(uint64_t id);
+// total bytes allocated by all threads since the process started.
+uint64_t GetTotalAllocatedBytes();
+// total bytes allocated by the calling thread.
+uint64_t GetThreadAllocatedBytes();
+
+// statistics of one conversion job. thread safe.
+class ConvertStats
+{
+public:
+	struct Record
+	{
+		std::string		category;			// "stage", "submesh" or "texture".
+		std::string		target;				// submesh index or texture name. empty for "stage".
+		std::string		name;				// stage name.
+		double			seconds;
+		uint64_t		allocatedBytes;		// total (not peak) bytes allocated by the thread executing the stage.
+											// work fanned out to other threads by ParallelFor is not included.
+	};	// struct Record
+
+public:
+	// the peak of the allocated bytes is measured from the construction to SetFileInfo().
+	ConvertStats()
+		: peakWindowId_(BeginAllocationPeak())
+	{}
+	~ConvertStats()
+	{
+		if (!isPeakEnded_)
+		{
+			EndAllocationPeak(peakWindowId_);
+		}
+	}
+
+	void AddRecord(Record&& record)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		records_.push_back(std::move(record));
+	}
+
+	void SetFileInfo(const std::string& inputFile, double totalSeconds)
+	{
+		inputFile_ = inputFile;
+		totalSeconds_ = totalSeconds;
+		if (!isPeakEnded_)
+		{
+			peakBytes_ = EndAllocationPeak(peakWindowId_);
+			isPeakEnded_ = true;
+		}
+	}
+
+	bool IsEmpty() const
+	{
+		return records_.empty();
+	}
+
+	void WriteJson(FILE* fp, const char* indent) const;
+
+private:
+	std::mutex				mutex_;
+	std::vector<Record>		records_;
+	std::string				inputFile_;
+	double					totalSeconds_ = 0.0;
+	size_t					peakBytes_ = 0;				// process wide peak while the file was converted.
+	uint64_t				peakWindowId_;
+	bool					isPeakEnded_ = false;
+};	// class ConvertStats
+
+// record elapsed time and allocated bytes of the scope. do nothing if pStats is null.
+// allocated bytes are the total of the calling thread only. stages which run in ParallelFor record
+// their own jobs. (e.g. "submesh" records in MeshWork)
+class ScopedStats
+{
+public:
+	ScopedStats(ConvertStats* pStats, const char* category, const std::string& target, const char* name)
+		: pStats_(pStats)
+	{
+		if (pStats_)
+		{
+			category_ = category;
+			target_ = target;
+			name_ = name;
+			startBytes_ = GetThreadAllocatedBytes();
+			startTime_ = std::chrono::steady_clock::now();
+		}
+	}
+	ScopedStats(ConvertStats* pStats, const char* name)
+		: ScopedStats(pStats, "stage", std::string(), name)
+	{}
+	~ScopedStats()
+	{
+		Stop();
+	}
+
+	// record the stage now instead of at the end of the scope.
+	void Stop()
+	{
+		if (pStats_)
+		{
+			auto end_time = std::chrono::steady_clock::now();
+			auto end_bytes = GetThreadAllocatedBytes();
+
+			ConvertStats::Record record;
+			record.category = category_;
+			record.target = target_;
+			record.name = name_;
+			record.seconds = std::chrono::duration<double>(end_time - startTime_).count();
+			record.allocatedBytes = end_bytes - startBytes_;
+			pStats_->AddRecord(std::move(record));
+			pStats_ = nullptr;
+		}
+	}
+
+private:
+	ConvertStats*							pStats_;
+	const char*								category_ = nullptr;
+	std::string								target_;
+	const char*								name_ = nullptr;
+	uint64_t								startBytes_ = 0;
+	std::chrono::steady_clock::time_point	startTime_;
+};	// class ScopedStats
+
+// write statistics of all jobs to a json file.
+bool WriteStatsJson(const std::string& filePath, const std::vector<const ConvertStats*>& stats);
+
+//	EOF
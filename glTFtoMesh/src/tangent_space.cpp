@@ -0,0 +1,227 @@
+﻿#include "tangent_space.h"
+
+#include <cstring>
+
+
+namespace
+{
+	// geometries with less faces are processed as is.
+	static const size_t kMinParallelFaceCount = 16384;
+	// faces in a job. connected groups are not split, so a job may have more faces.
+	static const size_t kBatchFaceCount = 8192;
+
+	struct MikkTSpaceMesh
+	{
+		std::vector<Vertex>&			vertices;
+		const std::vector<uint32_t>&	indices;
+		const std::vector<uint32_t>*	pFaces;		// face indices of the batch. null for all faces.
+
+		MikkTSpaceMesh(std::vector<Vertex>& v, const std::vector<uint32_t>& i, const std::vector<uint32_t>* f = nullptr)
+			: vertices(v), indices(i), pFaces(f)
+		{}
+
+		SMikkTSpaceContext GetContext()
+		{
+			static SMikkTSpaceInterface inter = {
+				GetNumFaces,
+				GetNumVerticesOfFace,
+				GetPosition,
+				GetNormal,
+				GetTexCoord,
+				SetTSpaceBasic,
+				SetTSpace
+			};
+
+			SMikkTSpaceContext ret;
+			ret.m_pInterface = &inter;
+			ret.m_pUserData = this;
+			ret.m_bIgnoreDegenerates = false;
+			return ret;
+		}
+
+		uint32_t GetIndex(const int iFace, const int iVert) const
+		{
+			uint32_t face = pFaces ? (*pFaces)[iFace] : (uint32_t)iFace;
+			return indices[face * 3 + iVert];
+		}
+
+		static int GetNumFaces(const SMikkTSpaceContext * pContext)
+		{
+			auto mesh = (const MikkTSpaceMesh*)pContext->m_pUserData;
+			return (int)(mesh->pFaces ? mesh->pFaces->size() : mesh->indices.size() / 3);
+		}
+
+		static int GetNumVerticesOfFace(const SMikkTSpaceContext * pContext, const int iFace)
+		{
+			return 3;
+		}
+
+		static void GetPosition(const SMikkTSpaceContext * pContext, float fvPosOut[], const int iFace, const int iVert)
+		{
+			auto mesh = (const MikkTSpaceMesh*)pContext->m_pUserData;
+			auto index = mesh->GetIndex(iFace, iVert);
+			fvPosOut[0] = mesh->vertices[index].pos.x;
+			fvPosOut[1] = mesh->vertices[index].pos.y;
+			fvPosOut[2] = mesh->vertices[index].pos.z;
+		}
+		static void GetNormal(const SMikkTSpaceContext * pContext, float fvNormOut[], const int iFace, const int iVert)
+		{
+			auto mesh = (const MikkTSpaceMesh*)pContext->m_pUserData;
+			auto index = mesh->GetIndex(iFace, iVert);
+			fvNormOut[0] = mesh->vertices[index].normal.x;
+			fvNormOut[1] = mesh->vertices[index].normal.y;
+			fvNormOut[2] = mesh->vertices[index].normal.z;
+		}
+		static void GetTexCoord(const SMikkTSpaceContext * pContext, float fvTexcOut[], const int iFace, const int iVert)
+		{
+			auto mesh = (const MikkTSpaceMesh*)pContext->m_pUserData;
+			auto index = mesh->GetIndex(iFace, iVert);
+			fvTexcOut[0] = mesh->vertices[index].uv.x;
+			fvTexcOut[1] = mesh->vertices[index].uv.y;
+		}
+
+		static void SetTSpaceBasic(const SMikkTSpaceContext * pContext, const float fvTangent[], const float fSign, const int iFace, const int iVert)
+		{
+			auto mesh = (const MikkTSpaceMesh*)pContext->m_pUserData;
+			auto index = mesh->GetIndex(iFace, iVert);
+			auto&& vertex = mesh->vertices[index];
+			vertex.tangent.x = fvTangent[0];
+			vertex.tangent.y = fvTangent[1];
+			vertex.tangent.z = fvTangent[2];
+			vertex.tangent.w = fSign;
+		}
+
+		static void SetTSpace(const SMikkTSpaceContext * pContext, const float fvTangent[], const float fvBiTangent[], const float fMagS, const float fMagT,
+			const tbool bIsOrientationPreserving, const int iFace, const int iVert)
+		{
+			// not implemented.
+		}
+	};
+
+	// MikkTSpace welds vertices which have the same position, normal and texcoord.
+	struct WeldKey
+	{
+		float	pos[3];
+		float	normal[3];
+		float	uv[2];
+	};	// struct WeldKey
+
+	uint32_t FindRoot(std::vector<uint32_t>& parents, uint32_t v)
+	{
+		while (parents[v] != v)
+		{
+			parents[v] = parents[parents[v]];
+			v = parents[v];
+		}
+		return v;
+	}
+
+	// split faces into batches. faces connected by welded vertices are in the same batch, in the original order.
+	std::vector<std::vector<uint32_t>> SplitFaceBatches(const std::vector<Vertex>& vertexBuffer, const std::vector<uint32_t>& indexBuffer)
+	{
+		// MikkTSpace compares with operator==, so -0 is unified to +0 before bitwise welding.
+		// bitwise welding never joins values which operator== separates, except NaN, and joining more vertices only makes larger groups.
+		std::vector<WeldKey> keys(vertexBuffer.size());
+		for (size_t i = 0; i < vertexBuffer.size(); i++)
+		{
+			auto&& v = vertexBuffer[i];
+			auto&& k = keys[i];
+			k.pos[0] = v.pos.x + 0.0f;
+			k.pos[1] = v.pos.y + 0.0f;
+			k.pos[2] = v.pos.z + 0.0f;
+			k.normal[0] = v.normal.x + 0.0f;
+			k.normal[1] = v.normal.y + 0.0f;
+			k.normal[2] = v.normal.z + 0.0f;
+			k.uv[0] = v.uv.x + 0.0f;
+			k.uv[1] = v.uv.y + 0.0f;
+		}
+		std::vector<uint32_t> remap(vertexBuffer.size());
+		size_t welded_count = meshopt_generateVertexRemap(remap.data(), indexBuffer.data(), indexBuffer.size(), keys.data(), keys.size(), sizeof(WeldKey));
+
+		// connected groups of welded vertices.
+		std::vector<uint32_t> parents(welded_count);
+		for (uint32_t i = 0; i < (uint32_t)welded_count; i++)
+		{
+			parents[i] = i;
+		}
+		size_t face_count = indexBuffer.size() / 3;
+		for (size_t f = 0; f < face_count; f++)
+		{
+			uint32_t r0 = FindRoot(parents, remap[indexBuffer[f * 3 + 0]]);
+			for (int i = 1; i < 3; i++)
+			{
+				uint32_t r = FindRoot(parents, remap[indexBuffer[f * 3 + i]]);
+				if (r != r0)
+				{
+					parents[r] = r0;
+				}
+			}
+		}
+
+		// assign groups to batches in order of the first face.
+		std::vector<uint32_t> group_faces(welded_count, 0);
+		for (size_t f = 0; f < face_count; f++)
+		{
+			group_faces[FindRoot(parents, remap[indexBuffer[f * 3]])]++;
+		}
+		const uint32_t kInvalid = ~0u;
+		std::vector<uint32_t> group_batch(welded_count, kInvalid);
+		std::vector<size_t> batch_sizes;
+		for (size_t f = 0; f < face_count; f++)
+		{
+			uint32_t root = FindRoot(parents, remap[indexBuffer[f * 3]]);
+			if (group_batch[root] == kInvalid)
+			{
+				if (batch_sizes.empty() || batch_sizes.back() >= kBatchFaceCount)
+				{
+					batch_sizes.push_back(0);
+				}
+				group_batch[root] = (uint32_t)(batch_sizes.size() - 1);
+				batch_sizes.back() += group_faces[root];
+			}
+		}
+
+		std::vector<std::vector<uint32_t>> ret(batch_sizes.size());
+		for (size_t i = 0; i < ret.size(); i++)
+		{
+			ret[i].reserve(batch_sizes[i]);
+		}
+		for (size_t f = 0; f < face_count; f++)
+		{
+			ret[group_batch[FindRoot(parents, remap[indexBuffer[f * 3]])]].push_back((uint32_t)f);
+		}
+		return ret;
+	}
+}
+
+void GenerateSubmeshTangents(
+	std::vector<Vertex>& vertexBuffer,
+	const std::vector<uint32_t>& indexBuffer,
+	JobSystem* pJobSystem)
+{
+	size_t face_count = indexBuffer.size() / 3;
+	std::vector<std::vector<uint32_t>> batches;
+	if (pJobSystem && face_count >= kMinParallelFaceCount)
+	{
+		batches = SplitFaceBatches(vertexBuffer, indexBuffer);
+	}
+
+	if (batches.size() <= 1)
+	{
+		MikkTSpaceMesh mikk_mesh(vertexBuffer, indexBuffer);
+		auto mikk_context = mikk_mesh.GetContext();
+		genTangSpaceDefault(&mikk_context);
+		return;
+	}
+
+	// batches write different vertices, because faces sharing a vertex index are in the same batch.
+	ParallelFor(pJobSystem, batches.size(), [&](size_t batch_index)
+	{
+		MikkTSpaceMesh mikk_mesh(vertexBuffer, indexBuffer, &batches[batch_index]);
+		auto mikk_context = mikk_mesh.GetContext();
+		genTangSpaceDefault(&mikk_context);
+	});
+}
+
+
+//	EOF
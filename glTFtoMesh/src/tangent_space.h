@@ -0,0 +1,17 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mesh_work.h"
+
+
+// generate MikkTSpace tangents of the geometry.
+// faces are split into groups which do not share any welded vertex, and the groups are processed in parallel if pJobSystem is not null.
+// MikkTSpace never mixes tangent spaces across such groups, so the result is the same as genTangSpaceDefault() on the whole geometry.
+void GenerateSubmeshTangents(
+	std::vector<Vertex>& vertexBuffer,
+	const std::vector<uint32_t>& indexBuffer,
+	JobSystem* pJobSystem);
+
+//	EOF
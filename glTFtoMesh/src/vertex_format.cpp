@@ -0,0 +1,213 @@
+﻿#include "vertex_format.h"
+
+#include <cmath>
+#include <cstring>
+#include <DirectXPackedVector.h>
+
+
+namespace
+{
+	uint16_t QuantizeUnorm16(float v)
+	{
+		v = std::min(std::max(v, 0.0f), 1.0f);
+		return (uint16_t)(v * 65535.0f + 0.5f);
+	}
+
+	int16_t QuantizeSnorm16(float v)
+	{
+		v = std::min(std::max(v, -1.0f), 1.0f);
+		return (int16_t)std::lround(v * 32767.0f);
+	}
+
+	// octahedral mapping of a unit vector to [-1, 1]^2.
+	void EncodeOctahedron(float x, float y, float z, float& outX, float& outY)
+	{
+		float l1 = fabsf(x) + fabsf(y) + fabsf(z);
+		if (l1 <= 0.0f)
+		{
+			outX = outY = 0.0f;
+			return;
+		}
+		x /= l1;
+		y /= l1;
+		if (z < 0.0f)
+		{
+			float ox = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			float oy = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = ox;
+			y = oy;
+		}
+		outX = x;
+		outY = y;
+	}
+
+	// 0 scale is replaced with 1, so that decode does not need a special case.
+	float SafeScale(float minValue, float maxValue)
+	{
+		float s = maxValue - minValue;
+		return (s > 0.0f) ? s : 1.0f;
+	}
+}
+
+void SetupVertexFormat(bool quantize, bool texcoordUnorm16, RMeshFormat& outFormat)
+{
+	if (quantize)
+	{
+		outFormat.positionFormat = RMeshVertexFormat::Unorm16x4;
+		outFormat.normalFormat = RMeshVertexFormat::Oct16x2;
+		outFormat.tangentFormat = RMeshVertexFormat::Oct16x2Sign;
+		outFormat.texcoordFormat = texcoordUnorm16 ? RMeshVertexFormat::Unorm16x2 : RMeshVertexFormat::Half2;
+	}
+	else
+	{
+		outFormat.positionFormat = RMeshVertexFormat::Float3;
+		outFormat.normalFormat = RMeshVertexFormat::Float3;
+		outFormat.tangentFormat = RMeshVertexFormat::Float4;
+		outFormat.texcoordFormat = RMeshVertexFormat::Float2;
+	}
+}
+
+size_t GetVertexFormatSize(uint32_t format)
+{
+	switch (format)
+	{
+	case RMeshVertexFormat::Float2:			return sizeof(float) * 2;
+	case RMeshVertexFormat::Float3:			return sizeof(float) * 3;
+	case RMeshVertexFormat::Float4:			return sizeof(float) * 4;
+	case RMeshVertexFormat::Unorm16x4:		return sizeof(uint16_t) * 4;
+	case RMeshVertexFormat::Oct16x2:		return sizeof(int16_t) * 2;
+	case RMeshVertexFormat::Oct16x2Sign:	return sizeof(int16_t) * 2;
+	case RMeshVertexFormat::Half2:			return sizeof(uint16_t) * 2;
+	case RMeshVertexFormat::Unorm16x2:		return sizeof(uint16_t) * 2;
+	default:								return 0;
+	}
+}
+
+void ComputeSubmeshFormat(const std::vector<Vertex>& vertices, RMeshSubmeshFormat& outSubmesh)
+{
+	outSubmesh = RMeshSubmeshFormat();
+	if (vertices.empty())
+	{
+		return;
+	}
+
+	// submesh bounds are not updated by MergeSubmesh, so the range is computed from the vertices.
+	DirectX::XMFLOAT3 pos_min = vertices[0].pos, pos_max = vertices[0].pos;
+	DirectX::XMFLOAT2 uv_min = vertices[0].uv, uv_max = vertices[0].uv;
+	for (auto&& v : vertices)
+	{
+		pos_min.x = std::min(pos_min.x, v.pos.x); pos_max.x = std::max(pos_max.x, v.pos.x);
+		pos_min.y = std::min(pos_min.y, v.pos.y); pos_max.y = std::max(pos_max.y, v.pos.y);
+		pos_min.z = std::min(pos_min.z, v.pos.z); pos_max.z = std::max(pos_max.z, v.pos.z);
+		uv_min.x = std::min(uv_min.x, v.uv.x); uv_max.x = std::max(uv_max.x, v.uv.x);
+		uv_min.y = std::min(uv_min.y, v.uv.y); uv_max.y = std::max(uv_max.y, v.uv.y);
+	}
+
+	outSubmesh.posOffsetX = pos_min.x;
+	outSubmesh.posOffsetY = pos_min.y;
+	outSubmesh.posOffsetZ = pos_min.z;
+	outSubmesh.posScaleX = SafeScale(pos_min.x, pos_max.x);
+	outSubmesh.posScaleY = SafeScale(pos_min.y, pos_max.y);
+	outSubmesh.posScaleZ = SafeScale(pos_min.z, pos_max.z);
+	outSubmesh.uvOffsetX = uv_min.x;
+	outSubmesh.uvOffsetY = uv_min.y;
+	outSubmesh.uvScaleX = SafeScale(uv_min.x, uv_max.x);
+	outSubmesh.uvScaleY = SafeScale(uv_min.y, uv_max.y);
+}
+
+void EncodeVertexStreams(
+	const Vertex* pVertices,
+	size_t vertexCount,
+	const RMeshFormat& format,
+	const RMeshSubmeshFormat& submesh,
+	uint8_t* pPosition,
+	uint8_t* pNormal,
+	uint8_t* pTangent,
+	uint8_t* pTexcoord)
+{
+	size_t pos_size = GetVertexFormatSize(format.positionFormat);
+	size_t normal_size = GetVertexFormatSize(format.normalFormat);
+	size_t tangent_size = GetVertexFormatSize(format.tangentFormat);
+	size_t uv_size = GetVertexFormatSize(format.texcoordFormat);
+
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		auto&& v = pVertices[i];
+
+		// position.
+		if (!pPosition)
+		{}
+		else if (format.positionFormat == RMeshVertexFormat::Unorm16x4)
+		{
+			uint16_t q[4] = {
+				QuantizeUnorm16((v.pos.x - submesh.posOffsetX) / submesh.posScaleX),
+				QuantizeUnorm16((v.pos.y - submesh.posOffsetY) / submesh.posScaleY),
+				QuantizeUnorm16((v.pos.z - submesh.posOffsetZ) / submesh.posScaleZ),
+				0,
+			};
+			memcpy(pPosition + i * pos_size, q, pos_size);
+		}
+		else
+		{
+			memcpy(pPosition + i * pos_size, &v.pos, pos_size);
+		}
+
+		// normal.
+		if (!pNormal)
+		{}
+		else if (format.normalFormat == RMeshVertexFormat::Oct16x2)
+		{
+			float ox, oy;
+			EncodeOctahedron(v.normal.x, v.normal.y, v.normal.z, ox, oy);
+			int16_t q[2] = { QuantizeSnorm16(ox), QuantizeSnorm16(oy) };
+			memcpy(pNormal + i * normal_size, q, normal_size);
+		}
+		else
+		{
+			memcpy(pNormal + i * normal_size, &v.normal, normal_size);
+		}
+
+		// tangent.
+		if (!pTangent)
+		{}
+		else if (format.tangentFormat == RMeshVertexFormat::Oct16x2Sign)
+		{
+			float ox, oy;
+			EncodeOctahedron(v.tangent.x, v.tangent.y, v.tangent.z, ox, oy);
+			int16_t qy = (int16_t)((QuantizeSnorm16(oy) & ~1) | (v.tangent.w < 0.0f ? 1 : 0));
+			int16_t q[2] = { QuantizeSnorm16(ox), qy };
+			memcpy(pTangent + i * tangent_size, q, tangent_size);
+		}
+		else
+		{
+			memcpy(pTangent + i * tangent_size, &v.tangent, tangent_size);
+		}
+
+		// texcoord.
+		if (!pTexcoord)
+		{}
+		else if (format.texcoordFormat == RMeshVertexFormat::Half2)
+		{
+			uint16_t q[2] = {
+				DirectX::PackedVector::XMConvertFloatToHalf(v.uv.x),
+				DirectX::PackedVector::XMConvertFloatToHalf(v.uv.y),
+			};
+			memcpy(pTexcoord + i * uv_size, q, uv_size);
+		}
+		else if (format.texcoordFormat == RMeshVertexFormat::Unorm16x2)
+		{
+			uint16_t q[2] = {
+				QuantizeUnorm16((v.uv.x - submesh.uvOffsetX) / submesh.uvScaleX),
+				QuantizeUnorm16((v.uv.y - submesh.uvOffsetY) / submesh.uvScaleY),
+			};
+			memcpy(pTexcoord + i * uv_size, q, uv_size);
+		}
+		else
+		{
+			memcpy(pTexcoord + i * uv_size, &v.uv, uv_size);
+		}
+	}
+}
+
+
+//	EOF
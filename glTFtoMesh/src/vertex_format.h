@@ -0,0 +1,32 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mesh_work.h"
+#include "rmesh_format.h"
+
+
+// set stream formats of the rmesh.
+// if quantize is false, all streams are float. texcoordUnorm16 selects unorm16 or half for quantized texcoords.
+void SetupVertexFormat(bool quantize, bool texcoordUnorm16, RMeshFormat& outFormat);
+
+// byte size of one element of RMeshVertexFormat::Type.
+size_t GetVertexFormatSize(uint32_t format);
+
+// compute dequantization constants of the vertices.
+void ComputeSubmeshFormat(const std::vector<Vertex>& vertices, RMeshSubmeshFormat& outSubmesh);
+
+// encode vertices to each stream with the formats and the constants.
+// destinations must have GetVertexFormatSize(format) * vertexCount bytes. null destinations are skipped.
+void EncodeVertexStreams(
+	const Vertex* pVertices,
+	size_t vertexCount,
+	const RMeshFormat& format,
+	const RMeshSubmeshFormat& submesh,
+	uint8_t* pPosition,
+	uint8_t* pNormal,
+	uint8_t* pTangent,
+	uint8_t* pTexcoord);
+
+//	EOF
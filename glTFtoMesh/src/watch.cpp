@@ -0,0 +1,233 @@
+﻿#include "watch.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <thread>
+#include <chrono>
+#include <filesystem>
+#include <cerrno>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+
+namespace
+{
+	// changes in this time are converted at once. editors often write a file in several steps.
+	const int kSettleMilliseconds = 100;
+
+	void ConvertOnce(const ToolOptions& options, ConvertContext& context)
+	{
+		ConvertResult result;
+		bool succeeded = false;
+		try
+		{
+			// a file in the middle of saving may be an invalid glTF, and the parser throws on it.
+			succeeded = ConvertFile(options, context, &result);
+		}
+		catch (const std::exception& e)
+		{
+			fprintf(stderr, "failed to read glTF. (%s)\n", e.what());
+		}
+		if (!succeeded)
+		{
+			fprintf(stderr, "failed to convert. waiting for the next change. (%s)\n", options.inputFileName.c_str());
+			return;
+		}
+		fprintf(stdout, "watch: %s in %.3f sec. (%s)\n",
+			result.isCacheHit ? "restored" : "converted", result.elapsedSeconds, options.inputFileName.c_str());
+		fflush(stdout);
+	}
+
+	// files to watch. if the input file can not be parsed now, only the input file is watched until it is fixed.
+	std::vector<std::string> GetWatchFiles(const ToolOptions& options)
+	{
+		std::vector<std::string> files;
+		bool collected = false;
+		try
+		{
+			collected = CollectInputFiles(options, files);
+		}
+		catch (const std::exception&)
+		{
+			collected = false;
+		}
+		if (!collected)
+		{
+			files.assign(1, options.inputPath + options.inputFileName);
+		}
+		return files;
+	}
+
+#if defined(__linux__)
+	// directories are watched instead of files, because editors often save a file by renaming a new one.
+	class FileWatcher
+	{
+	public:
+		FileWatcher()
+		{}
+		~FileWatcher()
+		{
+			if (fd_ >= 0)
+			{
+				close(fd_);
+			}
+		}
+
+		// changes after Start() are reported by Wait(), even if they happen before Wait() is called.
+		bool Start(const std::vector<std::string>& files)
+		{
+			fd_ = inotify_init1(IN_CLOEXEC);
+			if (fd_ < 0)
+			{
+				fprintf(stderr, "failed to initialize inotify.\n");
+				return false;
+			}
+			for (auto&& file : files)
+			{
+				std::filesystem::path path(file);
+				auto dir = path.parent_path().string();
+				if (dir.empty())
+				{
+					dir = ".";
+				}
+				int wd = inotify_add_watch(fd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+				if (wd < 0)
+				{
+					fprintf(stderr, "failed to watch directory. (%s)\n", dir.c_str());
+					return false;
+				}
+				watchNames_[wd].insert(path.filename().string());
+			}
+			return true;
+		}
+
+		// block until a watched file is changed, then wait until the changes settle.
+		bool Wait()
+		{
+			alignas(inotify_event) char buf[4096];
+			bool changed = false;
+			while (true)
+			{
+				pollfd pfd = { fd_, POLLIN, 0 };
+				int ready = poll(&pfd, 1, changed ? kSettleMilliseconds : -1);
+				if (ready == 0)
+				{
+					return true;
+				}
+				if (ready < 0)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+					return false;
+				}
+
+				ssize_t size = read(fd_, buf, sizeof(buf));
+				if (size <= 0)
+				{
+					return false;
+				}
+				for (ssize_t offset = 0; offset < size; )
+				{
+					auto pEvent = reinterpret_cast<const inotify_event*>(buf + offset);
+					offset += sizeof(inotify_event) + pEvent->len;
+					if (pEvent->len == 0)
+					{
+						continue;
+					}
+					auto it = watchNames_.find(pEvent->wd);
+					if (it != watchNames_.end() && it->second.count(pEvent->name))
+					{
+						changed = true;
+					}
+				}
+			}
+		}
+
+	private:
+		int										fd_ = -1;
+		std::map<int, std::set<std::string>>	watchNames_;		// file names for each watch descriptor.
+	};	// class FileWatcher
+#else
+	// no inotify on this platform. modification times are polled instead.
+	class FileWatcher
+	{
+	public:
+		FileWatcher()
+		{}
+		~FileWatcher()
+		{}
+
+		bool Start(const std::vector<std::string>& files)
+		{
+			files_ = files;
+			times_ = GetTimes();
+			return true;
+		}
+
+		bool Wait()
+		{
+			const auto kPollInterval = std::chrono::milliseconds(500);
+			while (GetTimes() == times_)
+			{
+				std::this_thread::sleep_for(kPollInterval);
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(kSettleMilliseconds));
+			return true;
+		}
+
+	private:
+		std::vector<std::filesystem::file_time_type> GetTimes() const
+		{
+			std::vector<std::filesystem::file_time_type> times;
+			for (auto&& file : files_)
+			{
+				std::error_code ec;
+				times.push_back(std::filesystem::last_write_time(file, ec));
+			}
+			return times;
+		}
+
+	private:
+		std::vector<std::string>						files_;
+		std::vector<std::filesystem::file_time_type>	times_;
+	};	// class FileWatcher
+#endif
+}
+
+int RunWatch(const ToolOptions& options, ConvertContext& context)
+{
+	while (true)
+	{
+		// external buffers may be added or removed by an edit, so the files are collected every time.
+		// the watcher starts before the conversion, so that changes during the conversion are not missed.
+		auto files = GetWatchFiles(options);
+		FileWatcher watcher;
+		if (!watcher.Start(files))
+		{
+			return -1;
+		}
+
+		ConvertOnce(options, context);
+
+		fprintf(stdout, "watching %zu files. (%s)\n", files.size(), options.inputFileName.c_str());
+		fflush(stdout);
+		if (!watcher.Wait())
+		{
+			fprintf(stderr, "failed to watch files. (%s)\n", options.inputFileName.c_str());
+			return -1;
+		}
+	}
+	return 0;
+}
+
+
+//	EOF
@@ -0,0 +1,11 @@
+﻿#pragma once
+
+#include "converter.h"
+
+
+// convert the input file, and convert it again whenever the input file or its external buffers are changed.
+// it runs until the process is stopped.
+// unchanged geometry and textures are restored from the build cache, so an edit of one texture encodes only that texture.
+int RunWatch(const ToolOptions& options, ConvertContext& context);
+
+//	EOF